@@ -0,0 +1,31 @@
+
+AC_DEFUN([CHECK_SHM], [
+
+AC_ARG_ENABLE(shm,
+  [AS_HELP_STRING(
+    [--(dis|en)able-shm],
+    [Whether to compile the shared-memory transport for ranks on a single node]
+    )],
+  [
+    enable_shm=$enableval
+  ], [
+    enable_shm=no
+  ]
+)
+
+if test "X$enable_shm" = "Xyes"; then
+  AC_SEARCH_LIBS([shm_open], [rt], [],
+    [AC_MSG_ERROR([shared-memory transport requires shm_open])])
+  AC_CHECK_FUNCS([process_vm_readv], [],
+    [AC_MSG_ERROR([shared-memory transport requires process_vm_readv])])
+  AM_CONDITIONAL(ENABLE_SHM, true)
+  AC_SUBST([rdma_header_file_include], ["<sumi/rdma.h>"])
+  AC_SUBST([default_transport], ["shm"])
+else
+  AM_CONDITIONAL(ENABLE_SHM, false)
+fi
+
+AC_CONFIG_FILES([shm/Makefile])
+
+])
+
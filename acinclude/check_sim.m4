@@ -0,0 +1,29 @@
+
+AC_DEFUN([CHECK_SIM], [
+
+AC_ARG_ENABLE(sim,
+  [AS_HELP_STRING(
+    [--(dis|en)able-sim],
+    [Whether to compile the discrete-event simulated transport]
+    )],
+  [
+    enable_sim=$enableval
+  ], [
+    enable_sim=no
+  ]
+)
+
+if test "X$enable_sim" = "Xyes"; then
+  AM_CONDITIONAL(ENABLE_SIM, true)
+  AC_SUBST([rdma_header_file_include], ["<sumi/rdma.h>"])
+  AC_SUBST([default_transport], ["sim"])
+  AC_SUBST([sumi_have_sim], [1])
+else
+  AM_CONDITIONAL(ENABLE_SIM, false)
+  AC_SUBST([sumi_have_sim], [0])
+fi
+
+AC_CONFIG_FILES([sim/Makefile])
+
+])
+
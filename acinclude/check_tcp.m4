@@ -0,0 +1,29 @@
+
+AC_DEFUN([CHECK_TCP], [
+
+AC_ARG_ENABLE(tcp,
+  [AS_HELP_STRING(
+    [--(dis|en)able-tcp],
+    [Whether to compile the TCP socket transport]
+    )],
+  [
+    enable_tcp=$enableval
+  ], [
+    enable_tcp=no
+  ]
+)
+
+if test "X$enable_tcp" = "Xyes"; then
+  AC_CHECK_HEADERS([sys/epoll.h], [],
+    [AC_MSG_ERROR([TCP transport requires epoll])])
+  AM_CONDITIONAL(ENABLE_TCP, true)
+  AC_SUBST([rdma_header_file_include], ["<sumi/rdma.h>"])
+  AC_SUBST([default_transport], ["tcp"])
+else
+  AM_CONDITIONAL(ENABLE_TCP, false)
+fi
+
+AC_CONFIG_FILES([tcp/Makefile])
+
+])
+
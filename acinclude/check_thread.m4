@@ -0,0 +1,29 @@
+
+AC_DEFUN([CHECK_THREAD], [
+
+AC_ARG_ENABLE(thread,
+  [AS_HELP_STRING(
+    [--(dis|en)able-thread],
+    [Whether to compile the transport in which ranks are threads of one process]
+    )],
+  [
+    enable_thread=$enableval
+  ], [
+    enable_thread=no
+  ]
+)
+
+if test "X$enable_thread" = "Xyes"; then
+  AC_SEARCH_LIBS([pthread_create], [pthread], [],
+    [AC_MSG_ERROR([thread transport requires pthreads])])
+  AM_CONDITIONAL(ENABLE_THREAD, true)
+  AC_SUBST([rdma_header_file_include], ["<sumi/rdma.h>"])
+  AC_SUBST([default_transport], ["thread"])
+else
+  AM_CONDITIONAL(ENABLE_THREAD, false)
+fi
+
+AC_CONFIG_FILES([thread/Makefile])
+
+])
+
@@ -1,6 +1,7 @@
 
 #include <pthread.h>
 #include <sumi/transport.h>
+#include <sumi/rank_threads.h>
 #include <sumi/domain.h>
 #include <sprockit/sim_parameters.h>
 #include <sprockit/serializer.h>
@@ -170,7 +171,8 @@ void
 run_test()
 {
   sprockit::sim_parameters params;
-  params["transport"] = DEFAULT_TRANSPORT;
+  const char* transport_name = getenv("SUMI_TRANSPORT");
+  params["transport"] = transport_name ? transport_name : DEFAULT_TRANSPORT;
   params["ping_timeout"] = "100ms";
   params["eager_cutoff"] = "512";
 
@@ -235,18 +237,11 @@ run_test()
 
 int main(int argc, char** argv)
 {
-  try {
 #if DEBUG
   sprockit::debug::turn_on(DEFAULT_TRANSPORT);
   sprockit::debug::turn_on("sumi");
   sprockit::debug::turn_on("sumi_collective");
 #endif
-
-    run_test();
-  } catch (std::exception& e) {
-    std::cerr << e.what() << std::endl;
-    abort();
-  }
-
+  run_rank_threads(run_test);
   return 0;
 }
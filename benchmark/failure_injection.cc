@@ -0,0 +1,749 @@
+
+#include <sumi/config.h>
+#include <sumi/transport.h>
+#include <sumi/domain.h>
+#include <sumi/collective_message.h>
+#include <sprockit/sim_parameters.h>
+#include <sprockit/util.h>
+#include <benchmark/pick_failures.h>
+#include <vector>
+#include <map>
+#include <set>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <stdlib.h>
+#include <unistd.h>
+#if SUMI_HAVE_SIM
+#include <sim/sim_transport.h>
+#endif
+
+using namespace sumi;
+
+/**
+ * Inject failures into jobs and measure how long recovery takes.
+ * Each trial kills ranks via transport::die at chosen offsets into the run
+ * and records
+ *   detection_ms: injection until the first survivor's activity monitor
+ *     declares the rank failed, see transport::failure_detect_time
+ *   agreement_ms: injection until the vote reporting the failure finishes
+ *   vote_ms: duration of that vote
+ *   allreduce_slowdown, allgather_slowdown: time of a fault-aware collective
+ *     with the same failures injected while it runs, over the failure-free time
+ * Percentiles over all trials are printed for every job size.
+ *
+ * Ranks ping their collective partners, so failures are detected by the
+ * ping monitor. On the sim transport every job size runs in this process
+ * in virtual time, and failures are agreed on by heartbeat votes.
+ * On any other transport, e.g. mpi or tcp, the process is one rank of a job
+ * started by the usual launcher. Times are wall-clock, the job size
+ * is fixed by the launcher and failures are agreed on by back-to-back
+ * fault-aware votes. Victims idle until their injection time, die, and are
+ * revived by a terminate from rank 0 once the survivors are done.
+ *
+ * Usage: failure_injection [options]
+ *   -m name     Transport to run on (default the configured transport)
+ *   -n sizes    Comma-separated job sizes, sim only (default 16,64,256)
+ *   -k ranks    Comma-separated ranks to kill (default random, never rank 0)
+ *   -f count    Number of random ranks to kill without -k (default 1)
+ *   -t offsets  Comma-separated injection times in ms, one per failure
+ *               or one for all (default 0.01)
+ *   -j jitter   Add a random delay up to this many ms to each injection (default 0)
+ *   -r trials   Trials per job size (default 20)
+ *   -b interval Heartbeat interval in ms, sim only (default 1)
+ *   -p timeout  Ping timeout in ms (default 1)
+ *   -e nelems   Integers in each collective (default 1024)
+ *   -s seed     Random seed (default 42)
+ *   -o format   csv or json (default csv)
+ */
+
+struct config {
+  std::string transport;
+  std::vector<int> sizes;
+  std::vector<int> ranks;
+  std::vector<double> offsets;
+  int num_failures;
+  double jitter;
+  int trials;
+  double heartbeat_interval;
+  double ping_timeout;
+  int nelems;
+  bool json;
+};
+
+struct failure {
+  int rank;
+  /** Offset from the start of the job */
+  double time;
+};
+
+struct result_row {
+  int nproc;
+  std::string metric;
+  std::vector<double> values;
+};
+
+typedef std::map<std::string, std::vector<double> > sample_map;
+
+static void
+parse_list(const char* str, std::vector<double>& list)
+{
+  list.clear();
+  std::string s(str);
+  size_t pos = 0;
+  while (pos <= s.size()){
+    size_t comma = s.find(',', pos);
+    if (comma == std::string::npos) comma = s.size();
+    list.push_back(atof(s.substr(pos, comma - pos).c_str()));
+    pos = comma + 1;
+  }
+}
+
+static void
+parse_list(const char* str, std::vector<int>& list)
+{
+  std::vector<double> values;
+  parse_list(str, values);
+  list.assign(values.begin(), values.end());
+}
+
+static void
+add_rows(int nproc, sample_map& samples, std::vector<result_row>& rows)
+{
+  sample_map::iterator it, end = samples.end();
+  for (it=samples.begin(); it != end; ++it){
+    result_row row;
+    row.nproc = nproc;
+    row.metric = it->first;
+    row.values = it->second;
+    rows.push_back(row);
+  }
+}
+
+static void
+pick_failures(const config& cfg, int nproc, std::vector<failure>& failures)
+{
+  std::vector<int> victims;
+  if (cfg.ranks.empty()){
+    std::set<int> picked;
+    pick_failures(nproc, std::min(cfg.num_failures, nproc - 1), picked);
+    victims.assign(picked.begin(), picked.end());
+  } else {
+    int nranks = cfg.ranks.size();
+    for (int i=0; i < nranks; ++i){
+      if (cfg.ranks[i] > 0 && cfg.ranks[i] < nproc){
+        victims.push_back(cfg.ranks[i]);
+      }
+    }
+  }
+
+  int nvictims = victims.size();
+  int noffsets = cfg.offsets.size();
+  failures.resize(nvictims);
+  for (int i=0; i < nvictims; ++i){
+    failures[i].rank = victims[i];
+    failures[i].time = i < noffsets ? cfg.offsets[i] : cfg.offsets.back();
+    if (cfg.jitter > 0){
+      failures[i].time += cfg.jitter * (rand() / (RAND_MAX + 1.0));
+    }
+  }
+}
+
+#if SUMI_HAVE_SIM
+/**
+ * @class failure_event
+ * Kill a rank at a fixed point in virtual time
+ */
+class failure_event :
+  public sim_event
+{
+ public:
+  failure_event(transport* t) : t_(t) {}
+
+  void
+  execute(){
+    try {
+      t_->die();
+    } catch (terminate_exception& e) {
+      //expected, the rank is now dead to the network
+    }
+  }
+
+ private:
+  transport* t_;
+};
+
+static std::vector<transport*>
+start_job(const config& cfg, int nproc, bool lazy_watch)
+{
+  sprockit::sim_parameters params;
+  params["transport"] = "sim";
+  params["sim_nproc"] = sprockit::printf("%d", nproc);
+  params["sim_elide_payloads"] = "true";
+  params["ping_timeout"] = sprockit::printf("%.3fus", cfg.ping_timeout*1e6);
+  params["lazy_watch"] = lazy_watch ? "true" : "false";
+
+  std::vector<transport*> ranks(nproc);
+  for (int i=0; i < nproc; ++i){
+    ranks[i] = transport_factory::get_param("transport", &params);
+    ranks[i]->init();
+  }
+  return ranks;
+}
+
+static void
+end_job(std::vector<transport*>& ranks)
+{
+  int nproc = ranks.size();
+  for (int i=0; i < nproc; ++i){
+    if (ranks[i]->is_dead()){
+      ranks[i]->revive();
+    }
+  }
+  for (int i=0; i < nproc; ++i){
+    ranks[i]->finalize();
+  }
+  for (int i=0; i < nproc; ++i){
+    delete ranks[i];
+  }
+}
+
+static void
+inject(std::vector<transport*>& ranks, const std::vector<failure>& failures,
+       double start, std::set<int>& failed)
+{
+  failed.clear();
+  int nfailures = failures.size();
+  for (int i=0; i < nfailures; ++i){
+    const failure& f = failures[i];
+    sim_engine::instance()->schedule(start + f.time, new failure_event(ranks[f.rank]));
+    failed.insert(f.rank);
+  }
+}
+
+/**
+ * @return The earliest time any rank's activity monitor declared the rank
+ *         failed, or a negative time if none did
+ */
+static double
+first_detection(const std::vector<transport*>& ranks, int rank)
+{
+  double first = -1;
+  int nproc = ranks.size();
+  for (int i=0; i < nproc; ++i){
+    double t = ranks[i]->failure_detect_time(rank);
+    if (t >= 0 && (first < 0 || t < first)){
+      first = t;
+    }
+  }
+  return first;
+}
+
+/**
+ * Run heartbeats until every survivor has been told about every failure
+ */
+static void
+run_detection(const config& cfg, int nproc, const std::vector<failure>& failures,
+              sample_map& samples)
+{
+  sim_engine* engine = sim_engine::instance();
+  std::vector<transport*> ranks = start_job(cfg, nproc, false);
+  for (int i=0; i < nproc; ++i){
+    ranks[i]->start_heartbeat(cfg.heartbeat_interval);
+  }
+
+  double start = engine->now();
+  std::set<int> failed;
+  inject(ranks, failures, start, failed);
+
+  //the heartbeat tag that first agreed on each failure
+  std::map<int,int> detected_by;
+  for (int i=0; i < nproc; ++i){
+    if (failed.count(i)){
+      continue;
+    }
+    std::set<int> seen;
+    while (seen.size() < failed.size()){
+      collective_done_message::ptr dmsg = ptr_safe_cast(collective_done_message,
+                                                        ranks[i]->blocking_poll());
+      rank_set::const_iterator it, end = dmsg->failed_procs().start_iteration();
+      for (it=dmsg->failed_procs().begin(); it != end; ++it){
+        seen.insert(*it);
+        if (!detected_by.count(*it)){
+          detected_by[*it] = dmsg->tag();
+        }
+      }
+      dmsg->failed_procs().end_iteration();
+    }
+  }
+
+  //every survivor has finished the votes by now, so the times are final
+  int nfailures = failures.size();
+  for (int i=0; i < nfailures; ++i){
+    const failure& f = failures[i];
+    double detected = first_detection(ranks, f.rank);
+    if (detected >= 0){
+      samples["detection_ms"].push_back((detected - start - f.time)*1e3);
+    }
+    int tag = detected_by[f.rank];
+    double stop = engine->collective_finish_time(collective::dynamic_tree_vote, tag);
+    samples["agreement_ms"].push_back((stop - start - f.time)*1e3);
+    samples["vote_ms"].push_back(
+      engine->collective_time(collective::dynamic_tree_vote, tag)*1e3);
+  }
+
+  for (int i=0; i < nproc; ++i){
+    ranks[i]->stop_heartbeat();
+  }
+  end_job(ranks);
+}
+
+/**
+ * @return The predicted time of a fault-aware collective
+ *         with the failures injected while it runs
+ */
+static double
+run_collective(const config& cfg, int nproc, collective::type_t ty,
+               const std::vector<failure>& failures)
+{
+  sim_engine* engine = sim_engine::instance();
+  std::vector<transport*> ranks = start_job(cfg, nproc, false);
+
+  std::set<int> failed;
+  inject(ranks, failures, engine->now(), failed);
+
+  int tag = 0;
+  int nelems = cfg.nelems;
+  std::vector<int*> src_bufs(nproc);
+  std::vector<int*> dst_bufs(nproc);
+  for (int i=0; i < nproc; ++i){
+    src_bufs[i] = (int*) ::calloc(nelems, sizeof(int));
+    if (ty == collective::allreduce){
+      dst_bufs[i] = (int*) ::calloc(nelems, sizeof(int));
+      ranks[i]->allreduce<int,Add>(dst_bufs[i], src_bufs[i], nelems, tag, true);
+    } else {
+      dst_bufs[i] = (int*) ::calloc(nelems*nproc, sizeof(int));
+      ranks[i]->allgather(dst_bufs[i], src_bufs[i], nelems, sizeof(int), tag, true);
+    }
+  }
+
+  for (int i=0; i < nproc; ++i){
+    if (!failed.count(i)){
+      ranks[i]->blocking_poll();
+    }
+  }
+
+  double t = engine->collective_time(ty, tag);
+  end_job(ranks);
+  for (int i=0; i < nproc; ++i){
+    ::free(src_bufs[i]);
+    ::free(dst_bufs[i]);
+  }
+  return t;
+}
+
+static void
+run_sim(const config& cfg, std::vector<result_row>& rows)
+{
+  std::vector<failure> no_failures;
+  int nsizes = cfg.sizes.size();
+  for (int n=0; n < nsizes; ++n){
+    int nproc = cfg.sizes[n];
+    if (nproc < 2){
+      continue;
+    }
+    //the failure-free times are deterministic, one run is enough
+    double allreduce_base = run_collective(cfg, nproc, collective::allreduce, no_failures);
+    double allgather_base = run_collective(cfg, nproc, collective::allgather, no_failures);
+
+    sample_map samples;
+    for (int trial=0; trial < cfg.trials; ++trial){
+      std::vector<failure> failures;
+      pick_failures(cfg, nproc, failures);
+      if (failures.empty()){
+        break;
+      }
+      run_detection(cfg, nproc, failures, samples);
+      double t = run_collective(cfg, nproc, collective::allreduce, failures);
+      samples["allreduce_slowdown"].push_back(t / allreduce_base);
+      t = run_collective(cfg, nproc, collective::allgather, failures);
+      samples["allgather_slowdown"].push_back(t / allgather_base);
+    }
+    add_rows(nproc, samples, rows);
+  }
+}
+#endif
+
+/**
+ * Every phase of a live trial gets its own block of tags so that ranks
+ * that spent the phase dead still agree on the tags of the next one
+ */
+static const int live_phase_tags = 1000;
+
+/**
+ * @return The time at which the collective finishes, or a negative time
+ *         if a terminate from rank 0 arrives first
+ */
+static double
+wait_for(transport* t, collective::type_t ty, int tag)
+{
+  while (true){
+    message::ptr msg = t->blocking_poll();
+    if (msg->class_type() == message::terminate){
+      return -1;
+    }
+    collective_done_message::ptr dmsg = ptr_test_cast(collective_done_message, msg);
+    if (dmsg && dmsg->type() == ty && dmsg->tag() == tag){
+      return t->wall_time();
+    }
+  }
+}
+
+/**
+ * Keep making progress until the injection time, then die and stay dead
+ * until rank 0 sends a terminate. If the terminate arrives before the
+ * injection time, the survivors are already done and the rank never dies.
+ */
+static void
+die_at(transport* t, double when)
+{
+  double now = t->wall_time();
+  while (now < when){
+    message::ptr msg = t->blocking_poll(when - now);
+    if (msg && msg->class_type() == message::terminate){
+      return;
+    }
+    now = t->wall_time();
+  }
+
+  try {
+    t->die();
+  } catch (terminate_exception& e) {
+    //expected, the rank is now dead to the network
+  }
+  while (t->blocking_poll()->class_type() != message::terminate);
+  t->revive();
+}
+
+static const failure*
+find_failure(const std::vector<failure>& failures, int rank)
+{
+  int nfailures = failures.size();
+  for (int i=0; i < nfailures; ++i){
+    if (failures[i].rank == rank){
+      return &failures[i];
+    }
+  }
+  return 0;
+}
+
+/**
+ * Bring the victims back and start the next phase from a clean slate.
+ * Each victim answers the terminate from rank 0 with a terminate of its own
+ * once it is revived. Only after every answer does rank 0 start a bcast,
+ * and the other ranks send nothing in the bcast until their parent's
+ * message arrives, so no message goes to a victim that is still dead.
+ */
+static void
+resync(transport* t, const std::vector<failure>& failures, int& tag)
+{
+  int nfailures = failures.size();
+  if (t->rank() == 0){
+    for (int i=0; i < nfailures; ++i){
+      t->send_terminate(failures[i].rank);
+    }
+    int nacks = 0;
+    while (nacks < nfailures){
+      if (t->blocking_poll()->class_type() == message::terminate){
+        ++nacks;
+      }
+    }
+  } else if (find_failure(failures, t->rank())){
+    //die_at has already seen the terminate and revived us
+    t->send_terminate(0);
+  }
+  t->clear_failures();
+  int go = 0;
+  t->bcast(&go, 1, sizeof(int), tag, false);
+  wait_for(t, collective::bcast, tag);
+  tag += live_phase_tags;
+}
+
+/**
+ * Vote until every failure has been agreed on
+ */
+static void
+agree_on_failures(transport* t, const std::vector<failure>& failures, double start,
+                  sample_map& samples, int tag)
+{
+  std::map<int,double> agreed_at;
+  int round = 0;
+  int nfailures = failures.size();
+  while (int(agreed_at.size()) < nfailures){
+    int vote_tag = tag + round;
+    double vote_start = t->wall_time();
+    t->vote<And>(1, vote_tag);
+    collective_done_message::ptr dmsg;
+    while (!dmsg){
+      dmsg = ptr_test_cast(collective_done_message, t->blocking_poll());
+      if (dmsg && (dmsg->type() != collective::dynamic_tree_vote || dmsg->tag() != vote_tag)){
+        dmsg = 0;
+      }
+    }
+    double stop = t->wall_time();
+    rank_set::const_iterator it, end = dmsg->failed_procs().start_iteration();
+    for (it=dmsg->failed_procs().begin(); it != end; ++it){
+      if (find_failure(failures, *it) && !agreed_at.count(*it)){
+        agreed_at[*it] = stop;
+        if (t->rank() == 0){
+          samples["vote_ms"].push_back((stop - vote_start)*1e3);
+        }
+      }
+    }
+    dmsg->failed_procs().end_iteration();
+    ++round;
+  }
+
+  if (t->rank() == 0){
+    for (int i=0; i < nfailures; ++i){
+      const failure& f = failures[i];
+      samples["agreement_ms"].push_back((agreed_at[f.rank] - start - f.time)*1e3);
+    }
+  }
+}
+
+static void
+run_live_detection(transport* t, const std::vector<failure>& failures,
+                   sample_map& samples, int& tag)
+{
+  double start = t->wall_time();
+  int nfailures = failures.size();
+  //no rank detected the failure
+  const double not_detected = 1e30;
+  std::vector<double> detection_ms(nfailures, not_detected);
+  const failure* mine = find_failure(failures, t->rank());
+  if (mine){
+    die_at(t, start + mine->time);
+  } else {
+    agree_on_failures(t, failures, start, samples, tag);
+    for (int i=0; i < nfailures; ++i){
+      const failure& f = failures[i];
+      double detected = t->failure_detect_time(f.rank);
+      if (detected >= 0){
+        detection_ms[i] = (detected - start - f.time)*1e3;
+      }
+    }
+  }
+  resync(t, failures, tag);
+
+  //the first rank to detect a failure is often not rank 0
+  t->allreduce<double,Min>(&detection_ms[0], &detection_ms[0], nfailures, tag);
+  wait_for(t, collective::allreduce, tag);
+  tag += live_phase_tags;
+  if (t->rank() == 0){
+    for (int i=0; i < nfailures; ++i){
+      if (detection_ms[i] < not_detected){
+        samples["detection_ms"].push_back(detection_ms[i]);
+      }
+    }
+  }
+}
+
+/**
+ * @return The wall-clock time of a fault-aware collective
+ *         with the failures injected while it runs
+ */
+static double
+run_live_collective(const config& cfg, transport* t, collective::type_t ty,
+                    const std::vector<failure>& failures, int& tag)
+{
+  int nelems = cfg.nelems;
+  int* src_buf = (int*) ::calloc(nelems, sizeof(int));
+  int* dst_buf;
+  double start = t->wall_time();
+  if (ty == collective::allreduce){
+    dst_buf = (int*) ::calloc(nelems, sizeof(int));
+    t->allreduce<int,Add>(dst_buf, src_buf, nelems, tag, true);
+  } else {
+    dst_buf = (int*) ::calloc(nelems*t->nproc(), sizeof(int));
+    t->allgather(dst_buf, src_buf, nelems, sizeof(int), tag, true);
+  }
+
+  double elapsed = 0;
+  const failure* mine = find_failure(failures, t->rank());
+  if (mine){
+    die_at(t, start + mine->time);
+  } else {
+    elapsed = wait_for(t, ty, tag) - start;
+  }
+
+  resync(t, failures, tag);
+  ::free(src_buf);
+  ::free(dst_buf);
+  return elapsed;
+}
+
+/**
+ * Run the trials as one rank of a job on a real transport
+ * @return Whether this rank should print the results
+ */
+static bool
+run_live(const config& cfg, std::vector<result_row>& rows)
+{
+  sprockit::sim_parameters params;
+  params["transport"] = cfg.transport;
+  params["ping_timeout"] = sprockit::printf("%.3fus", cfg.ping_timeout*1e6);
+  params["lazy_watch"] = "false";
+  transport* t = transport_factory::get_param("transport", &params);
+  t->init();
+
+  int nproc = t->nproc();
+  std::vector<failure> no_failures;
+  sample_map samples;
+  int tag = 0;
+  resync(t, no_failures, tag);
+  for (int trial=0; nproc > 1 && trial < cfg.trials; ++trial){
+    //every rank draws the same failures from the same seed
+    std::vector<failure> failures;
+    pick_failures(cfg, nproc, failures);
+    if (failures.empty()){
+      break;
+    }
+    run_live_detection(t, failures, samples, tag);
+    //the failure-free times are noisy, rerun them next to every trial
+    double base = run_live_collective(cfg, t, collective::allreduce, no_failures, tag);
+    double time = run_live_collective(cfg, t, collective::allreduce, failures, tag);
+    samples["allreduce_slowdown"].push_back(time / base);
+    base = run_live_collective(cfg, t, collective::allgather, no_failures, tag);
+    time = run_live_collective(cfg, t, collective::allgather, failures, tag);
+    samples["allgather_slowdown"].push_back(time / base);
+  }
+
+  bool root = t->rank() == 0;
+  if (root){
+    add_rows(nproc, samples, rows);
+  }
+  t->finalize();
+  delete t;
+  return root;
+}
+
+static double
+percentile(const std::vector<double>& sorted, double p)
+{
+  //nearest rank
+  int idx = (int) ::ceil(p / 100. * sorted.size()) - 1;
+  idx = std::max(0, std::min(idx, int(sorted.size()) - 1));
+  return sorted[idx];
+}
+
+static void
+print_results(const config& cfg, std::vector<result_row>& rows)
+{
+  static const double pcts[] = { 50, 90, 99 };
+  static const int npcts = sizeof(pcts) / sizeof(double);
+
+  if (cfg.json){
+    printf("[\n");
+  } else {
+    printf("nproc,metric,count,mean,min,p50,p90,p99,max\n");
+  }
+
+  int nrows = rows.size();
+  for (int r=0; r < nrows; ++r){
+    std::vector<double>& values = rows[r].values;
+    std::sort(values.begin(), values.end());
+    int nvalues = values.size();
+    double mean = 0;
+    for (int i=0; i < nvalues; ++i){
+      mean += values[i];
+    }
+    mean /= values.size();
+
+    if (cfg.json){
+      printf("  {\"nproc\": %d, \"metric\": \"%s\", \"count\": %d, \"mean\": %.9g, \"min\": %.9g",
+        rows[r].nproc, rows[r].metric.c_str(), int(values.size()), mean, values.front());
+      for (int p=0; p < npcts; ++p){
+        printf(", \"p%d\": %.9g", int(pcts[p]), percentile(values, pcts[p]));
+      }
+      printf(", \"max\": %.9g}%s\n", values.back(), r + 1 < nrows ? "," : "");
+    } else {
+      printf("%d,%s,%d,%.9g,%.9g", rows[r].nproc, rows[r].metric.c_str(),
+        int(values.size()), mean, values.front());
+      for (int p=0; p < npcts; ++p){
+        printf(",%.9g", percentile(values, pcts[p]));
+      }
+      printf(",%.9g\n", values.back());
+    }
+  }
+
+  if (cfg.json){
+    printf("]\n");
+  }
+}
+
+int main(int argc, char** argv)
+{
+  config cfg;
+  parse_list("16,64,256", cfg.sizes);
+  parse_list("0.01", cfg.offsets);
+  cfg.num_failures = 1;
+  cfg.jitter = 0;
+  cfg.trials = 20;
+  cfg.heartbeat_interval = 1;
+  cfg.ping_timeout = 1;
+  cfg.nelems = 1024;
+  cfg.json = false;
+  cfg.transport = DEFAULT_TRANSPORT;
+  int seed = 42;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "m:n:k:f:t:j:r:b:p:e:s:o:")) != -1){
+    switch (opt){
+      case 'm': cfg.transport = optarg; break;
+      case 'n': parse_list(optarg, cfg.sizes); break;
+      case 'k': parse_list(optarg, cfg.ranks); break;
+      case 'f': cfg.num_failures = atoi(optarg); break;
+      case 't': parse_list(optarg, cfg.offsets); break;
+      case 'j': cfg.jitter = atof(optarg); break;
+      case 'r': cfg.trials = atoi(optarg); break;
+      case 'b': cfg.heartbeat_interval = atof(optarg); break;
+      case 'p': cfg.ping_timeout = atof(optarg); break;
+      case 'e': cfg.nelems = atoi(optarg); break;
+      case 's': seed = atoi(optarg); break;
+      case 'o': cfg.json = std::string(optarg) == "json"; break;
+      default:
+        fprintf(stderr, "usage: %s [-m transport] [-n sizes] [-k ranks] [-f count] [-t offsets] [-j jitter]"
+                " [-r trials] [-b interval] [-p timeout] [-e nelems] [-s seed] [-o csv|json]\n",
+                argv[0]);
+        return 1;
+    }
+  }
+  //times are given in ms
+  int noffsets = cfg.offsets.size();
+  for (int i=0; i < noffsets; ++i){
+    cfg.offsets[i] *= 1e-3;
+  }
+  cfg.jitter *= 1e-3;
+  cfg.heartbeat_interval *= 1e-3;
+  cfg.ping_timeout *= 1e-3;
+  srand(seed);
+
+  std::vector<result_row> rows;
+  bool print = true;
+  if (cfg.transport == "sim"){
+#if SUMI_HAVE_SIM
+    run_sim(cfg, rows);
+#else
+    fprintf(stderr, "%s: not configured with the sim transport\n", argv[0]);
+    return 1;
+#endif
+  } else {
+    print = run_live(cfg, rows);
+  }
+
+  if (print){
+    print_results(cfg, rows);
+  }
+  return 0;
+}
@@ -0,0 +1,23 @@
+#ifndef sumi_benchmark_PICK_FAILURES_H
+#define sumi_benchmark_PICK_FAILURES_H
+
+#include <set>
+#include <stdlib.h>
+
+/**
+ * Pick distinct random ranks to kill, never rank 0.
+ * Rank 0 is the root of the vote tree, its failure is not recoverable.
+ * @param nproc         The job size
+ * @param num_failures  Number of ranks to pick, at most nproc - 1
+ * @param failed        Output, the picked ranks
+ */
+static inline void
+pick_failures(int nproc, int num_failures, std::set<int>& failed)
+{
+  failed.clear();
+  while (int(failed.size()) < num_failures){
+    failed.insert(1 + rand() % (nproc - 1));
+  }
+}
+
+#endif // sumi_benchmark_PICK_FAILURES_H
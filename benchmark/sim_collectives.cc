@@ -0,0 +1,118 @@
+
+#include <sim/sim_transport.h>
+#include <sumi/domain.h>
+#include <sprockit/sim_parameters.h>
+#include <sprockit/util.h>
+#include <sprockit/stl_string.h>
+#include <vector>
+#include <stdlib.h>
+
+using namespace sumi;
+
+/**
+ * Predict collective times at scale by running every rank
+ * in this process on the sim transport.
+ * Usage: sim_collectives [nproc] [topology geometry...]
+ */
+
+static void
+run_allreduce(std::vector<transport*>& ranks, int nelems, int tag)
+{
+  int nproc = ranks.size();
+  std::vector<int*> bufs(nproc);
+  for (int i=0; i < nproc; ++i){
+    bufs[i] = (int*) ::calloc(nelems, sizeof(int));
+    ranks[i]->allreduce<int,Add>(bufs[i], bufs[i], nelems, tag, false);
+  }
+  //blocking on any rank drives the whole simulation forward
+  for (int i=0; i < nproc; ++i){
+    ranks[i]->blocking_poll();
+    ::free(bufs[i]);
+  }
+  printf("Test allreduce: nelems=%d nproc=%d t=%20.12f ms\n",
+    nelems, nproc,
+    sim_engine::instance()->collective_time(collective::allreduce, tag)*1e3);
+}
+
+static void
+run_allgather(std::vector<transport*>& ranks, int nelems, int tag)
+{
+  int nproc = ranks.size();
+  std::vector<int*> src_bufs(nproc);
+  std::vector<int*> dst_bufs(nproc);
+  for (int i=0; i < nproc; ++i){
+    src_bufs[i] = (int*) ::calloc(nelems, sizeof(int));
+    dst_bufs[i] = (int*) ::calloc(nelems*nproc, sizeof(int));
+    ranks[i]->allgather(dst_bufs[i], src_bufs[i], nelems, sizeof(int), tag, false);
+  }
+  for (int i=0; i < nproc; ++i){
+    ranks[i]->blocking_poll();
+    ::free(src_bufs[i]);
+    ::free(dst_bufs[i]);
+  }
+  printf("Test allgather: nelems=%d nproc=%d t=%20.12f ms\n",
+    nelems, nproc,
+    sim_engine::instance()->collective_time(collective::allgather, tag)*1e3);
+}
+
+static void
+run_vote(std::vector<transport*>& ranks, int tag)
+{
+  int nproc = ranks.size();
+  for (int i=0; i < nproc; ++i){
+    ranks[i]->vote<And>(1, tag);
+  }
+  for (int i=0; i < nproc; ++i){
+    ranks[i]->blocking_poll();
+  }
+  printf("Test vote: nproc=%d t=%20.12f ms\n",
+    nproc, sim_engine::instance()->collective_time(collective::dynamic_tree_vote, tag)*1e3);
+}
+
+int main(int argc, char** argv)
+{
+  int nproc = argc > 1 ? atoi(argv[1]) : 64;
+
+  sprockit::sim_parameters params;
+  params["transport"] = "sim";
+  params["sim_nproc"] = sprockit::printf("%d", nproc);
+  params["sim_elide_payloads"] = "true";
+  params["eager_cutoff"] = "512";
+  params["use_put_protocol"] = "false";
+  params["lazy_watch"] = "true";
+  if (argc > 2){
+    std::string geometry;
+    for (int i=2; i < argc; ++i){
+      geometry += sprockit::printf("%s ", argv[i]);
+    }
+    params["sim_topology"] = "torus";
+    params["sim_topology_geometry"] = geometry;
+  }
+
+  std::vector<transport*> ranks(nproc);
+  for (int i=0; i < nproc; ++i){
+    ranks[i] = transport_factory::get_param("transport", &params);
+    ranks[i]->init();
+  }
+
+  int tag = 0;
+  int reduce_nelems[] = { 64, 256, 1024, 4096, 16384 };
+  int allgather_nelems[] = { 32, 64, 128, 512, 1024 };
+  int ntests = sizeof(reduce_nelems) / sizeof(int);
+  for (int i=0; i < ntests; ++i){
+    run_allreduce(ranks, reduce_nelems[i], tag++);
+  }
+  for (int i=0; i < ntests; ++i){
+    run_allgather(ranks, allgather_nelems[i], tag++);
+  }
+  run_vote(ranks, tag++);
+
+  for (int i=0; i < nproc; ++i){
+    ranks[i]->finalize();
+  }
+  for (int i=0; i < nproc; ++i){
+    delete ranks[i];
+  }
+
+  return 0;
+}
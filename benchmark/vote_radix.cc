@@ -0,0 +1,101 @@
+
+#include <sim/sim_transport.h>
+#include <sumi/domain.h>
+#include <sumi/collective_message.h>
+#include <sprockit/sim_parameters.h>
+#include <sprockit/util.h>
+#include <benchmark/pick_failures.h>
+#include <vector>
+#include <set>
+#include <stdlib.h>
+
+using namespace sumi;
+
+/**
+ * Compare the fan-out of the vote tree under injected failures.
+ * Each test runs a whole job of nproc ranks on the sim transport,
+ * kills a random set of ranks (never the root), and reports
+ * the predicted time for the survivors to agree on a vote.
+ * Usage: vote_radix [nproc] [max failures] [seed]
+ */
+
+static double
+run_vote(int nproc, int radix, const std::set<int>& failed, int& num_agreed)
+{
+  sprockit::sim_parameters params;
+  params["transport"] = "sim";
+  params["sim_nproc"] = sprockit::printf("%d", nproc);
+  params["sim_elide_payloads"] = "true";
+  params["lazy_watch"] = "true";
+  params["vote_radix"] = sprockit::printf("%d", radix);
+
+  std::vector<transport*> ranks(nproc);
+  for (int i=0; i < nproc; ++i){
+    ranks[i] = transport_factory::get_param("transport", &params);
+    ranks[i]->init();
+  }
+
+  std::set<int>::const_iterator it, end = failed.end();
+  for (it=failed.begin(); it != end; ++it){
+    try {
+      ranks[*it]->die();
+    } catch (terminate_exception& e) {
+      //expected, the rank is now dead to the network
+    }
+  }
+
+  int tag = 0;
+  for (int i=0; i < nproc; ++i){
+    if (!failed.count(i)){
+      ranks[i]->vote<And>(1, tag);
+    }
+  }
+
+  num_agreed = -1;
+  for (int i=0; i < nproc; ++i){
+    if (!failed.count(i)){
+      collective_done_message::ptr dmsg = ptr_safe_cast(collective_done_message,
+                                                        ranks[i]->blocking_poll());
+      num_agreed = dmsg->failed_procs().size();
+    }
+  }
+
+  double t = sim_engine::instance()->collective_time(collective::dynamic_tree_vote, tag);
+
+  for (it=failed.begin(); it != end; ++it){
+    ranks[*it]->revive();
+  }
+  for (int i=0; i < nproc; ++i){
+    ranks[i]->finalize();
+  }
+  for (int i=0; i < nproc; ++i){
+    delete ranks[i];
+  }
+  return t;
+}
+
+int main(int argc, char** argv)
+{
+  int nproc = argc > 1 ? atoi(argv[1]) : 256;
+  int max_failures = argc > 2 ? atoi(argv[2]) : 8;
+  int seed = argc > 3 ? atoi(argv[3]) : 42;
+  srand(seed);
+
+  int radices[] = { 2, 4, 8, 16, 32 };
+  int nradix = sizeof(radices) / sizeof(int);
+
+  printf("%8s %8s %8s %20s %8s\n", "nproc", "failures", "radix", "time (ms)", "agreed");
+  std::set<int> failed;
+  for (int nfail=0; nfail <= max_failures && nfail < nproc; nfail = nfail ? nfail*2 : 1){
+    pick_failures(nproc, nfail, failed);
+    //every radix sees the same failures
+    for (int r=0; r < nradix; ++r){
+      int num_agreed;
+      double t = run_vote(nproc, radices[r], failed, num_agreed);
+      printf("%8d %8d %8d %20.12f %8d\n",
+        nproc, nfail, radices[r], t*1e3, num_agreed);
+    }
+  }
+
+  return 0;
+}
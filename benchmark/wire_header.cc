@@ -0,0 +1,113 @@
+
+#include <sumi/wire_header.h>
+#include <sumi/collective_message.h>
+#include <sprockit/serializer.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace sumi;
+
+static double
+now()
+{
+  timeval t_st;
+  gettimeofday(&t_st, 0);
+  return t_st.tv_sec + 1e-6 * t_st.tv_usec;
+}
+
+static void
+serializer_round_trip(const message::ptr& msg, std::vector<char>& buf)
+{
+  message::ptr tmp = msg;
+  sprockit::serializer ser;
+  ser.start_packing(&buf[0], buf.size());
+  ser & tmp;
+  ser.start_unpacking(&buf[0], buf.size());
+  message::ptr out;
+  ser & out;
+  void* payload = out->eager_buffer();
+  if (payload) delete[] (char*) payload;
+}
+
+static void
+wire_round_trip(const message::ptr& msg, std::vector<char>& buf)
+{
+  wire_header::pack(msg, &buf[0], buf.size());
+  message::ptr out = wire_header::unpack(&buf[0], buf.size());
+  void* payload = out->eager_buffer();
+  if (payload) delete[] (char*) payload;
+}
+
+static void
+run_test(const char* name, const message::ptr& msg, int niter)
+{
+  std::vector<char> buf(4096);
+
+  double t_start = now();
+  for (int i=0; i < niter; ++i){
+    serializer_round_trip(msg, buf);
+  }
+  double t_ser = (now() - t_start) / niter * 1e9;
+
+  t_start = now();
+  for (int i=0; i < niter; ++i){
+    wire_round_trip(msg, buf);
+  }
+  double t_wire = (now() - t_start) / niter * 1e9;
+
+  const wire_header* hdr = wire_header::peek(&buf[0]);
+  printf("%-24s %-18s %10.1f ns %10.1f ns %6.2fx\n",
+    name, wire_header::tostr((wire_header::format_t)hdr->format),
+    t_ser, t_wire, t_ser / t_wire);
+}
+
+int main(int argc, char** argv)
+{
+  int niter = 1000000;
+  if (argc > 1){
+    niter = atoi(argv[1]);
+  }
+
+  double payload[8];
+  for (int i=0; i < 8; ++i){
+    payload[i] = i;
+  }
+
+  message::ptr ack = new message;
+  ack->set_class_type(message::collective_done);
+  ack->set_sender(3);
+  ack->set_recver(5);
+
+  rdma_message::ptr header = new rdma_message(1024);
+  header->set_class_type(message::pt2pt);
+  header->set_payload_type(message::header);
+  header->remote_buffer().ptr = payload;
+
+  collective_work_message::ptr eager = new collective_eager_message(
+    collective::allreduce, collective_work_message::eager_payload,
+    payload, 8, sizeof(double), 11, 2, 0, 1);
+  eager->set_class_type(message::collective);
+
+  collective_work_message::ptr rdma = new collective_rdma_message(
+    collective::allgather, collective_work_message::rdma_get_header,
+    8, sizeof(double), 11, 2, 0, 1);
+  rdma->set_class_type(message::collective);
+
+  collective_work_message::ptr failed = new collective_eager_message(
+    collective::allreduce, collective_work_message::eager_payload,
+    payload, 8, sizeof(double), 11, 2, 0, 1);
+  failed->set_class_type(message::collective);
+  failed->append_failed(4);
+
+  printf("%-24s %-18s %13s %13s %7s\n",
+    "message", "wire format", "serializer", "wire header", "speedup");
+  run_test("ack", ack, niter);
+  run_test("rdma header", header, niter);
+  run_test("collective eager", eager, niter);
+  run_test("collective rdma", rdma, niter);
+  run_test("collective w/ failures", failed, niter);
+
+  return 0;
+}
@@ -82,9 +82,9 @@ fake_transport::do_nvram_get(int src, const message::ptr &msg)
 }
 
 void
-fake_transport::simulate_vote(int context, const thread_safe_set<int> &failures)
+fake_transport::simulate_vote(int context, const rank_set &failures)
 {
-  votes_done_[context] = vote_result(1, failures);
+  votes_done_[context] = vote_result(1, failure_log_.append(0, failures));
 }
 
 message::ptr
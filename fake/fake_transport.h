@@ -7,7 +7,7 @@ class fake_transport : public transport
 {
 
  public:
-  fake_transport(){}
+  fake_transport() : now_(0) {}
 
   message::ptr
   block_until_message();
@@ -34,7 +34,15 @@ class fake_transport : public transport
 
   double
   wall_time() const {
-    return 0;
+    return now_;
+  }
+
+  /**
+   * Nothing advances the clock on its own, tests move it by hand
+   */
+  void
+  set_wall_time(double now){
+    now_ = now;
   }
 
   void
@@ -65,7 +73,18 @@ class fake_transport : public transport
   }
 
   void
-  simulate_vote(int context, const thread_safe_set<int>& failures);
+  simulate_vote(int context, const rank_set& failures);
+
+  /**
+   * Act as if a vote on the global domain just finished
+   * @param tag       The tag of the vote, also the context it starts
+   * @param context   The context the vote ran in
+   * @param failures  Every failure the vote agreed on, old and new
+   */
+  void
+  simulate_global_vote(int tag, int context, const rank_set& failures){
+    vote_agreed(tag, context, 1, failures, true);
+  }
 
   void
   allgather(void *dst, void *src, int nelems, int type_size, int tag, bool fault_aware, int context, domain *dom){} //do nothing
@@ -76,6 +95,10 @@ class fake_transport : public transport
   void
   dynamic_tree_vote(int vote, int tag, vote_fxn fxn, int context, domain *dom){}
 
+  void
+  dynamic_tree_vote(int, int, vote_fxn, void*, void*, int,
+                    int, reduce_fxn, int, domain*){} //do nothing
+
  private:
   message::ptr
   pop_message(std::list<message::ptr>& msglist);
@@ -104,6 +127,8 @@ class fake_transport : public transport
   std::list<message::ptr> rdma_puts_;
 
   std::list<message::ptr> nvram_gets_;
+
+  double now_;
 };
 
 }
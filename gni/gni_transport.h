@@ -67,21 +67,18 @@ class gni_transport :
   public_buffer
   allocate_public_buffer(int size);
 
-  public_buffer
-  make_public_buffer(void* buf, int size);
-
-  void
-  free_public_buffer(public_buffer buf, int size);
-
-  void
-  unmake_public_buffer(public_buffer buf, int size);
-
   bool
   supports_hardware_ack() const {
     return true;
   }
 
  protected:
+  public_buffer
+  register_public_buffer(void* buf, int size);
+
+  void
+  unregister_public_buffer(public_buffer buf, int size);
+
   void block_inner_loop();
 
   void do_smsg_send(int dst, const message::ptr &msg);
@@ -36,7 +36,7 @@ gni_transport::allocate_public_buffer(int size)
 }
 
 public_buffer
-gni_transport::make_public_buffer(void *buf, int size)
+gni_transport::register_public_buffer(void *buf, int size)
 {
   public_buffer pbuf;
   pbuf.ptr = buf;
@@ -57,16 +57,9 @@ gni_transport::unregister_mem(gni_nic_handle_t nic_handle, gni_mem_handle_t* mem
 }
 
 void
-gni_transport::unmake_public_buffer(public_buffer buf, int size)
+gni_transport::unregister_public_buffer(public_buffer buf, int size)
 {
   unregister_mem(tx_context_.nic_handle, &buf.mem_handle);
 }
 
-void
-gni_transport::free_public_buffer(public_buffer buf, int size)
-{
-  unregister_mem(tx_context_.nic_handle, &buf.mem_handle);
-  ::free(buf.ptr);
-}
-
 }
@@ -1,7 +1,11 @@
 #include <mpi/mpi_transport.h>
+#include <sumi/domain.h>
+#include <sumi/wire_header.h>
 #include <sprockit/serializer.h>
 #include <sprockit/sim_parameters.h>
+#include <sprockit/keyword_registration.h>
 #include <sys/time.h>
+#include <algorithm>
 
 #define mpi_debug_out(...) \
   debug_printf(sprockit::dbg::mpi, "Rank %d: %s at t=%8.4e", rank(), sprockit::printf(__VA_ARGS__).c_str(), wall_time())
@@ -9,6 +13,9 @@
 DeclareDebugSlot(mpi);
 RegisterDebugSlot(mpi);
 
+RegisterKeywords("rdma_chunk_size", "rdma_chunk_window", "mpi_preposted_recvs", "mpi_rma",
+  "mpi_native_collectives", "mpi_num_rails", "mpi_rail_stripe_threshold");
+
 namespace sumi {
 
 SpktRegister("mpi", transport, mpi_transport,
@@ -16,9 +23,24 @@ SpktRegister("mpi", transport, mpi_transport,
 
 #define enumcase(x) case x: return #x
 
+/** Attribute key for the transport owning a native datatype, made once per process */
+static int native_type_keyval = MPI_KEYVAL_INVALID;
+
+void
+mpi_transport::native_reduce(void* in, void* inout, int* len, MPI_Datatype* dtype)
+{
+  void* attr;
+  int found;
+  MPI_Type_get_attr(*dtype, native_type_keyval, &attr, &found);
+  mpi_transport* tport = (mpi_transport*) attr;
+  reduce_fxn fxn = tport->native_reduce_fxns_[*dtype];
+  (*fxn)(inout, in, *len);
+}
+
 
 PendingMPI::PendingMPI() :
-  req(0),
+  req(&request),
+  request(MPI_REQUEST_NULL),
   id(-1)
 {
   clear();
@@ -42,6 +64,12 @@ PendingMPI::tostr(type_t ty)
   enumcase(RDMAPutSend);
   enumcase(SendPingRequest);
   enumcase(SendPingResponse);
+  enumcase(RDMAChunkSend);
+  enumcase(RDMAChunkRecv);
+  enumcase(RMAPut);
+  enumcase(RMAGet);
+  enumcase(RecvRMADone);
+  enumcase(NativeCollective);
   enumcase(Null);
   }
 }
@@ -59,6 +87,10 @@ PendingMPI::clear()
   recv_buf = 0;
   msg = 0;
   smsg_tag = 0;
+  chunked = 0;
+  chunk = 0;
+  slot = -1;
+  persistent = false;
   //smsg_send_buf = 0;
   //smsg_recv_buf = 0;
   type = Null;
@@ -85,6 +117,9 @@ mpi_transport::tostr(tag_t tag)
    enumcase(ping_request_tag);
    enumcase(ping_response_tag);
    enumcase(transaction_ack);
+   enumcase(terminate_tag);
+   enumcase(rma_done_tag);
+   enumcase(native_comm_tag);
    default:
      break;
   }
@@ -96,14 +131,71 @@ mpi_transport::tostr(tag_t tag)
 }
 
 mpi_transport::mpi_transport() :
- max_num_requests_(1000),
+ ping_status_(i_am_alive),
  poll_burst_size_(5),
- ping_status_(i_am_alive)
+ rdma_chunk_size_(0),
+ rdma_chunk_window_(4),
+ num_rails_(1),
+ rail_stripe_threshold_(65536),
+ next_get_tag_(rdma_get_payload_tag),
+ num_preposted_(16),
+ num_preposted_reqs_(0),
+ preposted_reqs_(0),
+ preposted_(0),
+ preposted_bufs_(0),
+ preposted_indices_(0),
+ preposted_status_(0),
+ preposted_heads_(0),
+ preposted_done_(0),
+ rma_(false),
+ native_collectives_(false)
 {
 }
 
+void
+mpi_transport::init_factory_params(sprockit::sim_parameters* params)
+{
+  active_msg_transport::init_factory_params(params);
+  //all ranks must agree on these - both sides of a transfer chunk independently
+  rdma_chunk_size_ = params->get_optional_byte_length_param("rdma_chunk_size", 0);
+  rdma_chunk_window_ = params->get_optional_int_param("rdma_chunk_window", 4);
+  if (rdma_chunk_window_ < 1){
+    spkt_throw_printf(sprockit::value_error,
+      "mpi_transport: rdma_chunk_window must be positive, got %d",
+      rdma_chunk_window_);
+  }
+  num_rails_ = params->get_optional_int_param("mpi_num_rails", 1);
+  if (num_rails_ < 1){
+    spkt_throw_printf(sprockit::value_error,
+      "mpi_transport: mpi_num_rails must be positive, got %d",
+      num_rails_);
+  }
+  rail_stripe_threshold_ = params->get_optional_byte_length_param("mpi_rail_stripe_threshold", 65536);
+  num_preposted_ = params->get_optional_int_param("mpi_preposted_recvs", 16);
+  if (num_preposted_ < 0){
+    spkt_throw_printf(sprockit::value_error,
+      "mpi_transport: mpi_preposted_recvs cannot be negative, got %d",
+      num_preposted_);
+  }
+  rma_ = params->get_optional_bool_param("mpi_rma", false);
+  native_collectives_ = params->get_optional_bool_param("mpi_native_collectives", false);
+}
+
 mpi_transport::~mpi_transport()
 {
+  int npending = all_pending_.size();
+  for (int i=0; i < npending; ++i){
+    delete all_pending_[i];
+  }
+  if (preposted_){
+    delete[] preposted_reqs_;
+    delete[] preposted_;
+    delete[] preposted_indices_;
+    delete[] preposted_status_;
+    delete[] preposted_heads_;
+    delete[] preposted_done_;
+    ::free(preposted_bufs_);
+  }
 }
 
 
@@ -197,16 +289,164 @@ mpi_transport::init()
   MPI_Comm_size(MPI_COMM_WORLD, &nproc_);
   MPI_Barrier(MPI_COMM_WORLD);
 
+  rails_.resize(num_rails_);
+  rails_[0] = MPI_COMM_WORLD;
+  for (int i=1; i < num_rails_; ++i){
+    MPI_Comm_dup(MPI_COMM_WORLD, &rails_[i]);
+  }
+
+  if (rma_){
+    MPI_Win_create_dynamic(MPI_INFO_NULL, MPI_COMM_WORLD, &win_);
+    //one passive epoch to every rank for the life of the transport
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, win_);
+  }
+
+  if (native_collectives_){
+    //sumi reductions are commutative
+    MPI_Op_create(&native_reduce, 1, &native_op_);
+    if (native_type_keyval == MPI_KEYVAL_INVALID){
+      MPI_Type_create_keyval(MPI_TYPE_NULL_COPY_FN, MPI_TYPE_NULL_DELETE_FN,
+                             &native_type_keyval, 0);
+    }
+  }
+
   active_msg_transport::init();
 
-  requests_ = new MPI_Request[max_num_requests_];
-  pending_ = new PendingMPI[max_num_requests_];
+  prepost_recvs();
+}
+
+void
+mpi_transport::prepost_recvs()
+{
+  if (num_preposted_ == 0)
+    return;
+
+  static const int num_tags = 3;
+  static const int tags[num_tags] = { smsg_send_tag, mpi_rdma_get_tag, mpi_rdma_put_tag };
+  static const PendingMPI::type_t types[num_tags] = {
+    PendingMPI::SmsgRecv, PendingMPI::RecvGetReq, PendingMPI::RecvPutReq };
+
+  int num_per_rail = num_tags * num_preposted_;
+  int num_reqs = num_per_rail * num_rails_;
+  num_preposted_reqs_ = num_reqs;
+  preposted_reqs_ = new MPI_Request[num_reqs];
+  preposted_ = new PendingMPI[num_reqs];
+  preposted_indices_ = new int[num_reqs];
+  preposted_status_ = new MPI_Status[num_reqs];
+  preposted_bufs_ = (char*) ::malloc(num_reqs * smsg_buffer_size_);
+  int num_rings = num_tags * num_rails_;
+  preposted_heads_ = new int[num_rings];
+  for (int r=0; r < num_rings; ++r){
+    preposted_heads_[r] = 0;
+  }
+  preposted_done_ = new bool[num_reqs];
+
+  for (int i=0; i < num_reqs; ++i){
+    PendingMPI* pending = &preposted_[i];
+    int tag_idx = (i % num_per_rail) / num_preposted_;
+    int tag = tags[tag_idx];
+    MPI_Comm comm = rails_[i / num_per_rail];
+    pending->req = &preposted_reqs_[i];
+    pending->type = types[tag_idx];
+    pending->smsg_tag = tag;
+    pending->recver = rank_;
+    pending->recv_buf = preposted_bufs_ + i*smsg_buffer_size_;
+    pending->persistent = true;
+    preposted_done_[i] = false;
+    MPI_Recv_init(pending->recv_buf, smsg_buffer_size_, MPI_BYTE, MPI_ANY_SOURCE,
+                  tag, comm, pending->req);
+  }
+  MPI_Startall(num_reqs, preposted_reqs_);
+}
+
+void
+mpi_transport::cancel_preposted()
+{
+  if (num_preposted_ == 0)
+    return;
+
+  int num_reqs = num_preposted_reqs_;
+  for (int i=0; i < num_reqs; ++i){
+    MPI_Cancel(&preposted_reqs_[i]);
+  }
+  MPI_Waitall(num_reqs, preposted_reqs_, MPI_STATUSES_IGNORE);
+  for (int i=0; i < num_reqs; ++i){
+    MPI_Request_free(&preposted_reqs_[i]);
+  }
+}
+
+int
+mpi_transport::poll_preposted()
+{
+  if (num_preposted_ == 0)
+    return 0;
+
+  int num_done;
+  lock();
+  MPI_Testsome(num_preposted_reqs_, preposted_reqs_, &num_done,
+               preposted_indices_, preposted_status_);
+  unlock();
+  if (num_done == MPI_UNDEFINED)
+    return 0;
+
+  for (int i=0; i < num_done; ++i){
+    int idx = preposted_indices_[i];
+    PendingMPI* pending = &preposted_[idx];
+    MPI_Status* status = &preposted_status_[i];
+    pending->sender = status->MPI_SOURCE;
+    MPI_Get_count(status, MPI_BYTE, &pending->size);
+    preposted_done_[idx] = true;
+
+    mpi_debug_out("pre-posted recv on tag %s of size %d from src %d",
+      tostr((tag_t)pending->smsg_tag), pending->size, pending->sender);
+  }
 
+  //MPI matches each sender's messages to the receives of a ring in the
+  //order they were started, not the index order Testsome reports them in.
+  //Every ring is restarted in a fixed rotation, so handle completions from
+  //the oldest receive on - a later one can only have completed after the
+  //older ones were matched, so anything held back here shows up soon
+  int num_processed = 0;
+  int num_rings = num_preposted_reqs_ / num_preposted_;
+  for (int r=0; r < num_rings; ++r){
+    int& head = preposted_heads_[r];
+    int idx = r*num_preposted_ + head;
+    while (preposted_done_[idx]){
+      preposted_done_[idx] = false;
+      PendingMPI* pending = &preposted_[idx];
+      process_eager(pending);
+
+      //the buffer has been consumed, re-arm the receive
+      lock();
+      MPI_Start(pending->req);
+      unlock();
+
+      head = (head + 1) % num_preposted_;
+      idx = r*num_preposted_ + head;
+      ++num_processed;
+    }
+  }
+  return num_processed;
+}
 
-  for (int i=0; i < max_num_requests_; ++i){
-      pending_[i].req = &requests_[i];
-      pending_[i].id = i;
-      free_pending(&pending_[i]);
+void
+mpi_transport::process_eager(PendingMPI* pending)
+{
+  switch(pending->type)
+  {
+  case PendingMPI::SmsgRecv:
+    process_smsg(pending);
+    break;
+  case PendingMPI::RecvGetReq:
+    process_rdma_get_req(pending);
+    break;
+  case PendingMPI::RecvPutReq:
+    process_rdma_put_req(pending);
+    break;
+  default:
+    spkt_throw_printf(sprockit::value_error,
+      "mpi_transport::process_eager: invalid pending type %s",
+      PendingMPI::tostr(pending->type));
   }
 }
 
@@ -219,16 +459,44 @@ mpi_transport::clear_pending(PendingMPI* pending)
 void
 mpi_transport::free_pending(PendingMPI *pending)
 {
+  if (pending->type == PendingMPI::RDMAGetRecv){
+    free_get_tag(pending->rdma_tag);
+  }
   clear_pending(pending);
   pending_pool_.push_back(pending);
 }
 
+int
+mpi_transport::allocate_get_tag()
+{
+  if (!free_get_tags_.empty()){
+    int tag = free_get_tags_.back();
+    free_get_tags_.pop_back();
+    return tag;
+  }
+  //get payload tags must stay below the put payload tags
+  if (next_get_tag_ == rdma_put_payload_tag){
+    spkt_throw_printf(sprockit::value_error,
+      "mpi_transport: more than %d rdma gets in flight",
+      rdma_put_payload_tag - rdma_get_payload_tag);
+  }
+  return next_get_tag_++;
+}
+
+void
+mpi_transport::free_get_tag(int tag)
+{
+  free_get_tags_.push_back(tag);
+}
+
 PendingMPI*
 mpi_transport::allocate_pending()
 {
   if (pending_pool_.empty()){
-    spkt_throw(sprockit::value_error,
-      "too many pending mpi requests allocated");
+    PendingMPI* pending = new PendingMPI;
+    pending->id = all_pending_.size();
+    all_pending_.push_back(pending);
+    pending_pool_.push_back(pending);
   }
   PendingMPI* ret = pending_pool_.back();
   pending_pool_.pop_back();
@@ -248,20 +516,18 @@ mpi_transport::transport_smsg_send(int dst, int tag, PendingMPI::type_t ty,
     ::memcpy(send_buffer, extra_md, md_size);
     ser_buffer += md_size;
   }
-  sprockit::serializer ser;
-  ser.start_packing(ser_buffer, smsg_buffer_size_);
-  ser & msg;
+  int msg_size = wire_header::pack(msg, ser_buffer, smsg_buffer_size_ - md_size);
 
   mpi_debug_out("transport send %s to %d on tag %s of type %s of size %d, extra %d",
     msg->to_string().c_str(), dst, tostr((tag_t)tag), PendingMPI::tostr(ty),
-    ser.packer().size(), md_size);
+    msg_size, md_size);
 
-  int total_size = ser.packer().size() + md_size;
+  int total_size = msg_size + md_size;
 
   pending->type = ty;
   pending->send_buf = send_buffer;
   pending->smsg_tag = tag;
-  MPI_Isend(send_buffer, total_size, MPI_BYTE, dst, tag, MPI_COMM_WORLD, pending->req);
+  MPI_Isend(send_buffer, total_size, MPI_BYTE, dst, tag, smsg_rail(dst), pending->req);
   add_pending(pending);
 
 }
@@ -269,13 +535,11 @@ mpi_transport::transport_smsg_send(int dst, int tag, PendingMPI::type_t ty,
 char*
 mpi_transport::allocate_smsg_buffer()
 {
-  try {
-    return active_msg_transport::allocate_smsg_buffer();
-  } catch (const std::exception& e) {
-    std::cerr << sprockit::printf("There are %ld pending MPI on %d original buffers\n",
-      pending_mpi_.size(), 1000);
-    throw e;
+  //there is no cap on outstanding requests, so none on their buffers either
+  if (smsg_buffer_pool_.empty()){
+    free_smsg_buffer(::malloc(smsg_buffer_size_));
   }
+  return active_msg_transport::allocate_smsg_buffer();
 }
 
 void
@@ -299,9 +563,322 @@ mpi_transport::do_smsg_send(int dst, const message::ptr &msg)
   unlock();
 }
 
+public_buffer
+mpi_transport::register_public_buffer(void* buffer, int size)
+{
+  if (rma_){
+    lock();
+    attach((uintptr_t) buffer, size);
+    unlock();
+  }
+  return public_buffer(buffer);
+}
+
+void
+mpi_transport::unregister_public_buffer(public_buffer buf, int size)
+{
+  if (rma_){
+    lock();
+    detach((uintptr_t) buf.ptr, size);
+    unlock();
+  }
+}
+
+void
+mpi_transport::attach(uintptr_t start, long size)
+{
+  uintptr_t stop = start + size;
+  uintptr_t pos = start;
+  std::map<uintptr_t, attached_region>::iterator it = attached_.upper_bound(start);
+  if (it != attached_.begin()){
+    std::map<uintptr_t, attached_region>::iterator prev = it;
+    --prev;
+    if (prev->first + prev->second.size > start) it = prev;
+  }
+
+  while (pos < stop){
+    uintptr_t gap_stop = (it == attached_.end() || it->first >= stop) ? stop : it->first;
+    if (gap_stop > pos){
+      MPI_Win_attach(win_, (void*) pos, gap_stop - pos);
+      attached_region& piece = attached_[pos];
+      piece.size = gap_stop - pos;
+      piece.refcount = 1;
+      mpi_debug_out("attached [%p,%p)", (void*) pos, (void*) gap_stop);
+    }
+    if (gap_stop == stop) break;
+
+    ++it->second.refcount;
+    pos = it->first + it->second.size;
+    ++it;
+  }
+}
+
+void
+mpi_transport::detach(uintptr_t start, long size)
+{
+  uintptr_t stop = start + size;
+  std::map<uintptr_t, attached_region>::iterator it = attached_.upper_bound(start);
+  if (it != attached_.begin()){
+    std::map<uintptr_t, attached_region>::iterator prev = it;
+    --prev;
+    if (prev->first + prev->second.size > start) it = prev;
+  }
+
+  while (it != attached_.end() && it->first < stop){
+    --it->second.refcount;
+    if (it->second.refcount == 0){
+      mpi_debug_out("detached [%p,%p)", (void*) it->first,
+                    (void*) (it->first + it->second.size));
+      MPI_Win_detach(win_, (void*) it->first);
+      attached_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+}
+
+MPI_Comm
+mpi_transport::native_comm(domain* dom)
+{
+  if (dom == global_dom())
+    return MPI_COMM_WORLD;
+
+  int nproc = dom->nproc();
+  std::vector<int> ranks(nproc);
+  for (int i=0; i < nproc; ++i){
+    ranks[i] = dom->domain_to_global_rank(i);
+  }
+
+  std::map<std::vector<int>, MPI_Comm>::iterator it = native_comms_.find(ranks);
+  if (it != native_comms_.end())
+    return it->second;
+
+  //only members of the domain take part, so this is not collective over the world
+  MPI_Group world_group, dom_group;
+  MPI_Comm comm;
+  MPI_Comm_group(MPI_COMM_WORLD, &world_group);
+  MPI_Group_incl(world_group, ranks.size(), &ranks[0], &dom_group);
+  MPI_Comm_create_group(MPI_COMM_WORLD, dom_group, native_comm_tag, &comm);
+  MPI_Group_free(&dom_group);
+  MPI_Group_free(&world_group);
+  native_comms_[ranks] = comm;
+  return comm;
+}
+
+MPI_Datatype
+mpi_transport::native_type(reduce_fxn fxn, int type_size)
+{
+  std::pair<reduce_fxn,int> key(fxn, type_size);
+  std::map<std::pair<reduce_fxn,int>, MPI_Datatype>::iterator it = native_types_.find(key);
+  if (it != native_types_.end())
+    return it->second;
+
+  //an opaque element type - native_reduce maps it back to the function
+  MPI_Datatype type;
+  MPI_Type_contiguous(type_size, MPI_BYTE, &type);
+  MPI_Type_commit(&type);
+  MPI_Type_set_attr(type, native_type_keyval, this);
+  native_types_[key] = type;
+  native_reduce_fxns_[type] = fxn;
+  return type;
+}
+
+PendingMPI*
+mpi_transport::start_native_collective(collective::type_t ty, int tag, domain* dom, void* result)
+{
+  collective_started(ty, tag);
+  collective_done_message::ptr dmsg = new collective_done_message(tag, ty, dom);
+  dmsg->set_domain_rank(dom->my_domain_rank());
+  dmsg->set_result(result);
+
+  mpi_debug_out("starting native %s on tag %d over %d ranks",
+    collective::tostr(ty), tag, dom->nproc());
+
+  PendingMPI* pending = allocate_pending();
+  pending->type = PendingMPI::NativeCollective;
+  pending->msg = dmsg;
+  return pending;
+}
+
+void
+mpi_transport::allreduce(void* dst, void* src, int nelems, int type_size, int tag,
+  reduce_fxn fxn, bool fault_aware, int context, domain* dom)
+{
+  //null buffers mean payloads are ignored, which only the DAG path understands
+  if (!use_native_collective(fault_aware, context) || dst == 0){
+    transport::allreduce(dst, src, nelems, type_size, tag, fxn, fault_aware, context, dom);
+    return;
+  }
+
+  CHECK_IF_I_AM_DEAD(return);
+  if (dom == 0) dom = global_dom();
+  void* send_buf = (src == 0 || src == dst) ? MPI_IN_PLACE : src;
+
+  lock();
+  MPI_Comm comm = native_comm(dom);
+  PendingMPI* pending = start_native_collective(collective::allreduce, tag, dom, dst);
+  MPI_Iallreduce(send_buf, dst, nelems, native_type(fxn, type_size),
+                 native_op_, comm, pending->req);
+  add_pending(pending);
+  unlock();
+}
+
+void
+mpi_transport::allgather(void* dst, void* src, int nelems, int type_size, int tag,
+  bool fault_aware, int context, domain* dom)
+{
+  if (!use_native_collective(fault_aware, context) || dst == 0 || src == 0){
+    transport::allgather(dst, src, nelems, type_size, tag, fault_aware, context, dom);
+    return;
+  }
+
+  CHECK_IF_I_AM_DEAD(return);
+  if (dom == 0) dom = global_dom();
+  int bytes = nelems * type_size;
+
+  lock();
+  MPI_Comm comm = native_comm(dom);
+  PendingMPI* pending = start_native_collective(collective::allgather, tag, dom, dst);
+  MPI_Iallgather(src, bytes, MPI_BYTE, dst, bytes, MPI_BYTE, comm, pending->req);
+  add_pending(pending);
+  unlock();
+}
+
+void
+mpi_transport::bcast(void* buf, int nelems, int type_size, int tag,
+  bool fault_aware, int context, domain* dom)
+{
+  if (!use_native_collective(fault_aware, context) || buf == 0){
+    transport::bcast(buf, nelems, type_size, tag, fault_aware, context, dom);
+    return;
+  }
+
+  CHECK_IF_I_AM_DEAD(return);
+  if (dom == 0) dom = global_dom();
+
+  lock();
+  MPI_Comm comm = native_comm(dom);
+  PendingMPI* pending = start_native_collective(collective::bcast, tag, dom, buf);
+  //domain rank 0 is always the root
+  MPI_Ibcast(buf, nelems * type_size, MPI_BYTE, 0, comm, pending->req);
+  add_pending(pending);
+  unlock();
+}
+
+void
+mpi_transport::barrier(int tag, bool fault_aware, domain* dom)
+{
+  if (!use_native_collective(fault_aware, options::initial_context)){
+    transport::barrier(tag, fault_aware, dom);
+    return;
+  }
+
+  CHECK_IF_I_AM_DEAD(return);
+  if (dom == 0) dom = global_dom();
+
+  lock();
+  MPI_Comm comm = native_comm(dom);
+  PendingMPI* pending = start_native_collective(collective::barrier, tag, dom, 0);
+  MPI_Ibarrier(comm, pending->req);
+  add_pending(pending);
+  unlock();
+}
+
+void
+mpi_transport::rma_get(int src, const message::ptr& msg)
+{
+  long bytes = msg->byte_length();
+  void* recver_buf = msg->local_buffer();
+  //addresses in a dynamic window are absolute
+  MPI_Aint sender_addr = (MPI_Aint) msg->remote_buffer().ptr;
+
+  lock();
+  PendingMPI* pending = allocate_pending();
+  mpi_debug_out("rma get %s from %d for local buffer %p, remote buffer %p",
+    msg->to_string().c_str(), src, recver_buf, (void*) sender_addr);
+  pending->type = PendingMPI::RMAGet;
+  pending->msg = msg;
+  pending->sender = src;
+  pending->recver = rank_;
+  pending->size = bytes;
+  MPI_Rget(recver_buf, bytes, MPI_BYTE, src, sender_addr,
+           bytes, MPI_BYTE, win_, pending->req);
+  add_pending(pending);
+  unlock();
+}
+
+void
+mpi_transport::rma_put(int dst, const message::ptr& msg)
+{
+  long bytes = msg->byte_length();
+  void* sender_buf = msg->local_buffer();
+  MPI_Aint recver_addr = (MPI_Aint) msg->remote_buffer().ptr;
+
+  lock();
+  PendingMPI* pending = allocate_pending();
+  mpi_debug_out("rma put %s to %d for local buffer %p, remote buffer %p",
+    msg->to_string().c_str(), dst, sender_buf, (void*) recver_addr);
+  pending->type = PendingMPI::RMAPut;
+  pending->msg = msg;
+  pending->sender = rank_;
+  pending->recver = dst;
+  pending->size = bytes;
+  MPI_Rput(sender_buf, bytes, MPI_BYTE, dst, recver_addr,
+           bytes, MPI_BYTE, win_, pending->req);
+  add_pending(pending);
+  unlock();
+}
+
+void
+mpi_transport::send_rma_done(int dst, PendingMPI::type_t ty, const message::ptr& msg)
+{
+  int md = ty;
+  lock();
+  transport_smsg_send(dst, rma_done_tag, PendingMPI::SmsgSend, msg, &md, sizeof(int));
+  unlock();
+}
+
+void
+mpi_transport::rma_done(PendingMPI* pending)
+{
+  const message::ptr& msg = pending->msg;
+  if (pending->type == PendingMPI::RMAPut){
+    //the request only guarantees local completion
+    lock();
+    MPI_Win_flush(pending->recver, win_);
+    unlock();
+    if (msg->needs_recv_ack()){
+      send_rma_done(pending->recver, PendingMPI::RDMAPutRecv, msg);
+    }
+    rdma_done(PendingMPI::RDMAPutSend, msg);
+  } else {
+    //the owner of the data is only involved if it wants to know
+    if (msg->needs_send_ack()){
+      send_rma_done(pending->sender, PendingMPI::RDMAGetSend, msg);
+    }
+    rdma_done(PendingMPI::RDMAGetRecv, msg);
+  }
+}
+
+void
+mpi_transport::process_rma_done(PendingMPI* pending)
+{
+  CHECK_IF_I_AM_DEAD(return);
+  int ty;
+  message::ptr msg = deserialize_smsg(pending, &ty, sizeof(int));
+  mpi_debug_out("process rma done %s from %d",
+    PendingMPI::tostr((PendingMPI::type_t)ty), pending->sender);
+  rdma_done((PendingMPI::type_t) ty, msg);
+}
+
 void
 mpi_transport::do_rdma_get(int src, const message::ptr &msg)
 {
+  if (rma_){
+    rma_get(src, msg);
+    return;
+  }
+
   long bytes = msg->byte_length();
   void* sender_buf = msg->remote_buffer();
   void* recver_buf = msg->local_buffer();
@@ -309,7 +886,8 @@ mpi_transport::do_rdma_get(int src, const message::ptr &msg)
 
   PendingMPI* pending_recv = allocate_pending();
 
-  int rdma_tag = pending_recv->id + rdma_get_payload_tag;
+  //held until the payload lands, so no two gets in flight share a tag
+  int rdma_tag = allocate_get_tag();
   mpi_debug_out("rdma get %s from %d on rdma tag %d for local buffer %p, remote buffer %p",
     msg->to_string().c_str(), src, rdma_tag, recver_buf, sender_buf);
   pending_recv->type = PendingMPI::RDMAGetRecv;
@@ -321,6 +899,16 @@ mpi_transport::do_rdma_get(int src, const message::ptr &msg)
   pending_recv->recv_buf = recver_buf;
   pending_recv->size = bytes;
 
+  if (use_chunked_rdma(bytes)){
+    PendingChunkedRDMA* xfer = start_chunked_rdma(PendingMPI::RDMAGetRecv,
+                                    msg, recver_buf, bytes, src, rdma_tag);
+    //never posted, but holds onto the tag until all chunks land
+    xfer->anchor = pending_recv;
+    transport_smsg_send(src, mpi_rdma_get_tag, PendingMPI::SendGetReq, msg, &rdma_tag, sizeof(int));
+    unlock();
+    return;
+  }
+
   //when the "RDMA get" request is received on the other end,
   //it will match this receive
   MPI_Irecv(pending_recv->recv_buf,
@@ -373,6 +961,11 @@ mpi_transport::do_rdma_put(int dst, const message::ptr &msg)
 {
   CHECK_IF_I_AM_DEAD(return);
 
+  if (rma_){
+    rma_put(dst, msg);
+    return;
+  }
+
   long bytes = msg->byte_length();
   void* sender_buf = msg->local_buffer();
   void* recver_buf = msg->remote_buffer();
@@ -386,6 +979,13 @@ mpi_transport::do_rdma_put(int dst, const message::ptr &msg)
 
   transport_smsg_send(dst, mpi_rdma_put_tag, PendingMPI::SendPutReq, msg, &rdma_tag, sizeof(int));
 
+  if (use_chunked_rdma(bytes)){
+    free_pending(pending_put);
+    start_chunked_rdma(PendingMPI::RDMAPutSend, msg, sender_buf, bytes, dst, rdma_tag);
+    unlock();
+    return;
+  }
+
   pending_put->type = PendingMPI::RDMAPutSend;
   pending_put->sender = rank_;
   pending_put->recver = dst;
@@ -416,7 +1016,7 @@ mpi_transport::do_nvram_get(int src, const message::ptr &msg)
 }
 
 void
-mpi_transport::new_incoming_msg(int src, int tag, int size)
+mpi_transport::new_incoming_msg(int src, int tag, int size, MPI_Comm comm)
 {
   if (tag >= rdma_get_payload_tag)
     return;
@@ -430,10 +1030,10 @@ mpi_transport::new_incoming_msg(int src, int tag, int size)
     recv_transaction_ack(src);
     break;
   case mpi_rdma_put_tag:
-    recv_rdma_req(src, size, tag, PendingMPI::RecvPutReq);
+    recv_overflow(src, tag, size, PendingMPI::RecvPutReq, comm);
     break;
   case mpi_rdma_get_tag:
-    recv_rdma_req(src, size, tag, PendingMPI::RecvGetReq);
+    recv_overflow(src, tag, size, PendingMPI::RecvGetReq, comm);
     break;
   case ping_request_tag:
     recv_ping_request(src);
@@ -444,8 +1044,11 @@ mpi_transport::new_incoming_msg(int src, int tag, int size)
   case terminate_tag:
     recv_terminate(src);
     break;
+  case rma_done_tag:
+    recv_rdma_req(src, size, tag, PendingMPI::RecvRMADone, comm);
+    break;
   case smsg_send_tag:
-    recv_smsg(src, tag, size);
+    recv_overflow(src, tag, size, PendingMPI::SmsgRecv, comm);
     break;
   default: //data payload
   {
@@ -461,64 +1064,92 @@ mpi_transport::add_pending(PendingMPI *pending)
     spkt_throw(sprockit::value_error,
       "got pending MPI with null type");
   }
-  pending_mpi_.push_back(pending);
+  int slot;
+  if (free_slots_.empty()){
+    slot = requests_.size();
+    requests_.push_back(MPI_REQUEST_NULL);
+    request_owners_.push_back(0);
+    done_indices_.push_back(0);
+  } else {
+    slot = free_slots_.back();
+    free_slots_.pop_back();
+  }
+  //the request handle moves into the array, MPI only needs the value.
+  //null the original so nothing can wait on or cancel a stale copy
+  requests_[slot] = *pending->req;
+  *pending->req = MPI_REQUEST_NULL;
+  request_owners_[slot] = pending;
+  pending->slot = slot;
 }
 
 void
-mpi_transport::poll()
+mpi_transport::poll(MPI_Comm comm)
 {
   MPI_Status status;
   int flag = 0;
   lock();
-  int err = MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &flag, &status);
+  int err = MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, comm, &flag, &status);
   unlock();
   if (!flag)
     return;
 
   int count;
   MPI_Get_count(&status, MPI_BYTE, &count);
-  new_incoming_msg(status.MPI_SOURCE, status.MPI_TAG, count);
+  new_incoming_msg(status.MPI_SOURCE, status.MPI_TAG, count, comm);
 }
 
 void
-mpi_transport::recv_smsg(int src, int tag, int size)
+mpi_transport::recv_overflow(int src, int tag, int size, PendingMPI::type_t ty, MPI_Comm comm)
 {
-  //allocate the tuple buffer
-  lock();
-  char* recv_buffer = allocate_smsg_buffer();
-  PendingMPI* pending = allocate_pending();
   if (size > smsg_buffer_size_){
-    spkt_throw(sprockit::value_error,
+    spkt_throw_printf(sprockit::value_error,
       "incoming smsg on tag %d of size %d exceeds max buffer size %d",
       tag, size, smsg_buffer_size_);
   }
-  mpi_debug_out("receiving smsg from %d on tag %s of size %d", src, tostr((tag_t)tag), size);
-  MPI_Irecv(recv_buffer, size, MPI_BYTE, src, tag, MPI_COMM_WORLD, pending->req);
-  pending->type = PendingMPI::SmsgRecv;
+  mpi_debug_out("receiving overflow smsg from %d on tag %s of size %d",
+    src, tostr((tag_t)tag), size);
+
+  //the probed message is already here and is the first from src on this tag,
+  //so the receive completes at once. Take it before draining the ring -
+  //restarting a pre-posted receive could otherwise match it
+  MPI_Status status;
+  lock();
+  char* recv_buffer = allocate_smsg_buffer();
+  PendingMPI* pending = allocate_pending();
+  MPI_Recv(recv_buffer, size, MPI_BYTE, src, tag, comm, &status);
+  unlock();
+
+  pending->type = ty;
   pending->sender = src;
   pending->recver = rank_;
-  pending->size = size;
+  MPI_Get_count(&status, MPI_BYTE, &pending->size);
   pending->smsg_tag = tag;
   pending->recv_buf = recv_buffer;
-  add_pending(pending);
+
+  //it only missed the ring because every receive there was taken,
+  //so older messages from src may still be sitting in the ring
+  poll_preposted();
+  process_eager(pending);
+
+  lock();
+  free_pending(pending);
   unlock();
 }
 
 message::ptr
 mpi_transport::deserialize_smsg(PendingMPI* pending, void* extra_md, int md_size)
 {
-  sprockit::serializer ser;
   char* ser_buffer = (char*) pending->recv_buf;
   if (extra_md){
     ::memcpy(extra_md, ser_buffer, md_size);
     ser_buffer += md_size;
   }
-  ser.start_unpacking(ser_buffer, pending->size);
-  message::ptr msg;
-  ser & msg;
-  lock();
-  free_smsg_buffer(pending->recv_buf);
-  unlock();
+  message::ptr msg = wire_header::unpack(ser_buffer, pending->size - md_size, this);
+  if (!pending->persistent){
+    lock();
+    free_smsg_buffer(pending->recv_buf);
+    unlock();
+  }
   return msg;
 }
 
@@ -534,8 +1165,14 @@ mpi_transport::process_smsg(PendingMPI *pending)
 void
 mpi_transport::poll_burst()
 {
+  poll_preposted();
+  //eager traffic only shows up here if every pre-posted receive was busy
   for (int i=0; i < poll_burst_size_; ++i){
-      poll();
+      poll(MPI_COMM_WORLD);
+  }
+  //the other rails only ever carry eager traffic
+  for (int i=1; i < num_rails_; ++i){
+    poll(rails_[i]);
   }
   //check_pings();
   maybe_do_heartbeat();
@@ -553,47 +1190,56 @@ void
 mpi_transport::wait_on_pending()
 {
   lock();
+  if (free_slots_.size() == requests_.size()){
+    //nothing in flight
+    unlock();
+    return;
+  }
 
-  std::list<PendingMPI*> pending_done;
-
-  std::list<PendingMPI*>::iterator tmp,
-          it = pending_mpi_.begin(),
-          end = pending_mpi_.end();
+  int num_done;
+  MPI_Testsome(requests_.size(), &requests_[0], &num_done,
+               &done_indices_[0], MPI_STATUSES_IGNORE);
+  if (num_done == MPI_UNDEFINED){
+    unlock();
+    return;
+  }
 
-  while (it != end){
-    tmp = it++;
-    PendingMPI* pending = *tmp;
-    int done;
-    MPI_Test(pending->req, &done, MPI_STATUS_IGNORE);
-    if (done){
-      pending_done.push_back(pending);
-      pending_mpi_.erase(tmp);
-    }
+  std::vector<PendingMPI*> pending_done(num_done);
+  for (int i=0; i < num_done; ++i){
+    int slot = done_indices_[i];
+    pending_done[i] = request_owners_[slot];
+    request_owners_[slot] = 0;
+    free_slots_.push_back(slot);
   }
   unlock();
 
-  end = pending_done.end();
-  for (it=pending_done.begin(); it != end; ++it)
+  for (int i=0; i < num_done; ++i)
   {
-    PendingMPI* pending = *it;
+    PendingMPI* pending = pending_done[i];
     mpi_debug_out("Finishing up pending %s", PendingMPI::tostr(pending->type));
     switch(pending->type)
     {
     case PendingMPI::RDMAGetRecv:
-    {
-      if (pending->msg->needs_recv_ack()){
-        pending->msg->set_payload_type(message::rdma_get);
-        handle(pending->msg);
-      }
-      break;
-    }
     case PendingMPI::RDMAPutRecv:
-    {
-      mpi_debug_out("received RDMA put, need ack? %d",
-        pending->msg->needs_recv_ack());
-      if (pending->msg->needs_recv_ack()){
-        handle(pending->msg);
-      }
+    case PendingMPI::RDMAPutSend:
+    case PendingMPI::RDMAGetSend:
+      rdma_done(pending->type, pending->msg);
+      break;
+    case PendingMPI::RDMAChunkSend:
+    case PendingMPI::RDMAChunkRecv:
+      process_rdma_chunk(pending);
+      break;
+    case PendingMPI::RMAPut:
+    case PendingMPI::RMAGet:
+      rma_done(pending);
+      break;
+    case PendingMPI::RecvRMADone:
+      process_rma_done(pending);
+      break;
+    case PendingMPI::NativeCollective: {
+      collective_done_message::ptr dmsg = ptr_safe_cast(collective_done_message, pending->msg);
+      collective_finished(dmsg->type(), dmsg->tag());
+      handle(dmsg);
       break;
     }
     case PendingMPI::RecvPutReq:
@@ -614,19 +1260,6 @@ mpi_transport::wait_on_pending()
       spkt_throw(sprockit::value_error,
         "cannot receive pending mpi request with value null");
       break;
-    case PendingMPI::RDMAPutSend:
-      if (pending->msg->needs_send_ack()){
-        message::ptr cln = pending->msg->clone_msg();
-        cln->set_payload_type(message::rdma_put_ack);
-        handle(cln);
-      }
-      break;
-    case PendingMPI::RDMAGetSend:
-      if (pending->msg->needs_send_ack()){
-        pending->msg->set_payload_type(message::rdma_get_ack);
-        handle(pending->msg); //pass the ack on up
-      }
-      break;
     case PendingMPI::SendPingResponse:
     case PendingMPI::SendPingRequest:
     case PendingMPI::SendPutAck:
@@ -638,25 +1271,199 @@ mpi_transport::wait_on_pending()
   }
 }
 
+void
+mpi_transport::rdma_done(PendingMPI::type_t ty, const message::ptr& msg)
+{
+  switch(ty)
+  {
+  case PendingMPI::RDMAGetRecv:
+    if (msg->needs_recv_ack()){
+      msg->set_payload_type(message::rdma_get);
+      handle(msg);
+    }
+    break;
+  case PendingMPI::RDMAPutRecv:
+    mpi_debug_out("received RDMA put, need ack? %d",
+      msg->needs_recv_ack());
+    if (msg->needs_recv_ack()){
+      handle(msg);
+    }
+    break;
+  case PendingMPI::RDMAPutSend:
+    if (msg->needs_send_ack()){
+      message::ptr cln = msg->clone_msg();
+      cln->set_payload_type(message::rdma_put_ack);
+      handle(cln);
+    }
+    break;
+  case PendingMPI::RDMAGetSend:
+    if (msg->needs_send_ack()){
+      msg->set_payload_type(message::rdma_get_ack);
+      handle(msg); //pass the ack on up
+    }
+    break;
+  default:
+    spkt_throw_printf(sprockit::value_error,
+      "mpi_transport::rdma_done: invalid pending type %s",
+      PendingMPI::tostr(ty));
+  }
+}
+
+PendingChunkedRDMA*
+mpi_transport::start_chunked_rdma(PendingMPI::type_t ty, const message::ptr& msg,
+  void* buf, long bytes, int peer, int rdma_tag)
+{
+  PendingChunkedRDMA* xfer = new PendingChunkedRDMA;
+  xfer->type = ty;
+  xfer->msg = msg;
+  xfer->buf = (char*) buf;
+  xfer->bytes = bytes;
+  xfer->peer = peer;
+  xfer->rdma_tag = rdma_tag;
+  xfer->chunk_size = rdma_chunk_size(bytes);
+  xfer->num_chunks = (bytes + xfer->chunk_size - 1) / xfer->chunk_size;
+  xfer->num_posted = 0;
+  xfer->num_done = 0;
+  xfer->num_contiguous = 0;
+  xfer->chunk_done.resize(xfer->num_chunks, false);
+  xfer->anchor = 0;
+
+  mpi_debug_out("starting chunked %s of %ld bytes with peer %d on tag %d in %d chunks",
+    PendingMPI::tostr(ty), bytes, peer, rdma_tag, xfer->num_chunks);
+
+  //keep every rail busy even if the window is small
+  int window = std::max(rdma_chunk_window_, num_rails_);
+  for (int i=0; i < window && xfer->num_posted < xfer->num_chunks; ++i){
+    post_rdma_chunk(xfer);
+  }
+  return xfer;
+}
+
+long
+mpi_transport::rdma_chunk_size(long bytes) const
+{
+  //both sides of a transfer must come up with the same answer
+  long stripe = bytes;
+  if (num_rails_ > 1 && bytes > rail_stripe_threshold_){
+    stripe = (bytes + num_rails_ - 1) / num_rails_;
+  }
+  if (rdma_chunk_size_ > 0){
+    return std::min(rdma_chunk_size_, stripe);
+  }
+  return stripe;
+}
+
+void
+mpi_transport::post_rdma_chunk(PendingChunkedRDMA* xfer)
+{
+  int chunk = xfer->num_posted++;
+  long offset = chunk * xfer->chunk_size;
+  long size = std::min(xfer->chunk_size, xfer->bytes - offset);
+  //chunks on a given rail are posted in the same order on both sides,
+  //so matching order still keeps them straight
+  MPI_Comm comm = rails_[chunk % num_rails_];
+
+  PendingMPI* pending = allocate_pending();
+  pending->chunked = xfer;
+  pending->chunk = chunk;
+  pending->size = size;
+  pending->rdma_tag = xfer->rdma_tag;
+  if (xfer->is_send()){
+    pending->type = PendingMPI::RDMAChunkSend;
+    pending->send_buf = xfer->buf + offset;
+    MPI_Isend(pending->send_buf, size, MPI_BYTE, xfer->peer,
+              xfer->rdma_tag, comm, pending->req);
+  } else {
+    pending->type = PendingMPI::RDMAChunkRecv;
+    pending->recv_buf = xfer->buf + offset;
+    MPI_Irecv(pending->recv_buf, size, MPI_BYTE, xfer->peer,
+              xfer->rdma_tag, comm, pending->req);
+  }
+  add_pending(pending);
+}
+
+void
+mpi_transport::process_rdma_chunk(PendingMPI* pending)
+{
+  PendingChunkedRDMA* xfer = pending->chunked;
+  xfer->chunk_done[pending->chunk] = true;
+  xfer->num_done++;
+
+  mpi_debug_out("finished chunk %d of %d for %s with peer %d on tag %d",
+    pending->chunk, xfer->num_chunks, PendingMPI::tostr(xfer->type),
+    xfer->peer, xfer->rdma_tag);
+
+  lock();
+  if (xfer->num_posted < xfer->num_chunks){
+    post_rdma_chunk(xfer);
+  }
+  unlock();
+
+  if (xfer->num_done < xfer->num_chunks){
+    if (!xfer->is_send()){
+      //only report progress on a contiguous prefix of the buffer
+      int old_contiguous = xfer->num_contiguous;
+      while (xfer->num_contiguous < xfer->num_chunks
+        && xfer->chunk_done[xfer->num_contiguous]){
+        xfer->num_contiguous++;
+      }
+      if (xfer->num_contiguous != old_contiguous){
+        rdma_chunk_recved(xfer->msg, xfer->num_contiguous * xfer->chunk_size);
+      }
+    }
+    return;
+  }
+
+  rdma_done(xfer->type, xfer->msg);
+  if (xfer->anchor){
+    lock();
+    free_pending(xfer->anchor);
+    unlock();
+  }
+  delete xfer;
+}
+
 void
 mpi_transport::finalize()
 {
   transport::finalize();
   MPI_Barrier(MPI_COMM_WORLD);
+  cancel_preposted();
+  for (int i=1; i < num_rails_; ++i){
+    MPI_Comm_free(&rails_[i]);
+  }
+  if (rma_){
+    MPI_Win_unlock_all(win_);
+    MPI_Win_free(&win_);
+  }
+  if (native_collectives_){
+    std::map<std::vector<int>, MPI_Comm>::iterator cit, cend = native_comms_.end();
+    for (cit=native_comms_.begin(); cit != cend; ++cit){
+      MPI_Comm_free(&cit->second);
+    }
+    std::map<std::pair<reduce_fxn,int>, MPI_Datatype>::iterator tit, tend = native_types_.end();
+    for (tit=native_types_.begin(); tit != tend; ++tit){
+      native_reduce_fxns_.erase(tit->second);
+      MPI_Type_free(&tit->second);
+    }
+    native_types_.clear();
+    MPI_Op_free(&native_op_);
+  }
   MPI_Finalize();
 }
 
 void
-mpi_transport::recv_rdma_req(int src, int size, int tag, PendingMPI::type_t ty)
+mpi_transport::recv_rdma_req(int src, int size, int tag, PendingMPI::type_t ty, MPI_Comm comm)
 {
   lock();
   char* recv_buffer = allocate_smsg_buffer();
   PendingMPI* pending_recv = allocate_pending();
   MPI_Irecv(recv_buffer, size, MPI_BYTE, src,
-            tag, MPI_COMM_WORLD, pending_recv->req);
+            tag, comm, pending_recv->req);
   pending_recv->type = ty;
   pending_recv->smsg_tag = tag;
-  pending_recv->size = sizeof(PendingMPI);
+  //exactly the probed message, the size comes from its status
+  pending_recv->size = size;
   pending_recv->recv_buf = recv_buffer;
   pending_recv->sender = src;
   pending_recv->recver = rank_;
@@ -688,6 +1495,13 @@ mpi_transport::process_rdma_put_req(PendingMPI* pending)
       rdma_tag);
 
 
+  if (use_chunked_rdma(bytes)){
+    start_chunked_rdma(PendingMPI::RDMAPutRecv, msg, recver_buf, bytes,
+                       pending->sender, rdma_tag);
+    unlock();
+    return;
+  }
+
   PendingMPI* pending_recv = allocate_pending();
   MPI_Irecv(recver_buf,
             bytes,
@@ -736,6 +1550,13 @@ mpi_transport::process_rdma_get_req(PendingMPI* pending)
       rdma_tag);
 
 
+  if (use_chunked_rdma(bytes)){
+    start_chunked_rdma(PendingMPI::RDMAGetSend, msg, sender_buf, bytes,
+                       pending->sender, rdma_tag);
+    unlock();
+    return;
+  }
+
   PendingMPI* pending_send = allocate_pending();
   MPI_Isend(sender_buf,
             bytes,
@@ -9,9 +9,12 @@
 #include <sumi/comm_functions.h>
 #include <sumi/active_msg_transport.h>
 #include <mpi.h>
+#include <vector>
+#include <map>
 
 namespace sumi {
 
+class PendingChunkedRDMA;
 
 class PendingMPI
 {
@@ -30,6 +33,12 @@ class PendingMPI
     RDMAPutSend,
     SendPingRequest,
     SendPingResponse,
+    RDMAChunkSend,
+    RDMAChunkRecv,
+    RMAPut,
+    RMAGet,
+    RecvRMADone,
+    NativeCollective,
     Null
   } type_t;
 
@@ -43,9 +52,17 @@ class PendingMPI
   type_t type;
   PendingMPI* rdma_req;
   int smsg_tag;
+  /** Where the request is posted, usually just request below */
   MPI_Request* req;
+  MPI_Request request;
+  /** Index into the transport's active request array, -1 if not active */
+  int slot;
   message::ptr msg;
   int id;
+  PendingChunkedRDMA* chunked;
+  int chunk;
+  /** A pre-posted receive that is restarted rather than freed */
+  bool persistent;
 
   PendingMPI();
 
@@ -56,6 +73,38 @@ class PendingMPI
 
 };
 
+/**
+ * Bookkeeping for a large RDMA transfer that has been split
+ * into fixed-size chunks, only a window of which are posted at once.
+ * All chunks go on the same tag and MPI matching order keeps them straight.
+ */
+class PendingChunkedRDMA
+{
+ public:
+  /** The type the whole transfer completes as */
+  PendingMPI::type_t type;
+  message::ptr msg;
+  char* buf;
+  long bytes;
+  /** Size of every chunk but the last */
+  long chunk_size;
+  int peer;
+  int rdma_tag;
+  int num_chunks;
+  int num_posted;
+  int num_done;
+  /** Chunks [0,num_contiguous) have all completed */
+  int num_contiguous;
+  std::vector<bool> chunk_done;
+  /** Holds onto a tag for the life of the transfer, if needed */
+  PendingMPI* anchor;
+
+  bool
+  is_send() const {
+    return type == PendingMPI::RDMAGetSend || type == PendingMPI::RDMAPutSend;
+  }
+};
+
 
 class mpi_transport :
   public active_msg_transport
@@ -70,17 +119,25 @@ class mpi_transport :
 
   void finalize();
 
+  virtual void
+  init_factory_params(sprockit::sim_parameters* params);
+
   void wait_on_pending();
 
-  public_buffer
-  allocate_public_buffer(int size){
-    return public_buffer(::malloc(size));
-  }
+  void
+  allreduce(void* dst, void* src, int nelems, int type_size, int tag,
+    reduce_fxn fxn, bool fault_aware, int context, domain* dom);
 
-  public_buffer
-  make_public_buffer(void* buf, int size){
-    return public_buffer(buf); //nothing to do
-  }
+  void
+  allgather(void* dst, void* src, int nelems, int type_size, int tag,
+    bool fault_aware, int context, domain* dom);
+
+  void
+  bcast(void* buf, int nelems, int type_size, int tag,
+    bool fault_aware, int context, domain* dom);
+
+  void
+  barrier(int tag, bool fault_aware, domain* dom);
 
  protected:
   void block_inner_loop();
@@ -97,32 +154,182 @@ class mpi_transport :
 
   void do_nvram_get(int src, const message::ptr &msg);
 
+  public_buffer
+  register_public_buffer(void* buffer, int size);
+
+  void
+  unregister_public_buffer(public_buffer buf, int size);
+
  private:
   int ping_status_;
 
-  int max_num_requests_;
-
   int poll_burst_size_;
 
-  MPI_Request* requests_;
+  /** Transfers larger than this are chunked, 0 disables chunking */
+  long rdma_chunk_size_;
+
+  /** Max number of chunks per transfer posted at once */
+  int rdma_chunk_window_;
+
+  int num_rails_;
+
+  /** Transfers larger than this are striped across all rails */
+  long rail_stripe_threshold_;
+
+  /**
+   * Rail 0 is MPI_COMM_WORLD, the rest are duplicates of it.
+   * Control traffic stays on rail 0.
+   */
+  std::vector<MPI_Comm> rails_;
+
+  /**
+   * Eager traffic to a given rank always uses the same rail
+   * so it stays ordered, but different peers spread out
+   */
+  MPI_Comm
+  smsg_rail(int dst) const {
+    return rails_[dst % num_rails_];
+  }
+
+  /**
+   * Every active request, contiguous so a single MPI_Testsome
+   * completes them. Slots are index-stable and reused, finished
+   * slots hold MPI_REQUEST_NULL until handed out again.
+   */
+  std::vector<MPI_Request> requests_;
 
-  PendingMPI* pending_;
+  /** The pending operation owning each slot of requests_ */
+  std::vector<PendingMPI*> request_owners_;
+
+  std::vector<int> free_slots_;
+
+  std::vector<int> done_indices_;
+
+  /** Every pending ever allocated - the pool grows on demand */
+  std::vector<PendingMPI*> all_pending_;
 
   std::list<PendingMPI*> pending_pool_;
 
-  std::list<PendingMPI*> pending_mpi_;
+  /**
+   * Get payload tags held by in-flight gets, recycled through a free list
+   * the way put payload tags are bounded by transaction ids
+   */
+  std::vector<int> free_get_tags_;
+
+  int next_get_tag_;
+
+  int allocate_get_tag();
+
+  void free_get_tag(int tag);
+
+  /** Number of persistent receives kept posted for each eager tag on each rail */
+  int num_preposted_;
+
+  int num_preposted_reqs_;
+
+  MPI_Request* preposted_reqs_;
 
-  std::list<MPI_Request*> request_pool_;
+  PendingMPI* preposted_;
 
-  void new_incoming_msg(int src, int tag, int size);
+  char* preposted_bufs_;
+
+  int* preposted_indices_;
+
+  MPI_Status* preposted_status_;
+
+  /** For each ring of receives on one tag and rail, the slot started longest ago */
+  int* preposted_heads_;
+
+  /** Completed receives held back until the older receives in their ring complete */
+  bool* preposted_done_;
+
+  /** Whether RDMA is one-sided MPI-3 RMA rather than matched send/recv */
+  bool rma_;
+
+  /** Dynamic window all public buffers are attached to in RMA mode */
+  MPI_Win win_;
+
+  struct attached_region {
+    long size;
+    int refcount;
+  };
+
+  /**
+   * Disjoint pieces of memory attached to #win_, keyed by start address.
+   * MPI forbids attaching overlapping memory, so a buffer overlapping
+   * pieces already attached only attaches the gaps between them.
+   * Each registration holds a reference on every piece it covers.
+   */
+  std::map<uintptr_t, attached_region> attached_;
+
+  void attach(uintptr_t start, long size);
+
+  void detach(uintptr_t start, long size);
+
+  void rma_put(int dst, const message::ptr& msg);
+
+  void rma_get(int src, const message::ptr& msg);
+
+  void rma_done(PendingMPI* pending);
+
+  void send_rma_done(int dst, PendingMPI::type_t ty, const message::ptr& msg);
+
+  void process_rma_done(PendingMPI* pending);
+
+  /**
+   * Whether collectives that need no fault tolerance go straight
+   * to the MPI library's nonblocking collectives
+   */
+  bool native_collectives_;
+
+  MPI_Op native_op_;
+
+  /** Communicators matching each domain's rank list */
+  std::map<std::vector<int>, MPI_Comm> native_comms_;
+
+  /** Datatypes carrying each reduce function into #native_op_ */
+  std::map<std::pair<reduce_fxn,int>, MPI_Datatype> native_types_;
+
+  /** Which reduce function each native datatype stands for */
+  std::map<MPI_Datatype, reduce_fxn> native_reduce_fxns_;
+
+  /**
+   * MPI op callbacks get no user data, so each native datatype carries
+   * its transport as an attribute
+   */
+  static void
+  native_reduce(void* in, void* inout, int* len, MPI_Datatype* dtype);
+
+  bool
+  use_native_collective(bool fault_aware, int context) const {
+    return native_collectives_ && !fault_aware
+      && context == options::initial_context;
+  }
+
+  MPI_Comm native_comm(domain* dom);
+
+  MPI_Datatype native_type(reduce_fxn fxn, int type_size);
+
+  PendingMPI*
+  start_native_collective(collective::type_t ty, int tag, domain* dom, void* result);
+
+  void prepost_recvs();
+
+  void cancel_preposted();
+
+  int poll_preposted();
+
+  void new_incoming_msg(int src, int tag, int size, MPI_Comm comm);
 
   void recv_ping_request(int src);
 
   void recv_ping_response(int src);
 
-  void recv_smsg(int src, int tag, int size);
+  void recv_overflow(int src, int tag, int size, PendingMPI::type_t ty, MPI_Comm comm);
+
+  void process_eager(PendingMPI* pending);
 
-  void recv_rdma_req(int src, int size, int tag, PendingMPI::type_t ty);
+  void recv_rdma_req(int src, int size, int tag, PendingMPI::type_t ty, MPI_Comm comm);
 
   void process_rdma_get_req(PendingMPI *pending);
 
@@ -136,6 +343,25 @@ class mpi_transport :
 
   void rdma_get_ack(const message::ptr& msg);
 
+  bool
+  use_chunked_rdma(long bytes) const {
+    return (rdma_chunk_size_ > 0 && bytes > rdma_chunk_size_)
+      || (num_rails_ > 1 && bytes > rail_stripe_threshold_);
+  }
+
+  long
+  rdma_chunk_size(long bytes) const;
+
+  PendingChunkedRDMA*
+  start_chunked_rdma(PendingMPI::type_t ty, const message::ptr& msg,
+    void* buf, long bytes, int peer, int rdma_tag);
+
+  void post_rdma_chunk(PendingChunkedRDMA* xfer);
+
+  void process_rdma_chunk(PendingMPI* pending);
+
+  void rdma_done(PendingMPI::type_t ty, const message::ptr& msg);
+
   message::ptr
   deserialize_smsg(PendingMPI* pending, void* extra_md = 0, int md_size = 0);
 
@@ -147,6 +373,8 @@ class mpi_transport :
    ping_response_tag = 4,
    transaction_ack = 5,
    terminate_tag = 6,
+   rma_done_tag = 7,
+   native_comm_tag = 8,
    rdma_get_payload_tag = 10,
    rdma_put_payload_tag = 16000
   } tag_t;
@@ -165,7 +393,7 @@ class mpi_transport :
 
   void clear_pending(PendingMPI* pending);
 
-  void poll();
+  void poll(MPI_Comm comm);
 
   void poll_burst();
 
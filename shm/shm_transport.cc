@@ -0,0 +1,547 @@
+#include <shm/shm_transport.h>
+#include <sumi/wire_header.h>
+#include <sprockit/serializer.h>
+#include <sprockit/sim_parameters.h>
+#include <sprockit/keyword_registration.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/prctl.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sched.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define shm_debug_out(...) \
+  debug_printf(sprockit::dbg::shm, "Rank %d: %s at t=%8.4e", rank(), sprockit::printf(__VA_ARGS__).c_str(), wall_time())
+
+DeclareDebugSlot(shm);
+RegisterDebugSlot(shm);
+
+RegisterKeywords(
+  "shm_rank",
+  "shm_nproc",
+  "shm_name",
+  "shm_queue_depth",
+  "shm_attach_timeout"
+);
+
+namespace sumi {
+
+SpktRegister("shm", transport, shm_transport,
+            "Create a SUMI transport for processes sharing a node");
+
+static const size_t cache_line = 64;
+
+static size_t
+round_up(size_t size)
+{
+  return (size + cache_line - 1) / cache_line * cache_line;
+}
+
+static int
+env_int(const char* name, int deflt)
+{
+  const char* str = getenv(name);
+  return str ? atoi(str) : deflt;
+}
+
+/**
+ * Every rank of a job must derive the same name, but two jobs sharing a
+ * node must not - rank 0 unlinks whatever it finds under the name at startup.
+ * Prefer a job id exported by the launcher or batch system, falling back
+ * on the launcher process all ranks were forked from.
+ */
+static std::string
+default_segment_name()
+{
+  static const char* job_vars[] = {
+    "SUMI_SHM_JOBID", "SLURM_JOB_ID", "PBS_JOBID", "LSB_JOBID", "JOB_ID", 0
+  };
+  std::string token;
+  for (int i=0; job_vars[i]; ++i){
+    const char* val = getenv(job_vars[i]);
+    if (val && *val){
+      token = val;
+      if (i == 1 && getenv("SLURM_STEP_ID")){
+        token = token + "." + getenv("SLURM_STEP_ID");
+      }
+      break;
+    }
+  }
+  if (token.empty()){
+    token = sprockit::printf("p%d", (int) getppid());
+  }
+  //shm names cannot contain further slashes
+  for (size_t i=0; i < token.size(); ++i){
+    if (token[i] == '/') token[i] = '_';
+  }
+  return sprockit::printf("/sumi_shm_%d_%s", (int) getuid(), token.c_str());
+}
+
+shm_transport::shm_transport() :
+ segment_(0),
+ segment_size_(0),
+ header_(0),
+ ranks_(0),
+ queues_(0),
+ slots_(0),
+ queue_depth_(64),
+ poll_burst_size_(16),
+ attach_timeout_(30)
+{
+}
+
+shm_transport::~shm_transport()
+{
+}
+
+void
+shm_transport::init_factory_params(sprockit::sim_parameters* params)
+{
+  active_msg_transport::init_factory_params(params);
+  //the launcher is expected to export these if not given as params
+  rank_ = params->get_optional_int_param("shm_rank", env_int("SUMI_SHM_RANK", -1));
+  nproc_ = params->get_optional_int_param("shm_nproc", env_int("SUMI_SHM_NPROC", -1));
+  const char* name = getenv("SUMI_SHM_NAME");
+  segment_name_ = params->get_optional_param("shm_name",
+                    name ? std::string(name) : default_segment_name());
+  queue_depth_ = params->get_optional_int_param("shm_queue_depth", 64);
+  attach_timeout_ = params->get_optional_time_param("shm_attach_timeout", 30);
+
+  if (rank_ < 0 || nproc_ <= 0 || rank_ >= nproc_){
+    spkt_throw_printf(sprockit::value_error,
+      "shm_transport: invalid rank %d of %d - set shm_rank/shm_nproc "
+      "or SUMI_SHM_RANK/SUMI_SHM_NPROC",
+      rank_, nproc_);
+  }
+  if (queue_depth_ < 1){
+    spkt_throw_printf(sprockit::value_error,
+      "shm_transport: shm_queue_depth must be positive, got %d",
+      queue_depth_);
+  }
+  if (segment_name_.empty() || segment_name_[0] != '/'){
+    segment_name_ = "/" + segment_name_;
+  }
+}
+
+char*
+shm_transport::slot(int src, int dst, uint64_t idx) const
+{
+  size_t slot_stride = round_up(sizeof(int) + smsg_buffer_size_);
+  size_t queue_stride = slot_stride * queue_depth_;
+  return slots_ + (src*nproc_ + dst) * queue_stride
+      + (idx % queue_depth_) * slot_stride;
+}
+
+void
+shm_transport::attach_segment()
+{
+  size_t header_size = round_up(sizeof(shm_segment_header));
+  size_t ranks_size = round_up(nproc_ * sizeof(shm_rank_info));
+  size_t queues_size = nproc_ * nproc_ * sizeof(shm_queue);
+  size_t slots_size = nproc_ * nproc_ * queue_depth_
+      * round_up(sizeof(int) + smsg_buffer_size_);
+  segment_size_ = header_size + ranks_size + queues_size + slots_size;
+
+  int fd;
+  if (rank_ == 0){
+    //clear out anything left behind by a job that died
+    shm_unlink(segment_name_.c_str());
+    fd = shm_open(segment_name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0 || ftruncate(fd, segment_size_) != 0){
+      spkt_throw_printf(sprockit::value_error,
+        "shm_transport: could not create segment %s of size %lu: %s",
+        segment_name_.c_str(), segment_size_, strerror(errno));
+    }
+  } else {
+    //rank 0 may not have created the segment yet
+    double stop = wall_time() + attach_timeout_;
+    struct stat st;
+    st.st_size = 0;
+    fd = shm_open(segment_name_.c_str(), O_RDWR, 0600);
+    while (fd < 0 || fstat(fd, &st) != 0 || size_t(st.st_size) < segment_size_){
+      if (wall_time() > stop){
+        spkt_throw_printf(sprockit::value_error,
+          "shm_transport: rank %d timed out attaching to segment %s",
+          rank_, segment_name_.c_str());
+      }
+      usleep(1000);
+      if (fd < 0) fd = shm_open(segment_name_.c_str(), O_RDWR, 0600);
+    }
+  }
+
+  void* seg = mmap(0, segment_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (seg == MAP_FAILED){
+    spkt_throw_printf(sprockit::value_error,
+      "shm_transport: could not map segment %s: %s",
+      segment_name_.c_str(), strerror(errno));
+  }
+
+  segment_ = (char*) seg;
+  header_ = (shm_segment_header*) segment_;
+  ranks_ = (shm_rank_info*) (segment_ + header_size);
+  queues_ = (shm_queue*) (segment_ + header_size + ranks_size);
+  slots_ = segment_ + header_size + ranks_size + queues_size;
+
+  if (rank_ == 0){
+    header_->nproc = nproc_;
+    header_->queue_depth = queue_depth_;
+    header_->slot_size = smsg_buffer_size_;
+  }
+
+#ifdef PR_SET_PTRACER
+  //process_vm_readv/writev need ptrace access to the peer, which Yama
+  //(ptrace_scope=1) only grants to ancestors unless the peer opts in.
+  //Without Yama this fails harmlessly, with ptrace_scope >= 2 nothing helps
+  prctl(PR_SET_PTRACER, PR_SET_PTRACER_ANY, 0, 0, 0);
+#endif
+  ranks_[rank_].pid = getpid();
+  __atomic_store_n(&ranks_[rank_].status, (int) i_am_alive, __ATOMIC_RELEASE);
+  segment_barrier(&header_->num_attached, false);
+
+  if (header_->nproc != nproc_
+    || header_->queue_depth != queue_depth_
+    || header_->slot_size != smsg_buffer_size_){
+    spkt_throw_printf(sprockit::value_error,
+      "shm_transport: rank %d disagrees with rank 0 on segment layout - "
+      "nproc %d/%d, queue depth %d/%d, slot size %d/%d",
+      rank_, nproc_, header_->nproc, queue_depth_, header_->queue_depth,
+      smsg_buffer_size_, header_->slot_size);
+  }
+}
+
+void
+shm_transport::segment_barrier(volatile int* counter, bool progress)
+{
+  __atomic_fetch_add(counter, 1, __ATOMIC_ACQ_REL);
+  while (__atomic_load_n(counter, __ATOMIC_ACQUIRE) < nproc_){
+    if (progress){
+      //peers may be stuck waiting on space in our queues
+      for (int src=0; src < nproc_; ++src){
+        poll_queue(src);
+      }
+      retry_overflow();
+    }
+    sched_yield();
+  }
+}
+
+void
+shm_transport::init()
+{
+  attach_segment();
+  active_msg_transport::init();
+  shm_debug_out("attached to segment %s of size %lu",
+    segment_name_.c_str(), segment_size_);
+}
+
+void
+shm_transport::finalize()
+{
+  transport::finalize();
+  while (!overflow_.empty()){
+    block_inner_loop();
+  }
+  segment_barrier(&header_->num_finalized, true);
+  munmap(segment_, segment_size_);
+  if (rank_ == 0){
+    shm_unlink(segment_name_.c_str());
+  }
+  segment_ = 0;
+}
+
+char*
+shm_transport::free_slot(int dst)
+{
+  shm_queue* q = queue(rank_, dst);
+  uint64_t head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+  if (q->tail - head >= uint64_t(queue_depth_)){
+    return 0;
+  }
+  return slot(rank_, dst, q->tail);
+}
+
+void
+shm_transport::commit_slot(int dst)
+{
+  shm_queue* q = queue(rank_, dst);
+  __atomic_store_n(&q->tail, q->tail + 1, __ATOMIC_RELEASE);
+}
+
+void
+shm_transport::push(int dst, const message::ptr& msg)
+{
+  lock();
+  char* buf = 0;
+  //never jump ahead of messages already waiting for space
+  if (overflow_.find(dst) == overflow_.end()){
+    buf = free_slot(dst);
+  }
+
+  if (buf){
+    //serialize straight into the slot - no intermediate buffer
+    *((int*)buf) = wire_header::pack(msg, buf + sizeof(int), smsg_buffer_size_);
+    commit_slot(dst);
+  } else {
+    //pack now, the caller is free to modify the message once we return
+    std::list<std::vector<char> >& msgs = overflow_[dst];
+    msgs.push_back(std::vector<char>(wire_header::packed_size(msg)));
+    wire_header::pack(msg, &msgs.back()[0], msgs.back().size());
+  }
+  unlock();
+
+  shm_debug_out("pushed %s to %d%s",
+    msg->to_string().c_str(), dst, buf ? "" : " overflow");
+}
+
+void
+shm_transport::retry_overflow()
+{
+  lock();
+  std::map<int, std::list<std::vector<char> > >::iterator it = overflow_.begin();
+  while (it != overflow_.end()){
+    std::list<std::vector<char> >& msgs = it->second;
+    char* buf;
+    while (!msgs.empty() && (buf = free_slot(it->first))){
+      std::vector<char>& packed = msgs.front();
+      *((int*)buf) = packed.size();
+      ::memcpy(buf + sizeof(int), &packed[0], packed.size());
+      commit_slot(it->first);
+      msgs.pop_front();
+    }
+    if (msgs.empty()){
+      overflow_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+  unlock();
+}
+
+int
+shm_transport::poll_queue(int src)
+{
+  shm_queue* q = queue(src, rank_);
+  int num_polled = 0;
+  while (num_polled < poll_burst_size_){
+    lock();
+    uint64_t head = q->head;
+    if (head == __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE)){
+      unlock();
+      break;
+    }
+    //unpack before giving the slot back to the sender
+    message::ptr msg = deserialize(slot(src, rank_, head) + sizeof(int));
+    __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+    unlock();
+
+    ++num_polled;
+    shm_debug_out("received %s from %d", msg->to_string().c_str(), src);
+    CHECK_IF_I_AM_DEAD(continue);
+    handle(msg);
+  }
+  return num_polled;
+}
+
+void
+shm_transport::block_inner_loop()
+{
+  int num_polled = 0;
+  for (int src=0; src < nproc_; ++src){
+    num_polled += poll_queue(src);
+  }
+  retry_overflow();
+
+  while (!ping_responses_.empty()){
+    message::ptr msg = ping_responses_.front();
+    ping_responses_.pop_front();
+    handle(msg);
+    ++num_polled;
+  }
+
+  maybe_do_heartbeat();
+  renew_pings();
+
+  if (num_polled == 0){
+    //be nice if the node is oversubscribed
+    sched_yield();
+  }
+}
+
+void
+shm_transport::do_smsg_send(int dst, const message::ptr &msg)
+{
+  CHECK_IF_I_AM_DEAD(return);
+  shm_debug_out("smsg send %s to %d", msg->to_string().c_str(), dst);
+  push(dst, msg);
+}
+
+void
+shm_transport::do_send_terminate(int dst)
+{
+  shm_debug_out("send terminate request to %d", dst);
+  message::ptr msg = new message;
+  msg->set_class_type(message::terminate);
+  push(dst, msg);
+}
+
+void
+shm_transport::do_send_ping_request(int dst)
+{
+  //no round trip needed - liveness is published in the segment
+  //and the process itself can be checked directly
+  int status = __atomic_load_n(&ranks_[dst].status, __ATOMIC_ACQUIRE);
+  bool alive = status == i_am_alive
+    && (kill(ranks_[dst].pid, 0) == 0 || errno == EPERM);
+
+  shm_debug_out("ping %d: %s", dst, alive ? "alive" : "dead");
+
+  message::ptr ping_msg = new message;
+  ping_msg->set_sender(dst);
+  ping_msg->set_recver(rank_);
+  ping_msg->set_class_type(message::ping);
+  if (alive){
+    ping_msg->set_payload_type(message::rdma_get);
+  } else {
+    ping_msg->set_payload_type(message::rdma_get_nack);
+  }
+  //pings can be issued from inside handle, so deliver from the progress loop
+  lock();
+  ping_responses_.push_back(ping_msg);
+  unlock();
+}
+
+static const char*
+ptrace_hint(int err)
+{
+  return err == EPERM
+    ? " - check /proc/sys/kernel/yama/ptrace_scope allows attaching to peers"
+    : "";
+}
+
+void
+shm_transport::copy_from(int src, void* local, void* remote, long bytes)
+{
+  if (src == rank_){
+    ::memcpy(local, remote, bytes);
+    return;
+  }
+
+  char* local_ptr = (char*) local;
+  char* remote_ptr = (char*) remote;
+  while (bytes > 0){
+    struct iovec local_iov = { local_ptr, size_t(bytes) };
+    struct iovec remote_iov = { remote_ptr, size_t(bytes) };
+    ssize_t done = process_vm_readv(ranks_[src].pid, &local_iov, 1, &remote_iov, 1, 0);
+    if (done <= 0){
+      spkt_throw_printf(sprockit::value_error,
+        "shm_transport: rank %d failed reading %ld bytes from rank %d: %s%s",
+        rank_, bytes, src, strerror(errno), ptrace_hint(errno));
+    }
+    local_ptr += done;
+    remote_ptr += done;
+    bytes -= done;
+  }
+}
+
+void
+shm_transport::copy_to(int dst, void* remote, void* local, long bytes)
+{
+  if (dst == rank_){
+    ::memcpy(remote, local, bytes);
+    return;
+  }
+
+  char* local_ptr = (char*) local;
+  char* remote_ptr = (char*) remote;
+  while (bytes > 0){
+    struct iovec local_iov = { local_ptr, size_t(bytes) };
+    struct iovec remote_iov = { remote_ptr, size_t(bytes) };
+    ssize_t done = process_vm_writev(ranks_[dst].pid, &local_iov, 1, &remote_iov, 1, 0);
+    if (done <= 0){
+      spkt_throw_printf(sprockit::value_error,
+        "shm_transport: rank %d failed writing %ld bytes to rank %d: %s%s",
+        rank_, bytes, dst, strerror(errno), ptrace_hint(errno));
+    }
+    local_ptr += done;
+    remote_ptr += done;
+    bytes -= done;
+  }
+}
+
+void
+shm_transport::do_rdma_get(int src, const message::ptr &msg)
+{
+  CHECK_IF_I_AM_DEAD(return);
+  long bytes = msg->byte_length();
+  void* recver_buf = msg->local_buffer().ptr;
+  void* sender_buf = msg->remote_buffer().ptr;
+
+  shm_debug_out("rdma get %ld bytes from %d: %p -> %p",
+    bytes, src, sender_buf, recver_buf);
+
+  //single copy straight out of the peer's address space
+  copy_from(src, recver_buf, sender_buf, bytes);
+
+  if (msg->needs_send_ack()){
+    //push packs the message immediately, so it can be reused below
+    msg->set_payload_type(message::rdma_get_ack);
+    push(src, msg);
+  }
+
+  if (msg->needs_recv_ack()){
+    msg->set_payload_type(message::rdma_get);
+    handle(msg);
+  }
+}
+
+void
+shm_transport::do_rdma_put(int dst, const message::ptr &msg)
+{
+  CHECK_IF_I_AM_DEAD(return);
+  long bytes = msg->byte_length();
+  void* sender_buf = msg->local_buffer().ptr;
+  void* recver_buf = msg->remote_buffer().ptr;
+
+  shm_debug_out("rdma put %ld bytes to %d: %p -> %p",
+    bytes, dst, sender_buf, recver_buf);
+
+  copy_to(dst, recver_buf, sender_buf, bytes);
+
+  if (msg->needs_recv_ack()){
+    //the data is already in place, the message only notifies
+    push(dst, msg);
+  }
+
+  if (msg->needs_send_ack()){
+    message::ptr ack = msg->clone_msg();
+    ack->set_payload_type(message::rdma_put_ack);
+    handle(ack);
+  }
+}
+
+void
+shm_transport::do_nvram_get(int /*src*/, const message::ptr& /*msg*/)
+{
+  spkt_throw(sprockit::unimplemented_error,
+    "shm_transport: cannot do nvram get");
+}
+
+void
+shm_transport::go_die()
+{
+  __atomic_store_n(&ranks_[rank_].status, (int) i_am_dead, __ATOMIC_RELEASE);
+}
+
+void
+shm_transport::go_revive()
+{
+  __atomic_store_n(&ranks_[rank_].status, (int) i_am_alive, __ATOMIC_RELEASE);
+}
+
+}
@@ -0,0 +1,158 @@
+#ifndef shm_shm_transport_h
+#define shm_shm_transport_h
+
+#include <sumi/active_msg_transport.h>
+#include <sys/types.h>
+#include <stdint.h>
+#include <list>
+#include <map>
+#include <vector>
+
+namespace sumi {
+
+/**
+ * @class shm_queue
+ * Single-producer, single-consumer ring of fixed-size message slots
+ * living inside the shared segment. There is one queue per (src,dst) pair,
+ * so no locks are needed - just acquire/release ordering on the indices.
+ */
+struct shm_queue
+{
+  /** Next slot to be consumed, only written by the consumer */
+  volatile uint64_t head;
+  char pad0[64 - sizeof(uint64_t)];
+  /** Next slot to be produced, only written by the producer */
+  volatile uint64_t tail;
+  char pad1[64 - sizeof(uint64_t)];
+};
+
+/**
+ * @class shm_segment_header
+ * Lives at the front of the shared segment
+ */
+struct shm_segment_header
+{
+  volatile int num_attached;
+  volatile int num_finalized;
+  int nproc;
+  int queue_depth;
+  int slot_size;
+};
+
+/**
+ * @class shm_rank_info
+ * Per-rank information published in the shared segment
+ */
+struct shm_rank_info
+{
+  pid_t pid;
+  volatile int status;
+};
+
+class shm_transport :
+  public active_msg_transport
+{
+ public:
+  shm_transport();
+
+  virtual ~shm_transport();
+
+  void init();
+
+  void finalize();
+
+  virtual void
+  init_factory_params(sprockit::sim_parameters* params);
+
+ protected:
+  void block_inner_loop();
+
+  void do_send_terminate(int dst);
+
+  void do_send_ping_request(int dst);
+
+  void do_smsg_send(int dst, const message::ptr &msg);
+
+  void do_rdma_get(int src, const message::ptr &msg);
+
+  void do_rdma_put(int dst, const message::ptr &msg);
+
+  void do_nvram_get(int src, const message::ptr &msg);
+
+  void go_die();
+
+  void go_revive();
+
+ private:
+  void attach_segment();
+
+  /**
+   * Wait until every rank has bumped the counter in the segment header
+   * @param progress  Whether to keep draining queues while waiting
+   */
+  void segment_barrier(volatile int* counter, bool progress);
+
+  shm_queue*
+  queue(int src, int dst) const {
+    return queues_ + src*nproc_ + dst;
+  }
+
+  char*
+  slot(int src, int dst, uint64_t idx) const;
+
+  /**
+   * @return The next free slot in the queue to dst, null if full
+   */
+  char*
+  free_slot(int dst);
+
+  void
+  commit_slot(int dst);
+
+  void
+  push(int dst, const message::ptr& msg);
+
+  void
+  retry_overflow();
+
+  int
+  poll_queue(int src);
+
+  void
+  copy_from(int src, void* local, void* remote, long bytes);
+
+  void
+  copy_to(int dst, void* remote, void* local, long bytes);
+
+ private:
+  std::string segment_name_;
+
+  char* segment_;
+
+  size_t segment_size_;
+
+  shm_segment_header* header_;
+
+  shm_rank_info* ranks_;
+
+  shm_queue* queues_;
+
+  char* slots_;
+
+  int queue_depth_;
+
+  int poll_burst_size_;
+
+  double attach_timeout_;
+
+  /** Packed messages that did not fit in the destination queue, in order */
+  std::map<int, std::list<std::vector<char> > > overflow_;
+
+  /** Ping responses are delivered from the progress loop, not inside the ping */
+  std::list<message::ptr> ping_responses_;
+
+};
+
+}
+
+#endif
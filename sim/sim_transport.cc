@@ -0,0 +1,644 @@
+#include <sim/sim_transport.h>
+#include <sumi/ping.h>
+#include <sumi/wire_header.h>
+#include <sprockit/serializer.h>
+#include <sprockit/sim_parameters.h>
+#include <sprockit/keyword_registration.h>
+#include <algorithm>
+#include <string.h>
+#include <stdlib.h>
+
+#define sim_debug_out(...) \
+  debug_printf(sprockit::dbg::sim_transport, "Rank %d: %s at t=%8.4e", rank(), sprockit::printf(__VA_ARGS__).c_str(), wall_time())
+
+DeclareDebugSlot(sim_transport);
+RegisterDebugSlot(sim_transport);
+
+RegisterKeywords(
+  "sim_nproc",
+  "sim_latency",
+  "sim_overhead",
+  "sim_gap",
+  "sim_bandwidth",
+  "sim_hop_latency",
+  "sim_topology",
+  "sim_topology_geometry",
+  "sim_elide_payloads",
+  "sim_print_times"
+);
+
+namespace sumi {
+
+SpktRegister("sim", transport, sim_transport,
+            "Create a SUMI transport that simulates all ranks in one thread with a LogGP network model");
+
+static void
+pack(const message::ptr& msg, std::vector<char>& buf)
+{
+  buf.resize(wire_header::packed_size(msg));
+  wire_header::pack(msg, &buf[0], buf.size());
+}
+
+/**
+ * @class sim_deliver_event
+ * Hand a message to its receiver. The message is packed when it is sent
+ * so the sender is free to modify its copy while it is in flight.
+ */
+class sim_deliver_event :
+  public sim_event
+{
+ public:
+  sim_deliver_event(sim_transport* dst, const message::ptr& msg) :
+    dst_(dst)
+  {
+    pack(msg, buf_);
+  }
+
+  void
+  execute(){
+    if (dst_->is_dead())
+      return;
+    dst_->handle(wire_header::unpack(&buf_[0], buf_.size(), dst_));
+  }
+
+ private:
+  sim_transport* dst_;
+  std::vector<char> buf_;
+};
+
+/**
+ * @class sim_rdma_get_event
+ * An RDMA get request has reached the rank that owns the data
+ */
+class sim_rdma_get_event :
+  public sim_event
+{
+ public:
+  sim_rdma_get_event(sim_transport* src, int dst, const message::ptr& msg) :
+    src_(src), dst_(dst), msg_(msg)
+  {
+  }
+
+  void
+  execute(){
+    src_->rdma_get_arrived(dst_, msg_);
+  }
+
+ private:
+  sim_transport* src_;
+  int dst_;
+  message::ptr msg_;
+};
+
+/**
+ * @class sim_ping_event
+ * A ping request has reached its target
+ */
+class sim_ping_event :
+  public sim_event
+{
+ public:
+  sim_ping_event(sim_transport* dst, int src) :
+    dst_(dst), src_(src)
+  {
+  }
+
+  void
+  execute(){
+    dst_->ping_arrived(src_);
+  }
+
+ private:
+  sim_transport* dst_;
+  int src_;
+};
+
+/**
+ * @class sim_ping_timeout_event
+ * Pingers are never deleted, so the raw pointer is safe to hold
+ */
+class sim_ping_timeout_event :
+  public sim_event
+{
+ public:
+  sim_ping_timeout_event(pinger* pnger) :
+    pnger_(pnger)
+  {
+  }
+
+  void
+  execute(){
+    pnger_->execute();
+  }
+
+ private:
+  pinger* pnger_;
+};
+
+class sim_heartbeat_event :
+  public sim_event
+{
+ public:
+  sim_heartbeat_event(sim_transport* t) :
+    t_(t)
+  {
+  }
+
+  void
+  execute(){
+    t_->heartbeat_due();
+  }
+
+ private:
+  sim_transport* t_;
+};
+
+sim_engine::sim_engine() :
+  nproc_(0),
+  num_attached_(0),
+  num_finalized_(0),
+  now_(0),
+  next_seq_(0),
+  configured_(false),
+  print_times_(false),
+  latency_(1e-6),
+  overhead_(1e-7),
+  gap_(0),
+  inv_bandwidth_(1e-10),
+  hop_latency_(1e-7)
+{
+}
+
+sim_engine*
+sim_engine::instance()
+{
+  static sim_engine engine;
+  return &engine;
+}
+
+void
+sim_engine::configure(sprockit::sim_parameters* params)
+{
+  if (configured_)
+    return;
+
+  latency_ = params->get_optional_time_param("sim_latency", 1e-6);
+  overhead_ = params->get_optional_time_param("sim_overhead", 1e-7);
+  gap_ = params->get_optional_time_param("sim_gap", 0);
+  hop_latency_ = params->get_optional_time_param("sim_hop_latency", 1e-7);
+  //bandwidth in bytes/s
+  double bw = params->get_optional_double_param("sim_bandwidth", 10e9);
+  if (bw <= 0){
+    spkt_throw_printf(sprockit::value_error,
+      "sim_engine: invalid bandwidth %8.4e", bw);
+  }
+  inv_bandwidth_ = 1.0 / bw;
+  print_times_ = params->get_optional_bool_param("sim_print_times", false);
+
+  std::string topology = params->get_optional_param("sim_topology", "flat");
+  geometry_.clear();
+  if (topology == "torus"){
+    params->get_vector_param("sim_topology_geometry", geometry_);
+  } else if (topology != "flat"){
+    spkt_throw_printf(sprockit::value_error,
+      "sim_engine: unknown topology %s - must be flat or torus",
+      topology.c_str());
+  }
+  configured_ = true;
+}
+
+void
+sim_engine::schedule(double t, sim_event* ev)
+{
+  event_entry entry;
+  entry.time = t < now_ ? now_ : t;
+  entry.seq = next_seq_++;
+  entry.ev = ev;
+  events_.push(entry);
+}
+
+bool
+sim_engine::run_one(double stop)
+{
+  if (events_.empty())
+    return false;
+
+  event_entry entry = events_.top();
+  if (stop >= 0 && entry.time > stop)
+    return false;
+
+  events_.pop();
+  now_ = entry.time;
+  entry.ev->execute();
+  delete entry.ev;
+  return true;
+}
+
+void
+sim_engine::advance(double t)
+{
+  if (t > now_)
+    now_ = t;
+}
+
+int
+sim_engine::num_hops(int src, int dst) const
+{
+  if (geometry_.empty())
+    return 1;
+
+  int hops = 0;
+  int ndims = geometry_.size();
+  for (int i=0; i < ndims; ++i){
+    int size = geometry_[i];
+    int dist = abs(src % size - dst % size);
+    hops += std::min(dist, size - dist);
+    src /= size;
+    dst /= size;
+  }
+  return hops;
+}
+
+double
+sim_engine::transfer(int src, int dst, long bytes, double* inject_done)
+{
+  double xfer = bytes * inv_bandwidth_;
+
+  double start = std::max(now_, tx_free_[src]);
+  double injected = start + overhead_ + xfer;
+  tx_free_[src] = std::max(injected, start + gap_);
+  if (inject_done) *inject_done = injected;
+
+  if (src == dst){
+    return injected + overhead_;
+  }
+
+  double tail = injected + latency_ + num_hops(src, dst) * hop_latency_;
+  double ejected = std::max(tail, rx_free_[dst] + xfer);
+  rx_free_[dst] = ejected;
+  return ejected + overhead_;
+}
+
+int
+sim_engine::add_rank(sim_transport* t, int nproc)
+{
+  if (num_attached_ == 0){
+    nproc_ = nproc;
+    ranks_.assign(nproc, 0);
+    tx_free_.assign(nproc, 0.);
+    rx_free_.assign(nproc, 0.);
+    now_ = 0;
+  }
+  if (nproc != nproc_ || num_attached_ == nproc_){
+    spkt_throw_printf(sprockit::value_error,
+      "sim_engine: cannot join job of %d ranks with nproc=%d",
+      nproc_, nproc);
+  }
+
+  if (!geometry_.empty()){
+    int size = 1;
+    int ndims = geometry_.size();
+    for (int i=0; i < ndims; ++i){
+      size *= geometry_[i];
+    }
+    if (size < nproc_){
+      spkt_throw_printf(sprockit::value_error,
+        "sim_engine: torus of %d nodes cannot hold %d ranks",
+        size, nproc_);
+    }
+  }
+
+  int r = num_attached_++;
+  ranks_[r] = t;
+  return r;
+}
+
+void
+sim_engine::rank_finalized()
+{
+  ++num_finalized_;
+  if (num_finalized_ == nproc_){
+    if (print_times_){
+      print_collective_times(std::cout);
+    }
+    clear();
+  }
+}
+
+void
+sim_engine::clear()
+{
+  //pending pings and heartbeats belong to the finished job
+  while (!events_.empty()){
+    delete events_.top().ev;
+    events_.pop();
+  }
+  timings_.clear();
+  ranks_.clear();
+  num_attached_ = 0;
+  num_finalized_ = 0;
+  configured_ = false;
+}
+
+void
+sim_engine::collective_started(collective::type_t ty, int tag)
+{
+  collective_id id(ty, tag);
+  std::map<collective_id, collective_timing>::iterator it = timings_.find(id);
+  if (it == timings_.end()){
+    collective_timing& timing = timings_[id];
+    timing.start = now_;
+    timing.stop = -1;
+    timing.num_done = 0;
+  } else if (now_ < it->second.start){
+    it->second.start = now_;
+  }
+}
+
+void
+sim_engine::collective_finished(collective::type_t ty, int tag)
+{
+  collective_timing& timing = timings_[collective_id(ty, tag)];
+  timing.stop = std::max(timing.stop, now_);
+  ++timing.num_done;
+}
+
+double
+sim_engine::collective_time(collective::type_t ty, int tag) const
+{
+  std::map<collective_id, collective_timing>::const_iterator it
+    = timings_.find(collective_id(ty, tag));
+  if (it == timings_.end() || it->second.stop < 0)
+    return -1;
+  return it->second.stop - it->second.start;
+}
+
+double
+sim_engine::collective_finish_time(collective::type_t ty, int tag) const
+{
+  std::map<collective_id, collective_timing>::const_iterator it
+    = timings_.find(collective_id(ty, tag));
+  if (it == timings_.end())
+    return -1;
+  return it->second.stop;
+}
+
+void
+sim_engine::print_collective_times(std::ostream& os) const
+{
+  std::map<collective_id, collective_timing>::const_iterator it, end = timings_.end();
+  for (it=timings_.begin(); it != end; ++it){
+    const collective_timing& timing = it->second;
+    os << sprockit::printf("%s tag=%d ranks=%d start=%12.8e time=%12.8e\n",
+            collective::tostr((collective::type_t)it->first.first), it->first.second,
+            timing.num_done, timing.start, timing.stop - timing.start);
+  }
+}
+
+sim_transport::sim_transport() :
+  engine_(sim_engine::instance()),
+  elide_payloads_(false)
+{
+}
+
+void
+sim_transport::init_factory_params(sprockit::sim_parameters* params)
+{
+  transport::init_factory_params(params);
+  nproc_ = params->get_int_param("sim_nproc");
+  if (nproc_ <= 0){
+    spkt_throw_printf(sprockit::value_error,
+      "sim_transport: invalid nproc %d", nproc_);
+  }
+  elide_payloads_ = params->get_optional_bool_param("sim_elide_payloads", false);
+  engine_->configure(params);
+}
+
+void
+sim_transport::init()
+{
+  rank_ = engine_->add_rank(this, nproc_);
+  transport::init();
+  sim_debug_out("joined simulation of %d ranks", nproc_);
+}
+
+void
+sim_transport::finalize()
+{
+  transport::finalize();
+  engine_->rank_finalized();
+}
+
+double
+sim_transport::wall_time() const
+{
+  return engine_->now();
+}
+
+void
+sim_transport::schedule_ping_timeout(pinger* pnger, double to)
+{
+  engine_->schedule(engine_->now() + to, new sim_ping_timeout_event(pnger));
+}
+
+void
+sim_transport::schedule_next_heartbeat()
+{
+  engine_->schedule(engine_->now() + heartbeat_interval_, new sim_heartbeat_event(this));
+}
+
+void
+sim_transport::heartbeat_due()
+{
+  if (heartbeat_active_ && !heartbeat_running_)
+    next_heartbeat();
+}
+
+collective_done_message::ptr
+sim_transport::collective_block(collective::type_t ty, int tag)
+{
+  spkt_throw(sprockit::unimplemented_error,
+    "sim_transport::collective_block");
+}
+
+message::ptr
+sim_transport::block_until_message()
+{
+  while (completion_queue_.empty()){
+    flush_expired_smsgs();
+    if (!engine_->run_one()){
+      spkt_throw_printf(sprockit::illformed_error,
+        "sim_transport: rank %d is waiting, but no events remain - deadlock at t=%8.4e",
+        rank_, engine_->now());
+    }
+  }
+  bool empty;
+  return completion_queue_.pop_front_and_return(empty);
+}
+
+message::ptr
+sim_transport::block_until_message(double timeout)
+{
+  double stop = engine_->now() + timeout;
+  while (completion_queue_.empty()){
+    flush_expired_smsgs();
+    if (!engine_->run_one(stop)){
+      //nothing else happens before the timeout - jump straight to it
+      engine_->advance(stop);
+      break;
+    }
+  }
+  bool empty;
+  return completion_queue_.pop_front_and_return(empty);
+}
+
+void
+sim_transport::deliver(int dst, const message::ptr& msg, double time)
+{
+  engine_->schedule(time, new sim_deliver_event(engine_->rank(dst), msg));
+}
+
+void
+sim_transport::do_smsg_send(int dst, const message::ptr &msg)
+{
+  CHECK_IF_I_AM_DEAD(return);
+  sim_deliver_event* ev = new sim_deliver_event(engine_->rank(dst), msg);
+  //eager messages carry the packed message regardless of elision
+  long bytes = msg->byte_length() + message::header_size;
+  double arrival = engine_->transfer(rank_, dst, bytes);
+  sim_debug_out("send %s to %d arriving at t=%8.4e",
+    msg->to_string().c_str(), dst, arrival);
+  engine_->schedule(arrival, ev);
+}
+
+void
+sim_transport::do_send_terminate(int dst)
+{
+  message::ptr msg = new message;
+  msg->set_class_type(message::terminate);
+  deliver(dst, msg, engine_->transfer(rank_, dst, message::header_size));
+}
+
+void
+sim_transport::do_send_ping_request(int dst)
+{
+  double arrival = engine_->transfer(rank_, dst, message::header_size);
+  engine_->schedule(arrival, new sim_ping_event(engine_->rank(dst), rank_));
+}
+
+void
+sim_transport::ping_arrived(int src)
+{
+  //the network reports a dead endpoint, so a nack comes back either way
+  message::ptr ping_msg = new message;
+  ping_msg->set_sender(rank_);
+  ping_msg->set_recver(src);
+  ping_msg->set_class_type(message::ping);
+  if (is_dead_){
+    ping_msg->set_payload_type(message::rdma_get_nack);
+  } else {
+    ping_msg->set_payload_type(message::rdma_get);
+  }
+  deliver(src, ping_msg, engine_->transfer(rank_, src, message::header_size));
+}
+
+void
+sim_transport::do_rdma_get(int src, const message::ptr &msg)
+{
+  CHECK_IF_I_AM_DEAD(return);
+  double arrival = engine_->transfer(rank_, src, message::header_size);
+  sim_debug_out("rdma get %ld bytes from %d, request arriving at t=%8.4e",
+    msg->byte_length(), src, arrival);
+  //the requester does not touch the message again until the data returns
+  engine_->schedule(arrival, new sim_rdma_get_event(engine_->rank(src), rank_, msg));
+}
+
+void
+sim_transport::rdma_get_arrived(int dst, const message::ptr &msg)
+{
+  if (is_dead_)
+    return;
+
+  long bytes = msg->byte_length();
+  if (!elide_payloads_){
+    ::memcpy(msg->local_buffer().ptr, msg->remote_buffer().ptr, bytes);
+  }
+
+  double inject_done;
+  double arrival = engine_->transfer(rank_, dst, bytes, &inject_done);
+
+  sim_debug_out("rdma get %ld bytes to %d arriving at t=%8.4e",
+    bytes, dst, arrival);
+
+  if (msg->needs_send_ack()){
+    //deliver packs the message, so it can be reused below
+    msg->set_payload_type(message::rdma_get_ack);
+    deliver(rank_, msg, inject_done);
+  }
+
+  if (msg->needs_recv_ack()){
+    msg->set_payload_type(message::rdma_get);
+    deliver(dst, msg, arrival);
+  }
+}
+
+void
+sim_transport::do_rdma_put(int dst, const message::ptr &msg)
+{
+  CHECK_IF_I_AM_DEAD(return);
+  long bytes = msg->byte_length();
+  //the receiver cannot look at the buffer before the recv ack,
+  //so copying now rather than at arrival is not observable
+  if (!elide_payloads_){
+    ::memcpy(msg->remote_buffer().ptr, msg->local_buffer().ptr, bytes);
+  }
+
+  double inject_done;
+  double arrival = engine_->transfer(rank_, dst, bytes, &inject_done);
+
+  sim_debug_out("rdma put %ld bytes to %d arriving at t=%8.4e",
+    bytes, dst, arrival);
+
+  if (msg->needs_recv_ack()){
+    deliver(dst, msg, arrival);
+  }
+
+  if (msg->needs_send_ack()){
+    message::ptr ack = msg->clone_msg();
+    ack->set_payload_type(message::rdma_put_ack);
+    deliver(rank_, ack, inject_done);
+  }
+}
+
+void
+sim_transport::do_nvram_get(int src, const message::ptr &msg)
+{
+  spkt_throw(sprockit::unimplemented_error,
+    "sim_transport: cannot do nvram get");
+}
+
+void
+sim_transport::go_die()
+{
+  sim_debug_out("dying");
+}
+
+void
+sim_transport::go_revive()
+{
+  sim_debug_out("reviving");
+}
+
+void
+sim_transport::collective_started(collective::type_t ty, int tag)
+{
+  engine_->collective_started(ty, tag);
+}
+
+void
+sim_transport::collective_finished(collective::type_t ty, int tag)
+{
+  engine_->collective_finished(ty, tag);
+}
+
+}
@@ -0,0 +1,277 @@
+#ifndef sim_sim_transport_h
+#define sim_sim_transport_h
+
+#include <sumi/transport.h>
+#include <sumi/collective.h>
+#include <iostream>
+#include <vector>
+#include <queue>
+#include <map>
+
+namespace sumi {
+
+class sim_transport;
+
+/**
+ * @class sim_event
+ * Something that happens at a fixed point in virtual time
+ */
+class sim_event
+{
+ public:
+  virtual ~sim_event(){}
+
+  virtual void
+  execute() = 0;
+};
+
+/**
+ * @class sim_engine
+ * Discrete-event scheduler shared by every simulated rank in the process.
+ * Network costs follow LogGP: a message of n bytes occupies the sender
+ * for o + n*G, crosses the network in L plus a per-hop latency, and is
+ * serialized again through the receiver's NIC before paying o on arrival.
+ * Consecutive injections from the same NIC are at least g apart.
+ */
+class sim_engine
+{
+ public:
+  static sim_engine*
+  instance();
+
+  void
+  configure(sprockit::sim_parameters* params);
+
+  double
+  now() const {
+    return now_;
+  }
+
+  void
+  schedule(double t, sim_event* ev);
+
+  /**
+   * Execute the next event, if any, no later than stop.
+   * @return Whether an event was executed
+   */
+  bool
+  run_one(double stop = -1);
+
+  /**
+   * Move virtual time forward to t when nothing happens before then
+   */
+  void
+  advance(double t);
+
+  /**
+   * Reserve the NICs for a message and compute when it is delivered.
+   * @param inject_done [out] When the sender NIC has finished injecting
+   * @return When the receiver has the full message
+   */
+  double
+  transfer(int src, int dst, long bytes, double* inject_done = 0);
+
+  int
+  num_hops(int src, int dst) const;
+
+  int
+  add_rank(sim_transport* t, int nproc);
+
+  sim_transport*
+  rank(int r) const {
+    return ranks_[r];
+  }
+
+  void
+  rank_finalized();
+
+  void
+  collective_started(collective::type_t ty, int tag);
+
+  void
+  collective_finished(collective::type_t ty, int tag);
+
+  /**
+   * @return The predicted time from the first rank starting the collective
+   *         to the last rank finishing it, -1 if it never finished
+   */
+  double
+  collective_time(collective::type_t ty, int tag) const;
+
+  /**
+   * @return When the last rank finished the collective, -1 if none has
+   */
+  double
+  collective_finish_time(collective::type_t ty, int tag) const;
+
+  void
+  print_collective_times(std::ostream& os) const;
+
+ private:
+  sim_engine();
+
+  void
+  clear();
+
+  struct event_entry {
+    double time;
+    long seq;
+    sim_event* ev;
+  };
+
+  struct event_later {
+    bool
+    operator()(const event_entry& a, const event_entry& b) const {
+      if (a.time != b.time) return a.time > b.time;
+      return a.seq > b.seq;
+    }
+  };
+
+  struct collective_timing {
+    double start;
+    double stop;
+    int num_done;
+  };
+
+  typedef std::pair<int,int> collective_id;
+
+  std::priority_queue<event_entry, std::vector<event_entry>, event_later> events_;
+
+  std::map<collective_id, collective_timing> timings_;
+
+  std::vector<sim_transport*> ranks_;
+
+  std::vector<double> tx_free_;
+
+  std::vector<double> rx_free_;
+
+  std::vector<int> geometry_;
+
+  int nproc_;
+
+  int num_attached_;
+
+  int num_finalized_;
+
+  double now_;
+
+  long next_seq_;
+
+  bool configured_;
+
+  bool print_times_;
+
+  double latency_;
+
+  double overhead_;
+
+  double gap_;
+
+  double inv_bandwidth_;
+
+  double hop_latency_;
+
+};
+
+/**
+ * @class sim_transport
+ * Every rank is a simulated endpoint driven by a sim_engine
+ * in a single thread. Blocking calls advance virtual time by
+ * executing events until this rank has something to do.
+ * Time reported by wall_time() is the predicted time, not the host's.
+ */
+class sim_transport :
+  public transport
+{
+ public:
+  sim_transport();
+
+  virtual ~sim_transport(){}
+
+  void init();
+
+  void finalize();
+
+  virtual void
+  init_factory_params(sprockit::sim_parameters* params);
+
+  double
+  wall_time() const;
+
+  void
+  schedule_ping_timeout(pinger* pnger, double to);
+
+  void
+  schedule_next_heartbeat();
+
+  void
+  cq_notify(){} //no op
+
+  void
+  delayed_transport_handle(const message::ptr& msg){
+    handle(msg);
+  }
+
+  collective_done_message::ptr
+  collective_block(collective::type_t ty, int tag);
+
+  message::ptr
+  block_until_message();
+
+  message::ptr
+  block_until_message(double timeout);
+
+  /**
+   Run the heartbeat scheduled by #schedule_next_heartbeat
+   */
+  void
+  heartbeat_due();
+
+  /**
+   Respond to a ping that has reached this rank
+   */
+  void
+  ping_arrived(int src);
+
+  /**
+   Perform the source side of an RDMA get that has reached this rank
+   */
+  void
+  rdma_get_arrived(int dst, const message::ptr& msg);
+
+  void
+  deliver(int dst, const message::ptr& msg, double time);
+
+ protected:
+  void do_send_terminate(int dst);
+
+  void do_send_ping_request(int dst);
+
+  void do_smsg_send(int dst, const message::ptr &msg);
+
+  void do_rdma_get(int src, const message::ptr &msg);
+
+  void do_rdma_put(int dst, const message::ptr &msg);
+
+  void do_nvram_get(int src, const message::ptr &msg);
+
+  void go_die();
+
+  void go_revive();
+
+  void
+  collective_started(collective::type_t ty, int tag);
+
+  void
+  collective_finished(collective::type_t ty, int tag);
+
+ private:
+  sim_engine* engine_;
+
+  bool elide_payloads_;
+
+};
+
+}
+
+#endif
@@ -1,6 +1,12 @@
 #include <sumi/active_msg_transport.h>
+#include <sumi/wire_header.h>
 #include <sys/time.h>
+#include <unistd.h>
 #include <sprockit/serializer.h>
+#include <sprockit/sim_parameters.h>
+#include <sprockit/keyword_registration.h>
+
+RegisterKeywords("smsg_buffer_size");
 
 namespace sumi {
 
@@ -15,6 +21,7 @@ message::ptr
 active_msg_transport::block_until_message()
 {
   while (completion_queue_.empty()){
+    flush_expired_smsgs();
     block_inner_loop();
   }
   bool empty;
@@ -28,6 +35,7 @@ active_msg_transport::block_until_message(double timeout)
   double start = wall_time();
   double stop = start + timeout;
   while (completion_queue_.empty() && wall_time() < stop){
+    flush_expired_smsgs();
     block_inner_loop();
   }
   bool empty;
@@ -35,6 +43,34 @@ active_msg_transport::block_until_message(double timeout)
   return ret;
 }
 
+message::ptr
+active_msg_transport::idle_poll(double timeout)
+{
+  //make one pass of progress, then give the core back until the next check
+  flush_expired_smsgs();
+  block_inner_loop();
+  bool empty;
+  message::ptr ret = completion_queue_.pop_front_and_return(empty);
+  if (empty){
+    usleep(long(timeout*1e6));
+  }
+  return ret;
+}
+
+void
+active_msg_transport::init_factory_params(sprockit::sim_parameters* params)
+{
+  transport::init_factory_params(params);
+  smsg_buffer_size_ = params->get_optional_byte_length_param("smsg_buffer_size", 512);
+  if (smsg_coalesce_){
+    //a full batch plus the batch wrapper must fit in one buffer
+    long min_size = smsg_coalesce_bytes_ + sizeof(wire_header) + message::header_size;
+    if (smsg_buffer_size_ < min_size){
+      smsg_buffer_size_ = min_size;
+    }
+  }
+}
+
 collective_done_message::ptr
 active_msg_transport::collective_block(collective::type_t ty, int tag)
 {
@@ -48,27 +84,21 @@ active_msg_transport::allocate_message_buffer(const message::ptr &msg, int& size
   lock();
   char* ser_buffer = allocate_smsg_buffer(); fflush(stdout);
   unlock();
-  sprockit::serializer ser;
-  ser.start_packing(ser_buffer, smsg_buffer_size_);
-  ser & msg;
-  size = ser.packer().size();
+  size = wire_header::pack(msg, ser_buffer, smsg_buffer_size_);
   return ser_buffer;
 }
 
 message::ptr
 active_msg_transport::deserialize(char* ser_buffer)
 {
-  sprockit::serializer ser;
-  ser.start_unpacking(ser_buffer, smsg_buffer_size_);
-  message::ptr msg;
-  ser & msg;
-  return msg;
+  return wire_header::unpack(ser_buffer, smsg_buffer_size_, this);
 }
 
 message::ptr
 active_msg_transport::free_message_buffer(void* buf)
 {
-  message::ptr msg = deserialize((char*)buf);
+  //our own outgoing message, never place its payload
+  message::ptr msg = wire_header::unpack((char*)buf, smsg_buffer_size_);
   lock();
   free_smsg_buffer(buf);
   unlock();
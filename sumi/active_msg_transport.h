@@ -40,9 +40,20 @@ class active_msg_transport :
   message::ptr
   block_until_message(double timeout);
 
+  message::ptr
+  idle_poll(double timeout);
+
   void
   init();
 
+  virtual void
+  init_factory_params(sprockit::sim_parameters* params);
+
+  long
+  max_smsg_size() const {
+    return smsg_buffer_size_;
+  }
+
   typedef enum {
    i_am_alive,
    i_am_dead
@@ -77,7 +88,7 @@ class active_msg_transport :
 
   char* smsg_buffer_;
 
-  const int smsg_buffer_size_;
+  int smsg_buffer_size_;
 
   std::list<char*> smsg_buffer_pool_;
 };
@@ -29,6 +29,10 @@ class bruck_actor :
 
   void buffer_action(void *dst_buffer, void *msg_buffer, action* ac);
 
+  bool buffer_action_is_copy(int round) const {
+    return true;
+  }
+
   void dense_partner_ping_failed(int dense_rank){
     dag_collective_actor::dense_partner_ping_failed(dense_rank);
   }
@@ -23,6 +23,12 @@ class wilke_allreduce_actor :
   void
   buffer_action(void *dst_buffer, void *msg_buffer, action* ac);
 
+  bool
+  buffer_action_is_copy(int round) const {
+    //the doubling half of the algorithm just copies
+    return num_total_rounds_ > 0 && round % num_total_rounds_ >= num_reducing_rounds_;
+  }
+
   wilke_allreduce_actor(reduce_fxn fxn);
 
  private:
@@ -30,6 +30,10 @@ class binary_tree_bcast_actor :
   void init_child(int me, int roundNproc, int nproc);
   void init_internal(int me, int windowSize, int nproc, action* recv);
   void buffer_action(void *dst_buffer, void *msg_buffer, action *ac);
+
+  bool buffer_action_is_copy(int round) const {
+    return true;
+  }
 };
 
 class binary_tree_bcast_collective :
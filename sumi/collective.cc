@@ -69,8 +69,8 @@ collective::init(type_t ty, transport *api, domain *dom, int tag, int context)
   tag_ = tag;
   type_ = ty;
 
-  const thread_safe_set<int>& failed = api->failed_ranks(context);
-  dense_rank_map rank_map(failed, dom);
+  failure_log::snapshot failed = api->failed_ranks(context);
+  dense_rank_map rank_map = api->rank_map(context, dom);
 
   dense_nproc_ = rank_map.dense_rank(dom->nproc());
   dense_me_ = rank_map.dense_rank(dom->my_domain_rank());
@@ -210,6 +210,25 @@ dag_collective::recv(int target, const collective_work_message::ptr& msg)
   }
 }
 
+void
+dag_collective::recv_chunk(const collective_work_message::ptr& msg, long bytes_done)
+{
+  actor_map::iterator it = my_actors_.find(msg->dense_recver());
+  if (it != my_actors_.end() && it->second){
+    it->second->data_chunk_recved(msg, bytes_done);
+  }
+}
+
+void*
+dag_collective::eager_landing_zone(const collective_work_message::ptr& msg)
+{
+  actor_map::iterator it = my_actors_.find(msg->dense_recver());
+  if (it != my_actors_.end() && it->second){
+    return it->second->eager_landing_zone(msg);
+  }
+  return 0;
+}
+
 void
 dag_collective::start()
 {
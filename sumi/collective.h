@@ -68,6 +68,28 @@ class collective
   void
   recv(const collective_work_message_ptr &msg);
 
+  /**
+   * @brief recv_chunk
+   * Partial progress on an incoming RDMA transfer.
+   * By default, collectives just wait for the full transfer.
+   * @param msg         The RDMA message being received into
+   * @param bytes_done  The leading number of bytes now valid
+   */
+  virtual void
+  recv_chunk(const collective_work_message_ptr& msg, long bytes_done){}
+
+  /**
+   * @brief eager_landing_zone
+   * Where the payload of an incoming eager message will be copied to.
+   * By default, collectives keep the payload in its own buffer.
+   * @param msg The eager message being decoded
+   * @return The final location of the payload, null if there is none
+   */
+  virtual void*
+  eager_landing_zone(const collective_work_message_ptr& msg){
+    return 0;
+  }
+
   virtual void
   start() = 0;
 
@@ -137,6 +159,12 @@ class dag_collective :
   void
   recv(int target, const collective_work_message_ptr& msg);
 
+  void
+  recv_chunk(const collective_work_message_ptr& msg, long bytes_done);
+
+  void*
+  eager_landing_zone(const collective_work_message_ptr& msg);
+
   void
   start();
 
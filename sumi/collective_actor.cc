@@ -6,6 +6,7 @@
 #include <sprockit/output.h>
 #include <cstring>
 #include <utility>
+#include <algorithm>
 
 /*
 #undef debug_printf
@@ -38,7 +39,7 @@ debug_print(const char* info, const std::string& rank_str, int partner, int roun
 void
 collective_actor::init(transport *my_api, domain *dom, int tag, int context, bool fault_aware)
 {
-  rank_map_.init(my_api->failed_ranks(context), dom);
+  rank_map_ = my_api->rank_map(context, dom);
   tag_ = tag;
   dom_ = dom;
   my_api_ = my_api;
@@ -535,7 +536,13 @@ dag_collective_actor::do_send(action* ac)
   protocol_t pr = protocol_for_action(ac);
   switch(pr){
     case eager_protocol:
-      send_eager_message(ac);
+      if (my_api_->has_eager_credit(global_rank(ac->partner))){
+        send_eager_message(ac);
+      } else {
+        //out of eager slots at the partner - the recver is waiting
+        //for me to contact it either way, so a get header is safe
+        send_rdma_get_header(ac);
+      }
       break;
     case get_protocol:
      send_rdma_get_header(ac);
@@ -699,7 +706,7 @@ dag_collective_actor::send_failure_message(
       no_buffer, no_elems, no_size, tag_,
       ac->round, dense_me_,
       ac->partner);
-  msg->append_failed(failed_ranks_);
+  msg->append_failed(failed_ranks_.get_copy());
 
   send_header(ac->partner, msg);
 }
@@ -763,7 +770,7 @@ dag_collective_actor::data_sent(const collective_work_message::ptr& msg)
 void
 dag_collective_actor::incoming_nack(action::type_t ty, const collective_work_message::ptr& msg)
 {
-  const std::set<int>& failed = msg->failed_procs();
+  const rank_set& failed = msg->failed_procs();
   failed_ranks_.insert_all(failed);
   //got from sender, my action is recv
   action_done(ty, msg->round(), msg->dense_sender());
@@ -805,8 +812,15 @@ dag_collective_actor::data_recved(action *ac, const collective_work_message::ptr
       do_debug_print("going into", rank_str().c_str(), ac->partner,
         ac->round, ac->offset, ac->nelems, dst_buffer);
 
-      if (need_recv_action){
-        buffer_action(dst_buffer, recvd_buffer, ac);
+      if (recvd_buffer == dst_buffer){
+        //the transport decoded the payload straight into place
+      } else if (need_recv_action){
+        if (ac->nelems_done == 0){
+          buffer_action(dst_buffer, recvd_buffer, ac);
+        } else {
+          //early chunks were already handled as they arrived
+          buffer_action_range(recvd_buffer, ac, ac->nelems_done, ac->nelems);
+        }
       }
 
       do_debug_print("now", rank_str().c_str(),
@@ -839,6 +853,95 @@ dag_collective_actor::data_recved(
   data_recved(ac, msg, recvd_buffer);
 }
 
+void
+dag_collective_actor::data_chunk_recved(
+  const collective_work_message::ptr& msg,
+  long bytes_done)
+{
+  if (!recv_buffer_){
+    return;
+  }
+
+  uint32_t id = action::message_id(action::recv, msg->round(), msg->dense_sender());
+  active_map::iterator it = active_recvs_.find(id);
+  if (it == active_recvs_.end()){
+    return;
+  }
+
+  action* ac = it->second;
+  if (!out_of_place_round(ac->round)){
+    //data lands directly in the result buffer, nothing to do until the end
+    return;
+  }
+
+  if (dom_->my_domain_rank() == domain_rank(msg->dense_sender())){
+    return;
+  }
+
+  int nelems_done = std::min(long(ac->nelems), bytes_done / type_size_);
+  if (nelems_done <= ac->nelems_done){
+    return;
+  }
+
+  void* recvd_buffer;
+  if (msg->payload_type() == message::rdma_put){
+    recvd_buffer = msg->remote_buffer();
+  } else {
+    recvd_buffer = msg->local_buffer();
+  }
+
+  debug_printf(sumi_collective | sumi_collective_sendrecv,
+    "Rank %s collective %s(%p) handling elements [%d,%d) of %d early for round=%d tag=%d",
+    rank_str().c_str(), to_string().c_str(), this,
+    ac->nelems_done, nelems_done, ac->nelems, ac->round, tag_);
+
+  buffer_action_range(recvd_buffer, ac, ac->nelems_done, nelems_done);
+  ac->nelems_done = nelems_done;
+}
+
+void*
+dag_collective_actor::eager_landing_zone(const collective_work_message::ptr& msg)
+{
+  if (!recv_buffer_ || !result_buffer_){
+    return 0;
+  }
+
+  if (is_failed(msg->dense_sender())
+    || dom_->my_domain_rank() == domain_rank(msg->dense_sender())){
+    return 0;
+  }
+
+  uint32_t id = action::message_id(action::recv, msg->round(), msg->dense_sender());
+  active_map::iterator it = active_recvs_.find(id);
+  if (it == active_recvs_.end()){
+    return 0;
+  }
+
+  action* ac = it->second;
+  if (out_of_place_round(ac->round) || !buffer_action_is_copy(ac->round)
+    || ac->nelems_done != 0 || msg->byte_length() != long(ac->nelems) * type_size_){
+    return 0;
+  }
+
+  debug_printf(sumi_collective | sumi_collective_sendrecv,
+    "Rank %s collective %s(%p) placing eager payload from %d directly for round=%d tag=%d",
+    rank_str().c_str(), to_string().c_str(), this,
+    msg->dense_sender(), ac->round, tag_);
+
+  return message_buffer(result_buffer_, ac->offset);
+}
+
+void
+dag_collective_actor::buffer_action_range(void* recvd_buffer, action* ac, int first, int last)
+{
+  action chunk(*ac);
+  chunk.offset = ac->offset + first;
+  chunk.nelems = last - first;
+  void* dst_buffer = message_buffer(result_buffer_, chunk.offset);
+  void* src_buffer = message_buffer(recvd_buffer, first);
+  buffer_action(dst_buffer, src_buffer, &chunk);
+}
+
 public_buffer
 dag_collective_actor::recv_buffer(int round, int offset)
 {
@@ -1029,7 +1132,7 @@ dag_collective_actor::done_msg() const
   collective_done_message::ptr msg = new collective_done_message(tag_, type_, dom_);
   msg->set_domain_rank(dom_->my_domain_rank());
   msg->set_result(result_buffer_.ptr);
-  thread_safe_set<int>::const_iterator it, end = failed_ranks_.start_iteration();
+  rank_set::const_iterator it, end = failed_ranks_.start_iteration();
   for (it = failed_ranks_.begin(); it != end; ++it){
     msg->append_failed(global_rank(*it));
   }
@@ -1153,7 +1256,7 @@ collective_actor::failed_proc_string() const
 {
   std::stringstream sstr;
   sstr << "{";
-  thread_safe_set<int>::const_iterator it, end = failed_ranks_.start_iteration();
+  rank_set::const_iterator it, end = failed_ranks_.start_iteration();
   for (it = failed_ranks_.begin(); it != end; ++it){
     sstr << " " << *it;
   }
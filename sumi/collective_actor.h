@@ -8,6 +8,7 @@
 #include <map>
 #include <stdint.h>
 #include <sumi/thread_safe_set.h>
+#include <sumi/thread_safe_rank_set.h>
 #include <sumi/config.h>
 
 namespace sumi {
@@ -21,6 +22,8 @@ struct action
   int round;
   int offset;
   int nelems;
+  /** Elements already run through buffer_action from partial transfers */
+  int nelems_done;
   uint32_t id;
 
   static const char*
@@ -51,8 +54,10 @@ struct action
 
  protected:
   action(type_t ty, int r, int p) :
-    type(ty), round(r), partner(p),
-    join_counter(0)
+    type(ty), partner(p),
+    join_counter(0),
+    round(r),
+    nelems_done(0)
   {
     id = message_id(ty, r, p);
   }
@@ -225,7 +230,7 @@ class collective_actor
 
   dense_rank_map rank_map_;
 
-  thread_safe_set<int> failed_ranks_;
+  thread_safe_rank_set failed_ranks_;
 
   timeout_function* timeout_;
 
@@ -259,6 +264,25 @@ class dag_collective_actor :
   virtual void
   start();
 
+  /**
+   * @brief Partial progress on a large RDMA recv.
+   * Lets reductions start on early chunks while later ones are on the wire.
+   * @param msg         The RDMA message being received into
+   * @param bytes_done  The leading number of bytes now valid
+   */
+  void
+  data_chunk_recved(const collective_work_message::ptr& msg, long bytes_done);
+
+  /**
+   * @brief Where an eager payload can be decoded directly.
+   * Only rounds where #buffer_action is a plain copy into the result buffer
+   * qualify, and only if the matching recv is already active.
+   * @param msg The eager message being decoded
+   * @return The final location of the payload, null if none
+   */
+  void*
+  eager_landing_zone(const collective_work_message::ptr& msg);
+
   typedef enum {
     eager_protocol,
     put_protocol,
@@ -345,6 +369,17 @@ class dag_collective_actor :
   virtual void
   buffer_action(void* dst_buffer, void* msg_buffer, action* ac) = 0;
 
+  /**
+   * @return Whether #buffer_action for the round is a plain memcpy
+   */
+  virtual bool
+  buffer_action_is_copy(int round) const {
+    return false;
+  }
+
+  void
+  buffer_action_range(void* recvd_buffer, action* ac, int first, int last);
+
   void* message_buffer(void* buffer, int offset);
 
   public_buffer send_buffer(int offset);
@@ -39,7 +39,7 @@ collective_work_message::serialize_order(sprockit::serializer &ser)
   ser & round_;
   ser & dense_sender_;
   ser & dense_recver_;
-  ser & failed_procs_;
+  failed_procs_.serialize_order(ser);
 }
 
 void
@@ -65,14 +65,6 @@ collective_work_message::to_string() const
     dense_recver_, recver(), dense_sender_, sender(), nelems_, round_);
 }
 
-void
-collective_work_message::append_failed(const thread_safe_set<int>& failed)
-{
-  thread_safe_set<int>::iterator end = failed.start_iteration();
-  failed_procs_.insert(failed.begin(), end);
-  failed.end_iteration();
-}
-
 void
 collective_work_message::clone_into(collective_work_message* cln) const
 {
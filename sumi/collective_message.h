@@ -4,6 +4,7 @@
 #include <sumi/message.h>
 #include <sumi/collective.h>
 #include <sumi/thread_safe_set.h>
+#include <sumi/rank_set.h>
 
 namespace sumi {
 
@@ -72,11 +73,30 @@ class collective_done_message :
     failed_procs_.insert(procs.begin(), procs.end());
   }
 
-  const thread_safe_set<int>&
+  void
+  append_failed(const rank_set& procs){
+    failed_procs_.insert_all(procs);
+  }
+
+  const rank_set&
   failed_procs() const {
     return failed_procs_;
   }
 
+  void
+  append_missing(int proc) {
+    missing_contributions_.insert(proc);
+  }
+
+  /**
+   * For reductions that continue past failures, the ranks whose input
+   * is not in the result. Empty for collectives that fail as a whole.
+   */
+  const rank_set&
+  missing_contributions() const {
+    return missing_contributions_;
+  }
+
   bool
   all_ranks_know_failure() const {
     return all_ranks_know_failure_;
@@ -124,7 +144,8 @@ class collective_done_message :
   void* result_;
   int vote_;
   collective::type_t type_;
-  thread_safe_set<int> failed_procs_;
+  rank_set failed_procs_;
+  rank_set missing_contributions_;
   bool all_ranks_know_failure_;
   int domain_rank_;
   domain* dom_;
@@ -220,9 +241,11 @@ class collective_work_message :
   }
 
   void
-  append_failed(const thread_safe_set<int>& failed);
+  append_failed(const rank_set& failed){
+    failed_procs_.insert_all(failed);
+  }
 
-  const std::set<int>&
+  const rank_set&
   failed_procs() const {
     return failed_procs_;
   }
@@ -267,7 +290,7 @@ class collective_work_message :
 
   action_t action_;
 
-  std::set<int> failed_procs_;
+  rank_set failed_procs_;
 
 };
 
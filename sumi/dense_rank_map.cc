@@ -1,140 +1,146 @@
 #include <sumi/dense_rank_map.h>
 #include <sumi/domain.h>
 #include <sprockit/errors.h>
-#include <algorithm>
+#include <cstring>
 
 namespace sumi {
 
-dense_rank_map::dense_rank_map(const thread_safe_set<int>& failed,
-  domain* dom) :
-  num_failed_ranks_(failed.size()),
-  failed_ranks_(0)
+dense_rank_map::dense_rank_map(const rank_set& failed,
+  domain* dom)
 {
   init(failed, dom);
 }
 
-dense_rank_map::dense_rank_map() :
-  num_failed_ranks_(0),
-  failed_ranks_(0)
+dense_rank_map::dense_rank_map(const failure_log::snapshot& failed,
+  domain* dom)
 {
+  init(failed, dom);
 }
 
-dense_rank_map::~dense_rank_map()
+dense_rank_map::dense_rank_map()
 {
-  if (failed_ranks_){
-    delete[] failed_ranks_;
-  }
 }
 
 void
-dense_rank_map::init(const thread_safe_set<int>& failed, domain* dom)
+dense_rank_map::init(const rank_set& failed, domain* dom)
 {
-  if (failed_ranks_){ //clear out old data
-    delete[] failed_ranks_;
+  if (failed.empty()){
+    index_ = 0;
+  } else {
+    std::vector<const rank_set*> sets(1, &failed);
+    index_ = new index(sets, dom);
   }
+}
 
-  num_failed_ranks_ = failed.size();
+void
+dense_rank_map::init(const failure_log::snapshot& failed, domain* dom)
+{
+  if (failed.empty()){
+    index_ = 0;
+  } else {
+    std::vector<const rank_set*> deltas;
+    failed.deltas(deltas);
+    index_ = new index(deltas, dom);
+  }
+}
 
-  if (num_failed_ranks_ == 0)
-    return;
+dense_rank_map::index::index(const std::vector<const rank_set*>& failed, domain* dom) :
+  num_failed_(0)
+{
+  int nsets = failed.size();
+  if (dom){
+    nproc_ = dom->nproc();
+  } else {
+    //without a domain, only ranks up to the last failure need a bit
+    nproc_ = 0;
+    for (int i=0; i < nsets; ++i){
+      rank_set::const_iterator it, end = failed[i]->start_iteration();
+      for (it=failed[i]->begin(); it != end; ++it){
+        if (*it >= nproc_) nproc_ = *it + 1;
+      }
+      failed[i]->end_iteration();
+    }
+  }
 
-  failed_ranks_ = new int[num_failed_ranks_];
+  num_words_ = (nproc_ + word_mask) / word_size;
+  failed_bits_ = new uint64_t[num_words_];
+  ::memset(failed_bits_, 0, num_words_*sizeof(uint64_t));
+  failed_before_ = new int[num_words_ + 1];
+
+  for (int i=0; i < nsets; ++i){
+    rank_set::const_iterator it, end = failed[i]->start_iteration();
+    for (it=failed[i]->begin(); it != end; ++it){
+      int rank = dom ? dom->global_to_domain_rank(*it) : *it;
+      if (rank < 0 || rank >= nproc_){
+        continue; //not part of this domain
+      }
+      uint64_t bit = uint64_t(1) << (rank & word_mask);
+      uint64_t& word = failed_bits_[rank >> word_bits];
+      if (!(word & bit)){
+        word |= bit;
+        ++num_failed_;
+      }
+    }
+    failed[i]->end_iteration();
+  }
 
-  thread_safe_set<int>::const_iterator it, end = failed.start_iteration();
-  int idx = 0;
-  for (it=failed.begin(); it != end; ++it){
-    int domain_rank = dom ? dom->global_to_domain_rank(*it) : *it;
-    failed_ranks_[idx++] = domain_rank;
+  int padding = num_words_*word_size - nproc_;
+  if (padding){
+    failed_bits_[num_words_-1] |= ~uint64_t(0) << (word_size - padding);
   }
-  failed.end_iteration();
 
-  if (dom){ //we have to sort the failed ranks, potentially
-    //the failed rank stuff assumes ascending order
-    std::sort(failed_ranks_, failed_ranks_ + num_failed_ranks_);
+  failed_before_[0] = 0;
+  for (int w=0; w < num_words_; ++w){
+    failed_before_[w+1] = failed_before_[w] + __builtin_popcountll(failed_bits_[w]);
   }
-}
 
-int
-dense_rank_map::linear_find_rank(int sparse_rank) const
-{
-  for (int i=0; i < num_failed_ranks_; ++i){
-    if (sparse_rank < failed_ranks_[i]){
-        return sparse_rank - i;
+  int num_live = nproc_ - num_failed_;
+  int num_samples = (num_live + word_mask) / word_size;
+  select_samples_ = new int[num_samples + 1];
+  int word = 0;
+  for (int s=0; s < num_samples; ++s){
+    int dense = s*word_size;
+    while (live_before(word+1) <= dense){
+      ++word;
     }
+    select_samples_[s] = word;
   }
-  return sparse_rank - num_failed_ranks_;
 }
 
-int
-dense_rank_map::sparse_rank(int dense_rank) const
+dense_rank_map::index::~index()
 {
-  int rank = dense_rank;
-  for (int i=0; i < num_failed_ranks_; ++i){
-    if (rank >= failed_ranks_[i]){
-      ++rank;
-    }
-    else if (rank < failed_ranks_[i]){
-      return rank; //all done, found it
-    }
-  }
-  return rank;
+  delete[] failed_bits_;
+  delete[] failed_before_;
+  delete[] select_samples_;
 }
 
-int
-dense_rank_map::dense_rank(int sparse_rank) const
+void
+dense_rank_map::index::failed_rank_error(int sparse_rank) const
 {
-  if (num_failed_ranks_ == 0){
-    return sparse_rank;
-  }
-  else if (num_failed_ranks_ <= tree_cutoff){
-    return linear_find_rank(sparse_rank);
-  }
-  else {
-    return tree_find_rank(sparse_rank,
-        0, num_failed_ranks_, failed_ranks_);
-  }
+  spkt_throw_printf(sprockit::value_error,
+    "dense_rank_map::trying to get dense rank for failed process %d",
+    sparse_rank);
 }
 
 int
-dense_rank_map::tree_find_rank(
-  int sparse_rank,
-  int offset,
-  int num_failed,
-  int* failed_array) const
+dense_rank_map::index::sparse_rank(int dense_rank) const
 {
-  //printf("Finding dense rank %d at offset=%d for num=%d on array=%p\n",
-  //  sparse_rank, offset, num_failed, failed_array);
-
-  if (num_failed == 1){
-    if (sparse_rank > failed_array[0]){
-      return sparse_rank - (offset + 1);
-    }
-    else if (sparse_rank < failed_array[0]){
-      return sparse_rank - offset;
-    }
-    else {
-      spkt_throw_printf(sprockit::value_error,
-        "dense_rank_map::trying to get dense rank for failed process %d",
-        sparse_rank);
-    }
+  if (dense_rank >= nproc_ - num_failed_){
+    return dense_rank + num_failed_;
   }
 
-  int middle_index = num_failed / 2;
-  if (sparse_rank < failed_array[middle_index]){
-    return tree_find_rank(sparse_rank, offset, middle_index, failed_array);
-  }
-  else if (sparse_rank > failed_array[middle_index]){
-    return tree_find_rank(sparse_rank, 
-        offset +  middle_index, 
-        num_failed - middle_index, 
-        failed_array + middle_index);
-  }
-  else {
-    spkt_throw_printf(sprockit::value_error,
-      "dense_rank_map::trying to get dense rank for failed process %d",
-      sparse_rank);
+  int word = select_samples_[dense_rank >> word_bits];
+  while (live_before(word+1) <= dense_rank){
+    //only happens when whole words have failed
+    ++word;
   }
 
+  //select the nth live bit in the word
+  uint64_t live = ~failed_bits_[word];
+  for (int n=dense_rank - live_before(word); n > 0; --n){
+    live &= live - 1;
+  }
+  return word*word_size + __builtin_ctzll(live);
 }
 
 }
@@ -1,9 +1,11 @@
 #ifndef sumi_api_DENSE_RANK_MAP_H
 #define sumi_api_DENSE_RANK_MAP_H
 
-#include <set>
 #include <sumi/domain_fwd.h>
-#include <sumi/thread_safe_set.h>
+#include <sumi/failure_log.h>
+#include <sumi/rank_set.h>
+#include <sumi/thread_safe_ptr_type.h>
+#include <stdint.h>
 
 namespace sumi {
 
@@ -16,50 +18,110 @@ namespace sumi {
 * Node 1 dies. There are 2 live nodes.
 * 0 -> 0
 * 2 -> 1
+* The map is a cheap handle to an immutable index, so copies of it
+* can be shared by every actor working on the same context.
 */
 class dense_rank_map {
 
  public:
-  int dense_rank(int sparse_rank) const;
-
-  int sparse_rank(int dense_rank) const;
+  /**
+   * @class index
+   * Bitmap of failed ranks with a prefix count of failures before each word.
+   * Translating sparse to dense is a popcount, translating dense to sparse
+   * starts from a sampled word and selects the bit within the word.
+   */
+  class index : public thread_safe_ptr_type
+  {
+   public:
+    /**
+     * @param failed Disjoint or overlapping sets whose union is the failures
+     * @param dom
+     */
+    index(const std::vector<const rank_set*>& failed, domain* dom);
+
+    ~index();
+
+    int
+    dense_rank(int sparse_rank) const {
+      if (sparse_rank >= nproc_){
+        return sparse_rank - num_failed_;
+      }
+      int word = sparse_rank >> word_bits;
+      uint64_t bit = uint64_t(1) << (sparse_rank & word_mask);
+      if (failed_bits_[word] & bit){
+        failed_rank_error(sparse_rank);
+      }
+      uint64_t below = failed_bits_[word] & (bit - 1);
+      return sparse_rank - failed_before_[word] - __builtin_popcountll(below);
+    }
+
+    int
+    sparse_rank(int dense_rank) const;
+
+    int
+    num_failed() const {
+      return num_failed_;
+    }
+
+   private:
+    static const int word_bits = 6;
+    static const int word_size = 1 << word_bits;
+    static const int word_mask = word_size - 1;
+
+    int
+    live_before(int word) const {
+      return word*word_size - failed_before_[word];
+    }
+
+    /**
+     * A failed rank has no dense rank
+     */
+    void
+    failed_rank_error(int sparse_rank) const;
+
+    index(const index&);
+    index& operator=(const index&);
+
+    int nproc_;
+    int num_failed_;
+    int num_words_;
+    /** Bits past nproc are set so they never count as live */
+    uint64_t* failed_bits_;
+    /** Failed ranks in all words before a given word, num_words+1 entries */
+    int* failed_before_;
+    /** The word holding dense rank i*word_size */
+    int* select_samples_;
+  };
+
+  typedef thread_safe_refcount_ptr<index> index_ptr;
+
+  int
+  dense_rank(int sparse_rank) const {
+    return index_ ? index_->dense_rank(sparse_rank) : sparse_rank;
+  }
+
+  int
+  sparse_rank(int dense_rank) const {
+    return index_ ? index_->sparse_rank(dense_rank) : dense_rank;
+  }
 
   dense_rank_map();
 
-  dense_rank_map(const thread_safe_set<int>& failed, domain* dom = 0);
+  dense_rank_map(const rank_set& failed, domain* dom = 0);
 
-  ~dense_rank_map();
+  dense_rank_map(const failure_log::snapshot& failed, domain* dom = 0);
 
   void
-  init(const thread_safe_set<int>& failed, domain* dom = 0);
-
- protected:
-  static const int tree_cutoff = 4;
+  init(const rank_set& failed, domain* dom = 0);
 
   /**
-   * O(N) search algorithm for new rank for N = # failures
-   * @param sparse_rank
-   * @return
+   * Build straight from the epoch deltas without gathering them into one set
    */
-  int 
-  linear_find_rank(int sparse_rank) const;
-
-  /**
-   * O(log N) search algorithm for new rank,
-   * but with larger prefactor for N = # failures
-   * @param sparse_rank
-   * @return
-   */
-  int 
-  tree_find_rank(
-    int sparse_rank,
-    int offset,
-    int num_failed_ranks,
-    int* failed_array) const;
+  void
+  init(const failure_log::snapshot& failed, domain* dom = 0);
 
  protected:
-  int num_failed_ranks_;
-  int* failed_ranks_;
+  index_ptr index_;
 
 };
 
@@ -35,5 +35,36 @@ index_domain::global_to_domain_rank(int global_rank) const
     "index_domain::global_to_domain_rank: this should only be involved in failures");
 }
 
+spare_domain::spare_domain(int my_global_rank, int nslots, int total_nproc) :
+  my_global_rank_(my_global_rank),
+  slot_to_global_(nslots),
+  global_to_slot_(total_nproc, -1)
+{
+  for (int i=0; i < nslots; ++i){
+    slot_to_global_[i] = i;
+    global_to_slot_[i] = i;
+  }
+  my_domain_rank_ = global_to_slot_[my_global_rank];
 }
 
+void
+spare_domain::substitute(int slot, int global_rank)
+{
+  if (global_to_slot_[global_rank] >= 0){
+    spkt_throw_printf(sprockit::value_error,
+      "spare_domain::substitute: rank %d already holds slot %d",
+      global_rank, global_to_slot_[global_rank]);
+  }
+  int old_rank = slot_to_global_[slot];
+  global_to_slot_[old_rank] = -1;
+  slot_to_global_[slot] = global_rank;
+  global_to_slot_[global_rank] = slot;
+  if (old_rank == my_global_rank_){
+    my_domain_rank_ = -1;
+  }
+  if (global_rank == my_global_rank_){
+    my_domain_rank_ = slot;
+  }
+}
+
+}
@@ -2,6 +2,7 @@
 #define sumi_DOMAIN_H
 
 #include <sumi/transport_fwd.h>
+#include <vector>
 
 namespace sumi {
 
@@ -170,6 +171,54 @@ class subrange_domain :
   int start_;
 };
 
+/**
+ * @class spare_domain
+ * The working ranks of a job that holds some ranks back as spares.
+ * Each slot is held by one global rank. When the rank holding a slot
+ * fails, a spare takes over the slot so the domain keeps its size
+ * and collectives keep their power-of-two shapes.
+ * Translation in either direction is a table lookup.
+ */
+class spare_domain :
+  public domain
+{
+ public:
+  /**
+   * @param my_global_rank
+   * @param nslots  Slot i starts out held by global rank i
+   * @param total_nproc The number of global ranks, including spares
+   */
+  spare_domain(int my_global_rank, int nslots, int total_nproc);
+
+  int nproc() const {
+    return slot_to_global_.size();
+  }
+
+  int domain_to_global_rank(int domain_rank) const {
+    return slot_to_global_[domain_rank];
+  }
+
+  /**
+   * @return The slot, -1 if the rank holds no slot
+   */
+  int global_to_domain_rank(int global_rank) const {
+    return global_to_slot_[global_rank];
+  }
+
+  /**
+   * Hand a slot over to a new global rank
+   * @param slot
+   * @param global_rank A rank not currently holding a slot
+   */
+  void
+  substitute(int slot, int global_rank);
+
+ private:
+  int my_global_rank_;
+  std::vector<int> slot_to_global_;
+  std::vector<int> global_to_slot_;
+};
+
 }
 
 #endif // DOMAIN_H
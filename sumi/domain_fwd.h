@@ -3,6 +3,7 @@
 
 namespace sumi {
 class domain;
+class spare_domain;
 }
 
 
@@ -3,6 +3,7 @@
 #include <sumi/domain.h>
 #include <sprockit/serializer.h>
 #include <sprockit/stl_string.h>
+#include <cstring>
 
 /*
 #undef debug_printf
@@ -50,11 +51,21 @@ dynamic_tree_vote_message::recv_buffer() const
     "dynamic_tree_vote_message: does not have recv buffer");
 }
 
+void
+dynamic_tree_vote_message::set_payload(const void* buf, int bytes)
+{
+  const char* cbuf = (const char*) buf;
+  payload_.assign(cbuf, cbuf + bytes);
+  num_bytes_ += bytes;
+}
+
 void
 dynamic_tree_vote_message::serialize_order(sprockit::serializer &ser)
 {
   ser & vote_;
   ser & type_;
+  ser & payload_;
+  contributors_.serialize_order(ser);
   collective_work_message::serialize_order(ser);
 }
 
@@ -78,7 +89,7 @@ dynamic_tree_vote_actor::position(int rank, int &level, int &branch)
   int stride = 1;
   while (rank >= level_upper_bound){
     ++level;
-    stride *= 2;
+    stride *= radix_;
     level_upper_bound += stride;
   }
   int level_lower_bound = level_upper_bound - stride;
@@ -92,7 +103,7 @@ dynamic_tree_vote_actor::level_stats(int level, int& start, int& size)
   int stride = 1;
   for (int i=0; i < level; ++i){
     lower_bound += stride;
-    stride *= 2;
+    stride *= radix_;
   }
   start = lower_bound;
   size = stride;
@@ -109,7 +120,7 @@ dynamic_tree_vote_actor::level_lower_bound(int level)
 int
 dynamic_tree_vote_actor::down_partner(int level, int branch)
 {
-  int down_branch = branch*2;
+  int down_branch = branch*radix_;
   int down_level_start = level_lower_bound(level + 1);
   return down_level_start + down_branch;
 }
@@ -117,7 +128,7 @@ dynamic_tree_vote_actor::down_partner(int level, int branch)
 int
 dynamic_tree_vote_actor::up_partner(int level, int branch)
 {
-  int up_branch = branch / 2;
+  int up_branch = branch / radix_;
   int up_level_start = level_lower_bound(level - 1);
   return up_level_start + up_branch;
 }
@@ -135,13 +146,25 @@ dynamic_tree_vote_actor::dynamic_tree_vote_actor(int vote,
     int tag,
     transport* my_api,
     domain* dom,
-    int context) :
+    int context,
+    int radix) :
   collective_actor(my_api, dom, tag, context, true), //true for always fault-aware
+  radix_(radix),
   vote_(vote),
   fxn_(fxn),
+  payload_(0),
+  payload_nelems_(0),
+  payload_bytes_(0),
+  payload_fxn_(0),
   tag_(tag),
   stage_(recv_vote)
 {
+  if (radix_ < 2){
+    spkt_throw_printf(sprockit::value_error,
+      "dynamic_tree_vote_actor: invalid radix %d, must be at least 2",
+      radix_);
+  }
+
   int ignore;
   position(dense_me_, my_level_, my_branch_);
   //figure out the bottom level from nproc
@@ -150,11 +173,7 @@ dynamic_tree_vote_actor::dynamic_tree_vote_actor(int vote,
 
   if (my_level_ != bottom_level_){
     int partner = down_partner(my_level_, my_branch_);
-    if (partner < dense_nproc_){
-      down_partners_.insert(partner);
-    }
-    ++partner;
-    if (partner < dense_nproc_){
+    for (int i=0; i < radix_ && partner < dense_nproc_; ++i, ++partner){
       down_partners_.insert(partner);
     }
   }
@@ -167,12 +186,31 @@ dynamic_tree_vote_actor::dynamic_tree_vote_actor(int vote,
   }
 
   debug_printf(sumi_collective | sumi_vote,
-    "Rank %s from nproc=%d(%d) is at level=%d start=%d bottom=%d in branch=%d up=%d down=%s on tag=%d ",
-    rank_str().c_str(), dense_nproc_, my_api_->nproc(),
+    "Rank %s from nproc=%d(%d) radix=%d is at level=%d start=%d bottom=%d in branch=%d up=%d down=%s on tag=%d ",
+    rank_str().c_str(), dense_nproc_, my_api_->nproc(), radix_,
     my_level_, my_level_start_, bottom_level_ + 1,
     my_branch_, up_partner_, down_partners_.to_string().c_str(), tag_);
 }
 
+void
+dynamic_tree_vote_actor::init_payload(void* dst, void* src, int nelems, int type_size, reduce_fxn fxn)
+{
+  if (dst == 0 && nelems){
+    spkt_throw_printf(sprockit::value_error,
+      "dynamic_tree_vote_actor: null result buffer for %d elements on tag=%d",
+      nelems, tag_);
+  }
+  payload_ = dst;
+  payload_nelems_ = nelems;
+  payload_bytes_ = nelems * type_size;
+  payload_fxn_ = fxn;
+  if (src && src != dst){
+    ::memcpy(dst, src, payload_bytes_);
+  }
+  contributors_.clear();
+  contributors_.insert(dense_me_);
+}
+
 void
 dynamic_tree_vote_actor::up_partner_failed()
 {
@@ -252,12 +290,9 @@ dynamic_tree_vote_actor::down_partner_failed(int rank)
     up_partner_,
     up_votes_recved_.to_string().c_str());
 
+  //adopt all the children of the failed rank
   int new_partner = down_partner(down_level, down_branch);
-  if (new_partner < dense_nproc_){
-    add_new_down_partner(new_partner);
-  }
-  ++new_partner;
-  if (new_partner < dense_nproc_){
+  for (int i=0; i < radix_ && new_partner < dense_nproc_; ++i, ++new_partner){
     add_new_down_partner(new_partner);
   }
 
@@ -393,12 +428,16 @@ void
 dynamic_tree_vote_actor::send_message(dynamic_tree_vote_message::type_t ty, int virtual_dst)
 {
   dynamic_tree_vote_message::ptr msg = new dynamic_tree_vote_message(vote_, ty, tag_, dense_me_, virtual_dst);
+  if (payload_bytes_){
+    msg->set_payload(payload_, payload_bytes_);
+    msg->set_contributors(contributors_);
+  }
   if (stage_ == up_vote){  //If I am up-voting, go ahead and vote for as many failures as I know
-    msg->append_failed(failed_ranks_);
+    msg->append_failed(failed_ranks_.get_copy());
   }
   else {
     // I can only send the failures that everyone has agreed upon
-    msg->append_failed(agreed_upon_failures_);
+    msg->append_failed(agreed_upon_failures_.get_copy());
   }
 
   int global_phys_dst = global_rank(virtual_dst);
@@ -408,7 +447,7 @@ dynamic_tree_vote_actor::send_message(dynamic_tree_vote_message::type_t ty, int
     vote_, dynamic_tree_vote_message::tostr(ty), 
     rank_str(virtual_dst).c_str(),
     tag_, failed_ranks_.to_string().c_str(),
-    stl_string(msg->failed_procs()).c_str());
+    msg->failed_procs().to_string().c_str());
   my_api_->send_payload(global_phys_dst, msg);
 }
 
@@ -418,26 +457,65 @@ dynamic_tree_vote_actor::recv_result(const dynamic_tree_vote_message::ptr&msg)
   debug_printf(sumi_collective | sumi_vote,
       "Rank %d receving result vote=%d, failed=%s on tag=%d",
       my_api_->rank(), vote_,
-      stl_string(msg->failed_procs()).c_str(), tag_);
-  const std::set<int> extra_failed = msg->failed_procs();
+      msg->failed_procs().to_string().c_str(), tag_);
+  const rank_set& extra_failed = msg->failed_procs();
   vote_ = msg->vote();
+  if (payload_bytes_){
+    check_payload(msg);
+    ::memcpy(payload_, msg->payload(), payload_bytes_);
+    contributors_ = msg->contributors();
+  }
   agreed_upon_failures_ = msg->failed_procs();
   failed_ranks_.insert_all(extra_failed);
 }
 
+void
+dynamic_tree_vote_actor::check_payload(const dynamic_tree_vote_message::ptr& msg)
+{
+  if (msg->payload_size() != payload_bytes_){
+    spkt_throw_printf(sprockit::value_error,
+      "dynamic_vote_actor: rank %d got payload of %d bytes from %d on tag=%d, expected %d",
+      my_api_->rank(), msg->payload_size(), msg->dense_sender(), tag_, payload_bytes_);
+  }
+}
+
+void
+dynamic_tree_vote_actor::merge_payload(const dynamic_tree_vote_message::ptr& msg)
+{
+  check_payload(msg);
+  const rank_set& incoming = msg->contributors();
+  rank_set fresh;
+  set_difference(incoming, contributors_, fresh);
+  if (fresh.size() == incoming.size()){
+    (*payload_fxn_)(payload_, msg->payload(), payload_nelems_);
+    contributors_.insert_all(incoming);
+  } else {
+    //a rank we adopted after its parent failed may resend input the parent
+    //already forwarded - the reduction is not idempotent, so drop it
+    //and let any new ranks in it show up as missing contributions
+    debug_printf(sumi_collective | sumi_vote,
+      "Rank %s dropping payload from %d on tag=%d: contributors %s overlap %s",
+      rank_str().c_str(), msg->dense_sender(), tag_,
+      incoming.to_string().c_str(), contributors_.to_string().c_str());
+  }
+}
+
 void
 dynamic_tree_vote_actor::merge_result(const dynamic_tree_vote_message::ptr& msg)
 {
-  const std::set<int> extra_failed = msg->failed_procs();
+  const rank_set& extra_failed = msg->failed_procs();
 
   if (stage_ == recv_vote){
     debug_printf(sumi_collective | sumi_vote,
       "Rank %d merging result vote=%d failed=%s on tag=%d into final result vote=%d failed=%s",
       my_api_->rank(), msg->vote(),
-      stl_string(msg->failed_procs()).c_str(), tag_,
+      msg->failed_procs().to_string().c_str(), tag_,
       vote_, failed_ranks_.to_string().c_str());
     agreed_upon_failures_.insert_all(extra_failed);
     (*fxn_)(vote_, msg->vote());
+    if (payload_bytes_){
+      merge_payload(msg);
+    }
   }
 
   failed_ranks_.insert_all(extra_failed);
@@ -449,11 +527,21 @@ dynamic_tree_vote_actor::put_done_notification()
   collective_done_message::ptr msg = new collective_done_message(tag_, collective::dynamic_tree_vote, dom_);
   msg->set_domain_rank(dom_->my_domain_rank());
   //convert the virtual ranks to physical ranks
-  thread_safe_set<int>::const_iterator it, end = agreed_upon_failures_.start_iteration();
+  rank_set::const_iterator it, end = agreed_upon_failures_.start_iteration();
   for (it = agreed_upon_failures_.begin(); it != end; ++it){
     msg->append_failed(global_rank(*it));
   }
   agreed_upon_failures_.end_iteration();
+  if (payload_bytes_){
+    msg->set_result(payload_);
+    rank_set everyone, missing;
+    everyone.insert_range(0, dense_nproc_);
+    set_difference(everyone, contributors_, missing);
+    rank_set::const_iterator it, end = missing.end();
+    for (it = missing.begin(); it != end; ++it){
+      msg->append_missing(global_rank(*it));
+    }
+  }
   msg->set_vote(vote_);
   debug_printf(sumi_collective | sumi_vote,
     "Rank %d has completed with vote=%d failed=%s tag=%d ",
@@ -501,7 +589,7 @@ dynamic_tree_vote_actor::recv_down_vote(const dynamic_tree_vote_message::ptr& ms
     "Rank %s got down vote %d on stage %s from rank=%d tag=%d for failed=%s",
      rank_str().c_str(), msg->vote(), tostr(stage_),
      msg->dense_sender(), tag_,
-     stl_string(msg->failed_procs()).c_str());
+     msg->failed_procs().to_string().c_str());
      
 
   if (stage_ == down_vote){
@@ -661,10 +749,20 @@ dynamic_tree_vote_collective::dynamic_tree_vote_collective(
   vote_(vote),
   fxn_(fxn)
 {
-  actors_[dense_me_] = new dynamic_tree_vote_actor(vote, fxn, tag, my_api, dom, context);
+  actors_[dense_me_] = new dynamic_tree_vote_actor(vote, fxn, tag, my_api, dom,
+                                                   context, my_api->vote_radix());
   refcounts_[dom_->my_domain_rank()] = actors_.size();
 }
 
+void
+dynamic_tree_vote_collective::init_payload(void* dst, void* src, int nelems, int type_size, reduce_fxn fxn)
+{
+  actor_map::iterator it, end = actors_.end();
+  for (it=actors_.begin(); it != end; ++it){
+    it->second->init_payload(dst, src, nelems, type_size, fxn);
+  }
+}
+
 void
 dynamic_tree_vote_collective::recv(int target, const collective_work_message::ptr&msg)
 {
@@ -6,6 +6,7 @@
 #include <sumi/comm_functions.h>
 #include <sumi/collective.h>
 #include <sumi/thread_safe_set.h>
+#include <vector>
 
 namespace sumi {
 
@@ -38,6 +39,40 @@ class dynamic_tree_vote_message :
   void*
   recv_buffer() const;
 
+  /**
+   * Attach a reduction payload, which is copied into the message
+   * @param buf
+   * @param bytes
+   */
+  void
+  set_payload(const void* buf, int bytes);
+
+  /**
+   * @return The reduction payload, null if the vote carries none
+   */
+  const void*
+  payload() const {
+    return payload_.empty() ? 0 : &payload_[0];
+  }
+
+  int
+  payload_size() const {
+    return payload_.size();
+  }
+
+  /**
+   * @return The dense ranks whose input has been combined into the payload
+   */
+  const rank_set&
+  contributors() const {
+    return contributors_;
+  }
+
+  void
+  set_contributors(const rank_set& ranks) {
+    contributors_ = ranks;
+  }
+
   static const char*
   tostr(type_t);
 
@@ -62,6 +97,10 @@ class dynamic_tree_vote_message :
 
   int vote_;
 
+  std::vector<char> payload_;
+
+  rank_set contributors_;
+
 };
 
 class dynamic_tree_vote_actor :
@@ -87,11 +126,15 @@ class dynamic_tree_vote_actor :
   void
   recv(const dynamic_tree_vote_message::ptr& msg);
 
+  /**
+   * @param radix The number of children of each node in the vote tree
+   */
   dynamic_tree_vote_actor(int vote,
     vote_fxn fxn, int tag,
     transport* my_api,
     domain* dom,
-    int context);
+    int context,
+    int radix);
 
   stage_t
   stage() const {
@@ -110,6 +153,19 @@ class dynamic_tree_vote_actor :
 
   void start();
 
+  /**
+   * Carry a reduction payload alongside the vote. The payload is combined
+   * going up the tree and the root's result is copied into dst going down,
+   * so every survivor ends with the same data.
+   * @param dst The result buffer
+   * @param src The input buffer, can be null or equal to dst for in-place
+   * @param nelems
+   * @param type_size
+   * @param fxn The function combining payloads
+   */
+  void
+  init_payload(void* dst, void* src, int nelems, int type_size, reduce_fxn fxn);
+
  protected:
   void put_done_notification();
 
@@ -191,6 +247,17 @@ class dynamic_tree_vote_actor :
   void
   recv_result(const dynamic_tree_vote_message::ptr& msg);
 
+  void
+  check_payload(const dynamic_tree_vote_message::ptr& msg);
+
+  /**
+   * Combine a payload coming up the tree, unless some of its contributions
+   * were already combined through a partner that has since failed.
+   * @param msg
+   */
+  void
+  merge_payload(const dynamic_tree_vote_message::ptr& msg);
+
   void append_down_partners(int position);
 
   void send_message(dynamic_tree_vote_message::type_t ty, int dst);
@@ -262,15 +329,24 @@ class dynamic_tree_vote_actor :
   int my_level_start_;
   int bottom_level_;
 
+  int radix_;
+
   int vote_;
   vote_fxn fxn_;
 
+  void* payload_;
+  int payload_nelems_;
+  int payload_bytes_;
+  reduce_fxn payload_fxn_;
+  /** Dense ranks whose input has been combined into the payload */
+  rank_set contributors_;
+
   int tag_;
 
   stage_t stage_;
 
-  thread_safe_set<int> agreed_upon_failures_;
-  thread_safe_set<int> failures_handled_;
+  thread_safe_rank_set agreed_upon_failures_;
+  thread_safe_rank_set failures_handled_;
   thread_safe_set<int> up_votes_recved_;
 };
 
@@ -305,6 +381,12 @@ class dynamic_tree_vote_collective :
     domain* dom,
     int context);
 
+  /**
+   * See dynamic_tree_vote_actor::init_payload. Must be called before #start.
+   */
+  void
+  init_payload(void* dst, void* src, int nelems, int type_size, reduce_fxn fxn);
+
  protected:
   void put_done_notification();
 
@@ -0,0 +1,181 @@
+#include <sumi/failure_log.h>
+#include <algorithm>
+
+namespace sumi {
+
+failure_log::failure_log()
+{
+  entries_.push_back(entry(0, 0, 0, 0, rank_set()));
+}
+
+int
+failure_log::append(int parent, const rank_set& failed)
+{
+  rank_set delta;
+  if (parent == 0){
+    delta = failed;
+  } else {
+    rank_set known;
+    for (int r=0; r < failed.num_runs(); ++r){
+      find_known(failed.start(r), failed.stop(r), parent, known);
+    }
+    set_difference(failed, known, delta);
+  }
+
+  if (delta.empty()){
+    return parent;
+  }
+
+  //votes that keep finding the same failures share an epoch
+  const std::vector<int>& siblings = entries_[parent].children;
+  int nsiblings = siblings.size();
+  for (int i=0; i < nsiblings; ++i){
+    if (entries_[siblings[i]].delta == delta){
+      return siblings[i];
+    }
+  }
+
+  entry& p = entries_[parent];
+  const entry& pj = entries_[p.jump];
+  int jump = (p.depth - pj.depth == pj.depth - entries_[pj.jump].depth)
+    ? pj.jump : parent;
+  int size = p.size + delta.size();
+  entries_.push_back(entry(parent, p.depth + 1, jump, size, delta));
+
+  int epoch = entries_.size() - 1;
+  p.children.push_back(epoch);
+  for (int r=0; r < delta.num_runs(); ++r){
+    index_run(delta.start(r), delta.stop(r), epoch);
+  }
+  return epoch;
+}
+
+bool
+failure_log::descends(int e, int a) const
+{
+  int depth = entries_[a].depth;
+  if (depth > entries_[e].depth){
+    return false;
+  }
+  while (entries_[e].depth > depth){
+    const entry& ent = entries_[e];
+    e = entries_[ent.jump].depth >= depth ? ent.jump : ent.parent;
+  }
+  return e == a;
+}
+
+bool
+failure_log::seen_by(const segment& seg, int e) const
+{
+  int nepochs = seg.epochs.size();
+  for (int i=0; i < nepochs; ++i){
+    if (descends(e, seg.epochs[i])){
+      return true;
+    }
+  }
+  return false;
+}
+
+void
+failure_log::find_known(int start, int stop, int e, rank_set& known) const
+{
+  std::map<int, segment>::const_iterator it = segments_.upper_bound(start);
+  if (it != segments_.begin()){
+    --it;
+    if (it->second.stop <= start){
+      ++it;
+    }
+  }
+  for ( ; it != segments_.end() && it->first < stop; ++it){
+    if (seen_by(it->second, e)){
+      known.insert_range(std::max(start, it->first),
+                         std::min(stop, it->second.stop));
+    }
+  }
+}
+
+void
+failure_log::split_segment(int rank)
+{
+  std::map<int, segment>::iterator it = segments_.upper_bound(rank);
+  if (it == segments_.begin()){
+    return;
+  }
+  --it;
+  if (it->first < rank && it->second.stop > rank){
+    segment& tail = segments_[rank];
+    tail.stop = it->second.stop;
+    tail.epochs = it->second.epochs;
+    it->second.stop = rank;
+  }
+}
+
+void
+failure_log::index_run(int start, int stop, int epoch)
+{
+  split_segment(start);
+  split_segment(stop);
+
+  int pos = start;
+  std::map<int, segment>::iterator it = segments_.lower_bound(start);
+  while (pos < stop){
+    int gap_stop = (it == segments_.end() || it->first >= stop) ? stop : it->first;
+    if (gap_stop > pos){
+      segment& gap = segments_[pos];
+      gap.stop = gap_stop;
+      gap.epochs.push_back(epoch);
+    }
+    if (gap_stop == stop){
+      break;
+    }
+    it->second.epochs.push_back(epoch);
+    pos = it->second.stop;
+    ++it;
+  }
+}
+
+size_t
+failure_log::snapshot::count(int rank) const
+{
+  if (epoch_ == 0){
+    return 0;
+  }
+
+  std::map<int, segment>::const_iterator it = log_->segments_.upper_bound(rank);
+  if (it == log_->segments_.begin()){
+    return 0;
+  }
+  --it;
+  if (it->second.stop <= rank){
+    return 0;
+  }
+
+  return log_->seen_by(it->second, epoch_) ? 1 : 0;
+}
+
+void
+failure_log::snapshot::deltas(std::vector<const rank_set*>& deltas) const
+{
+  for (int e=epoch_; e != 0; e=log_->entries_[e].parent){
+    deltas.push_back(&log_->entries_[e].delta);
+  }
+}
+
+void
+failure_log::snapshot::collect(rank_set& failed) const
+{
+  failed.clear();
+  for (int e=epoch_; e != 0; e=log_->entries_[e].parent){
+    failed.insert_all(log_->entries_[e].delta);
+  }
+}
+
+std::string
+failure_log::snapshot::to_string() const
+{
+  rank_set failed;
+  collect(failed);
+  return failed.to_string();
+}
+
+}
@@ -0,0 +1,175 @@
+#ifndef sumi_api_FAILURE_LOG_H
+#define sumi_api_FAILURE_LOG_H
+
+#include <sumi/rank_set.h>
+#include <deque>
+#include <vector>
+#include <map>
+#include <string>
+
+namespace sumi {
+
+/**
+ * @class failure_log
+ * Append-only history of failures. Each epoch records only the ranks
+ * that failed since its parent epoch. Committing a new context looks up
+ * just the incoming ranks in the index, so it costs O(new failures) no
+ * matter how long the history is. Contexts that saw no new failures share
+ * their parent's epoch and contexts that add the same failures to the same
+ * parent share one epoch, so the log grows with distinct failure histories,
+ * not with the number of votes. Epochs are never freed, any snapshot
+ * may still point at them.
+ * Epoch 0 is the failure-free start of the job.
+ * Collective and vote messages still carry the failures found during
+ * that collective rather than an epoch.
+ */
+class failure_log
+{
+  struct entry {
+    int parent;
+    int depth;
+    /** Skew-binary jump pointer, an ancestor up to ~2x as far as the parent */
+    int jump;
+    /** Failures in this epoch and all its ancestors */
+    int size;
+    rank_set delta;
+    /** Epochs with this one as their parent */
+    std::vector<int> children;
+    entry(int p, int dep, int j, int s, const rank_set& d) :
+      parent(p), depth(dep), jump(j), size(s), delta(d)
+    {
+    }
+  };
+
+  /**
+   * A range of ranks and every epoch that added them.
+   * Sibling epochs may both add a rank, otherwise there is only one.
+   */
+  struct segment {
+    int stop;
+    std::vector<int> epochs;
+  };
+
+ public:
+  /**
+   * @class snapshot
+   * Read-only view of all failures up to an epoch.
+   * Cheap to copy, nothing is gathered until asked for.
+   */
+  class snapshot
+  {
+    friend class failure_log;
+   public:
+    snapshot() : log_(0), epoch_(0) {}
+
+    int
+    epoch() const {
+      return epoch_;
+    }
+
+    bool
+    empty() const {
+      return epoch_ == 0;
+    }
+
+    size_t
+    size() const {
+      return log_ ? log_->entries_[epoch_].size : 0;
+    }
+
+    /**
+     * O(log segments + log epochs), independent of how long the chain is
+     */
+    size_t
+    count(int rank) const;
+
+    /**
+     * @param deltas [out] The new failures of each epoch, newest first
+     */
+    void
+    deltas(std::vector<const rank_set*>& deltas) const;
+
+    /**
+     * @param failed [out] Every failure in the snapshot
+     */
+    void
+    collect(rank_set& failed) const;
+
+    std::string
+    to_string() const;
+
+   private:
+    snapshot(const failure_log* log, int epoch) :
+      log_(log), epoch_(epoch)
+    {
+    }
+
+    const failure_log* log_;
+    int epoch_;
+  };
+
+  failure_log();
+
+  /**
+   * @param parent The epoch the failures are relative to
+   * @param failed Failures agreed on since the parent, may repeat older ones
+   * @return The epoch holding parent + failed, the parent itself if nothing is new
+   */
+  int
+  append(int parent, const rank_set& failed);
+
+  snapshot
+  view(int epoch) const {
+    return snapshot(this, epoch);
+  }
+
+  /**
+   * @return The ranks an epoch added over its parent
+   */
+  const rank_set&
+  delta(int epoch) const {
+    return entries_[epoch].delta;
+  }
+
+  int
+  num_epochs() const {
+    return entries_.size();
+  }
+
+ private:
+  /**
+   * @return Whether epoch a is epoch e or one of its ancestors
+   */
+  bool
+  descends(int e, int a) const;
+
+  /**
+   * @return Whether one of the epochs that added the segment is epoch e
+   *         or one of its ancestors
+   */
+  bool
+  seen_by(const segment& seg, int e) const;
+
+  /**
+   * @param known [out] Adds the ranks in [start,stop) that epoch e has failed
+   */
+  void
+  find_known(int start, int stop, int e, rank_set& known) const;
+
+  void
+  split_segment(int rank);
+
+  void
+  index_run(int start, int stop, int epoch);
+
+  /** A deque so a snapshot's deltas stay put while new epochs are appended */
+  std::deque<entry> entries_;
+
+  /** Disjoint ranges of failed ranks keyed by their first rank */
+  std::map<int, segment> segments_;
+
+};
+
+}
+
+#endif // sumi_api_FAILURE_LOG_H
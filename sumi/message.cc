@@ -4,6 +4,7 @@
 DeclareSerializable(sumi::message)
 DeclareSerializable(sumi::rdma_message)
 DeclareSerializable(sumi::payload_message)
+DeclareSerializable(sumi::batch_message)
 
 namespace sumi {
 
@@ -126,6 +127,8 @@ message::tostr(class_t ty)
     enumcase(terminate);
     enumcase(no_class);
     enumcase(fake);
+    enumcase(batch);
+    enumcase(credit);
   }
   spkt_throw_printf(sprockit::value_error,
     "message::tostr: invalid message type %d", ty);
@@ -151,6 +154,7 @@ message::serialize_order(sprockit::serializer &ser)
   ser & transaction_id_;
   ser & needs_send_ack_;
   ser & needs_recv_ack_;
+  ser & credits_;
 }
 
 void
@@ -176,5 +180,13 @@ rdma_message::serialize_order(sprockit::serializer &ser)
   ser & remote_buffer_;
 }
 
+void
+batch_message::serialize_order(sprockit::serializer& ser)
+{
+  message::serialize_order(ser);
+  ser & num_msgs_;
+  ser & packed_;
+}
+
 }
 
@@ -7,6 +7,8 @@
 #include <sprockit/ser_ptr_type.h>
 #include <sprockit/util.h>
 #include <sumi/rdma_interface.h>
+#include <list>
+#include <vector>
 
 namespace sumi {
 
@@ -45,7 +47,9 @@ class message :
     collective_done,
     ping,
     no_class,
-    fake
+    fake,
+    batch,
+    credit
  } class_t;
 
  public:
@@ -59,7 +63,8 @@ class message :
    class_(pt2pt),
    transaction_id_(-1),
    needs_send_ack_(false),
-   needs_recv_ack_(false)
+   needs_recv_ack_(false),
+   credits_(0)
   {
     num_bytes_ = sizeof(message);
   }
@@ -70,7 +75,8 @@ class message :
    transaction_id_(-1),
    num_bytes_(num_bytes),
    needs_send_ack_(false),
-   needs_recv_ack_(false)
+   needs_recv_ack_(false),
+   credits_(0)
   {
   }
 
@@ -195,6 +201,20 @@ class message :
     needs_recv_ack_ = need;
   }
 
+  /**
+   * @return The number of eager slots at the sender being handed back
+   *         to the receiver, piggybacked on this message
+   */
+  int
+  credits() const {
+    return credits_;
+  }
+
+  void
+  set_credits(int credits) {
+    credits_ = credits;
+  }
+
  protected:
   void
   clone_into(message* cln) const;
@@ -216,6 +236,8 @@ class message :
 
   bool needs_recv_ack_;
 
+  int credits_;
+
 };
 
 class payload_message :
@@ -275,6 +297,58 @@ class rdma_message :
 
 };
 
+/**
+ * @class batch_message
+ * Carries several small messages bound for the same destination
+ * in a single transport send. The coalescing stage in #transport::smsg_send
+ * packs each message with its wire header as soon as it is queued,
+ * so the batch holds (size, wire bytes) records rather than message objects.
+ */
+class batch_message :
+  public message,
+  public sprockit::serializable_type<batch_message>
+{
+  ImplementSerializableDefaultConstructor(batch_message)
+
+ public:
+  typedef sprockit::refcount_ptr<batch_message> ptr;
+
+ public:
+  batch_message() : num_msgs_(0)
+  {
+    class_ = batch;
+  }
+
+  /**
+   * @param num_msgs
+   * @param packed Swapped into the message, left empty
+   */
+  batch_message(int num_msgs, std::vector<char>& packed) :
+    num_msgs_(num_msgs)
+  {
+    class_ = batch;
+    packed_.swap(packed);
+  }
+
+  int
+  num_messages() const {
+    return num_msgs_;
+  }
+
+  const std::vector<char>&
+  packed() const {
+    return packed_;
+  }
+
+  virtual void
+  serialize_order(sprockit::serializer& ser);
+
+ private:
+  int num_msgs_;
+  std::vector<char> packed_;
+
+};
+
 
 }
 
@@ -2,6 +2,12 @@
 #include <sumi/transport.h>
 #include <sprockit/sim_parameters.h>
 #include <sprockit/util.h>
+#include <sprockit/keyword_registration.h>
+
+RegisterKeywords(
+  "ping_timeout",
+  "ping_wheel_tick"
+);
 
 using namespace sprockit::dbg;
 
@@ -10,8 +16,9 @@ namespace sumi
 
 SpktRegister("ping", activity_monitor, ping_monitor);
 
-pinger::pinger(transport* api, int dst, double timeout) :
+pinger::pinger(transport* api, int dst, double timeout, timer_wheel* wheel) :
   my_api_(api),
+  wheel_(wheel),
   dst_(dst),
   timeout_(timeout),
   //this is necessary, I haven't figured out why
@@ -34,6 +41,10 @@ pinger::arrived()
     "Rank %d received ping %p from neighbor %d ",
      my_api_->rank(), this, dst_);
   arrived_ = true;
+  if (!failed_){
+    //back on the wheel if we were overdue, renewed once the timeout is up
+    wheel_->schedule(this, start_time_ + timeout_);
+  }
 }
 
 void
@@ -77,7 +88,8 @@ pinger::execute()
   }
   else {
     failed_ = true;
-    my_api_->declare_failed(dst_);
+    wheel_->cancel(this);
+    my_api_->failure_detected(dst_);
     //while (!functions_.empty()){
       debug_printf(sumi_ping,
         "Rank %d timing out ping %p to neighbor %d for refcount=%d ",
@@ -134,6 +146,7 @@ void
 pinger::wait()
 {
   arrived_ = false;
+  wheel_->schedule(this, start_time_ + timeout_);
   my_api_->schedule_ping_timeout(this, timeout_);
 }
 
@@ -144,13 +157,25 @@ pinger::start()
   schedule_next();
 }
 
+ping_monitor::~ping_monitor()
+{
+  if (wheel_) delete wheel_;
+}
+
 void
 ping_monitor::renew_pings(double wtime)
 {
-  std::map<int, pinger*>::iterator it, end = pingers_.end();
-  for (it=pingers_.begin(); it != end; ++it){
-    pinger* p = it->second;
-    p->maybe_renew(wtime);
+  timer_wheel::entry_list expired;
+  wheel_->advance(wtime, expired);
+  int nexpired = expired.size();
+  for (int i=0; i < nexpired; ++i){
+    pinger* p = static_cast<pinger*>(expired[i]);
+    if (p->has_arrived()){
+      p->maybe_renew(wtime);
+    } else {
+      //still waiting - only arrival or validation can move this along
+      wheel_->park(p);
+    }
   }
 }
 
@@ -158,15 +183,16 @@ void
 ping_monitor::validate_all_pings()
 {
   double wtime = api_->wall_time();
-  std::map<int, pinger*>::iterator it, end = pingers_.end();
-  for (it=pingers_.begin(); it != end; ++it){
-    pinger* p = it->second;
-    if (p->is_expired(wtime)){
-      debug_printf(sumi_ping,
-        "Rank %d expiring ping %p at t=%8.4e after too long delay from t=%8.4e",
-        api_->rank(), p, wtime, p->start_time());
-      p->execute();
-    }
+  timer_wheel::entry_list expired;
+  wheel_->advance(wtime, expired);
+  wheel_->collect_parked(expired);
+  int nexpired = expired.size();
+  for (int i=0; i < nexpired; ++i){
+    pinger* p = static_cast<pinger*>(expired[i]);
+    debug_printf(sumi_ping,
+      "Rank %d expiring ping %p at t=%8.4e after too long delay from t=%8.4e",
+      api_->rank(), p, wtime, p->start_time());
+    p->execute();
   }
 }
 
@@ -203,6 +229,7 @@ ping_monitor::message_received(const message::ptr& msg)
     // oh snap, he's dooooowwwwnnnn
     // call the timeout a little early
     my_ping->execute();
+    wheel_->cancel(my_ping);
     pingers_.erase(ping_partner);
   }
   else {
@@ -212,6 +239,7 @@ ping_monitor::message_received(const message::ptr& msg)
         (my_ping->refcount() ? "refcount pending, not erasing" : "refcount 0, erasing ping"));
     my_ping->arrived();
     if (my_ping->refcount() == 0){
+      wheel_->cancel(my_ping);
       pingers_.erase(ping_partner);
     }
   }
@@ -221,6 +249,9 @@ void
 ping_monitor::init_factory_params(sprockit::sim_parameters* params)
 {
   timeout_ = params->get_optional_time_param("ping_timeout", 1e-3);
+  //by default, the lowest level of the wheel spans one timeout
+  double tick = params->get_optional_time_param("ping_wheel_tick", timeout_ / 64);
+  wheel_ = new timer_wheel(tick);
   activity_monitor::init_factory_params(params);
 }
 
@@ -250,7 +281,7 @@ ping_monitor::ping(int dst, timeout_function* func)
     debug_printf(sumi_ping,
         "Rank %d totally new ping to neighbor %d for function %p",
         api_->rank(), dst, func);
-    my_ping = new pinger(api_, dst, timeout_); //just do a ms for now
+    my_ping = new pinger(api_, dst, timeout_, wheel_); //just do a ms for now
     my_ping->start();
   }
   else if (my_ping->refcount() == 0){ //nobody is waiting on this anymore, but still waiting for last ping
@@ -262,7 +293,9 @@ ping_monitor::ping(int dst, timeout_function* func)
     debug_printf(sumi_ping,
         "Rank %d waiting anew on ping to neighbor %d for function %p",
         api_->rank(), dst, func);
-    my_ping = new pinger(api_, dst, timeout_); //just do a ms for now
+    //the old pinger is orphaned, stop renewing it
+    wheel_->cancel(my_ping);
+    my_ping = new pinger(api_, dst, timeout_, wheel_); //just do a ms for now
     my_ping->wait();
   }
   else if (my_ping->has_failed()){
@@ -297,6 +330,7 @@ ping_monitor::cancel_ping(int dst, timeout_function* func)
     debug_printf(sumi_ping,
         "Rank %d erasing ping to neighbor %d for function %p ",
         api_->rank(), dst, func);
+    wheel_->cancel(my_ping);
     pingers_.erase(dst);
   }
   else {
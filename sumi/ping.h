@@ -4,6 +4,7 @@
 #include <sumi/monitor.h>
 #include <sumi/transport_fwd.h>
 #include <sumi/timeout.h>
+#include <sumi/timer_wheel.h>
 
 namespace sumi {
 
@@ -13,8 +14,10 @@ namespace sumi {
  * so that you're never sending out more than one ping.
  * Multiple ping requests to the same machine all get
  * funneled into the same ping.
+ * Its deadline on the monitor's timer wheel is start_time() + timeout.
  */
-class pinger
+class pinger :
+  public timer_wheel::entry
 {
  public:
   std::string
@@ -24,7 +27,7 @@ class pinger
 
   ~pinger();
 
-  pinger(transport* api, int dst, double timeout);
+  pinger(transport* api, int dst, double timeout, timer_wheel* wheel);
 
   void
   execute();
@@ -109,6 +112,7 @@ class pinger
   function_set functions_;
 
   transport* my_api_;
+  timer_wheel* wheel_;
   int dst_;
   double timeout_;
   double start_time_;
@@ -126,6 +130,10 @@ class ping_monitor :
     return "interval monitor";
   }
 
+  ping_monitor() : wheel_(0) {}
+
+  virtual ~ping_monitor();
+
   virtual void
   init_factory_params(sprockit::sim_parameters* params);
 
@@ -160,6 +168,14 @@ class ping_monitor :
    */
   std::map<int, pinger*> pingers_;
 
+  /**
+   * @brief wheel_
+   * Every live pinger ordered by when it next needs attention.
+   * Pingers past their deadline that are still waiting on
+   * an answer are parked until they arrive or get validated.
+   */
+  timer_wheel* wheel_;
+
   double timeout_;
 };
 
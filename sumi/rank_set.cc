@@ -0,0 +1,204 @@
+#include <sumi/rank_set.h>
+#include <sprockit/serializer.h>
+#include <sstream>
+#include <algorithm>
+
+namespace sumi {
+
+rank_set::const_iterator::const_iterator(const std::vector<int>* runs, size_t idx) :
+  runs_(runs), idx_(idx)
+{
+  rank_ = idx_ < runs_->size() ? (*runs_)[idx_] : 0;
+}
+
+rank_set::const_iterator&
+rank_set::const_iterator::operator++()
+{
+  ++rank_;
+  if (rank_ == (*runs_)[idx_+1]){
+    //move on to the next run
+    idx_ += 2;
+    rank_ = idx_ < runs_->size() ? (*runs_)[idx_] : 0;
+  }
+  return *this;
+}
+
+int
+rank_set::lower_run(int rank) const
+{
+  int lo = 0, hi = num_runs();
+  while (lo < hi){
+    int mid = (lo + hi) / 2;
+    if (stop(mid) > rank){
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return lo;
+}
+
+rank_set::size_type
+rank_set::count(int rank) const
+{
+  int run = lower_run(rank);
+  return run < num_runs() && start(run) <= rank;
+}
+
+int
+rank_set::insert_range(int first, int last)
+{
+  if (first >= last){
+    return 0;
+  }
+
+  //runs that overlap or touch [first,last) get merged into one
+  int nruns = num_runs();
+  int merge_start = lower_run(first-1);
+  int merge_stop = merge_start;
+  int covered = 0;
+  while (merge_stop < nruns && start(merge_stop) <= last){
+    covered += stop(merge_stop) - start(merge_stop);
+    ++merge_stop;
+  }
+
+  if (merge_start == merge_stop){
+    int pos = 2*merge_start;
+    runs_.insert(runs_.begin() + pos, 2, first);
+    runs_[pos+1] = last;
+    size_ += last - first;
+    return last - first;
+  }
+
+  int new_start = std::min(first, start(merge_start));
+  int new_stop = std::max(last, stop(merge_stop-1));
+  int added = (new_stop - new_start) - covered;
+  runs_[2*merge_start] = new_start;
+  runs_[2*merge_start+1] = new_stop;
+  runs_.erase(runs_.begin() + 2*(merge_start+1), runs_.begin() + 2*merge_stop);
+  size_ += added;
+  return added;
+}
+
+rank_set::size_type
+rank_set::erase(int rank)
+{
+  int run = lower_run(rank);
+  if (run == num_runs() || start(run) > rank){
+    return 0;
+  }
+
+  int pos = 2*run;
+  if (start(run) == rank && stop(run) == rank + 1){
+    runs_.erase(runs_.begin() + pos, runs_.begin() + pos + 2);
+  } else if (start(run) == rank){
+    ++runs_[pos];
+  } else if (stop(run) == rank + 1){
+    --runs_[pos+1];
+  } else {
+    //split the run around the rank
+    int old_stop = stop(run);
+    runs_[pos+1] = rank;
+    runs_.insert(runs_.begin() + pos + 2, 2, rank + 1);
+    runs_[pos+3] = old_stop;
+  }
+  --size_;
+  return 1;
+}
+
+static void
+append_run(std::vector<int>& runs, int start, int stop)
+{
+  if (!runs.empty() && start <= runs.back()){
+    //overlaps or touches the last run
+    if (stop > runs.back()) runs.back() = stop;
+  } else {
+    runs.push_back(start);
+    runs.push_back(stop);
+  }
+}
+
+void
+rank_set::insert_all(const rank_set& other)
+{
+  if (&other == this || other.empty()){
+    return;
+  }
+
+  std::vector<int> merged;
+  merged.reserve(runs_.size() + other.runs_.size());
+  int i = 0, j = 0;
+  int ni = num_runs(), nj = other.num_runs();
+  while (i < ni || j < nj){
+    if (j == nj || (i < ni && start(i) < other.start(j))){
+      append_run(merged, start(i), stop(i));
+      ++i;
+    } else {
+      append_run(merged, other.start(j), other.stop(j));
+      ++j;
+    }
+  }
+
+  runs_.swap(merged);
+  size_ = 0;
+  for (int r=0; r < num_runs(); ++r){
+    size_ += stop(r) - start(r);
+  }
+}
+
+void
+set_difference(const rank_set& base, const rank_set& subtract, rank_set& result)
+{
+  rank_set diff;
+  int j = 0;
+  int nj = subtract.num_runs();
+  for (int i=0; i < base.num_runs(); ++i){
+    int lo = base.start(i);
+    int hi = base.stop(i);
+    //skip runs entirely before this one
+    while (j < nj && subtract.stop(j) <= lo){
+      ++j;
+    }
+    int k = j;
+    while (k < nj && subtract.start(k) < hi){
+      if (subtract.start(k) > lo){
+        diff.runs_.push_back(lo);
+        diff.runs_.push_back(subtract.start(k));
+        diff.size_ += subtract.start(k) - lo;
+      }
+      lo = std::max(lo, subtract.stop(k));
+      ++k;
+    }
+    if (lo < hi){
+      diff.runs_.push_back(lo);
+      diff.runs_.push_back(hi);
+      diff.size_ += hi - lo;
+    }
+  }
+  result.runs_.swap(diff.runs_);
+  result.size_ = diff.size_;
+}
+
+std::string
+rank_set::to_string() const
+{
+  std::stringstream sstr;
+  sstr << "{";
+  for (int r=0; r < num_runs(); ++r){
+    sstr << " " << start(r);
+    if (stop(r) - start(r) > 1){
+      sstr << "-" << stop(r) - 1;
+    }
+  }
+  sstr << " }";
+  return sstr.str();
+}
+
+void
+rank_set::serialize_order(sprockit::serializer& ser)
+{
+  ser & runs_;
+  ser & size_;
+}
+
+}
@@ -0,0 +1,233 @@
+#ifndef sumi_api_RANK_SET_H
+#define sumi_api_RANK_SET_H
+
+#include <sprockit/serializer_fwd.h>
+#include <vector>
+#include <set>
+#include <string>
+#include <cstddef>
+#include <iterator>
+
+namespace sumi {
+
+/**
+ * @class rank_set
+ * Set of ranks stored as sorted, disjoint runs [start,stop).
+ * Failures tend to be correlated (a rack, a switch), so a few runs
+ * cover a large number of ranks. Union and difference walk the runs
+ * in linear time and serialization packs the runs, not the ranks.
+ * The iteration API mirrors thread_safe_set so either can be used
+ * for sets of failed ranks. A rank_set takes no lock, sets shared
+ * between threads belong in a thread_safe_rank_set.
+ */
+class rank_set;
+
+void
+set_difference(const rank_set& base, const rank_set& subtract, rank_set& result);
+
+class rank_set
+{
+  friend void set_difference(const rank_set& base,
+                             const rank_set& subtract, rank_set& result);
+
+ public:
+  typedef size_t size_type;
+
+  /**
+   * @class const_iterator
+   * Walks every rank in ascending order
+   */
+  class const_iterator
+  {
+    friend class rank_set;
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef int value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const int* pointer;
+    typedef int reference;
+
+    const_iterator() : runs_(0), idx_(0), rank_(0) {}
+
+    int
+    operator*() const {
+      return rank_;
+    }
+
+    const_iterator&
+    operator++();
+
+    bool
+    operator==(const const_iterator& rhs) const {
+      return idx_ == rhs.idx_ && rank_ == rhs.rank_;
+    }
+
+    bool
+    operator!=(const const_iterator& rhs) const {
+      return !(*this == rhs);
+    }
+
+   private:
+    const_iterator(const std::vector<int>* runs, size_t idx);
+
+    const std::vector<int>* runs_;
+    size_t idx_;
+    int rank_;
+  };
+
+  typedef const_iterator iterator;
+
+  rank_set() : size_(0) {}
+
+  rank_set(const std::set<int>& ranks) : size_(0) {
+    insert(ranks.begin(), ranks.end());
+  }
+
+  const_iterator
+  begin() const {
+    return const_iterator(&runs_, 0);
+  }
+
+  const_iterator
+  end() const {
+    return const_iterator(&runs_, runs_.size());
+  }
+
+  /**
+   * For drop-in compatibility with thread_safe_set, but nothing is locked.
+   * @return The end iterator
+   */
+  const_iterator
+  start_iteration() const {
+    return end();
+  }
+
+  void
+  end_iteration() const {}
+
+  bool
+  empty() const {
+    return size_ == 0;
+  }
+
+  size_type
+  size() const {
+    return size_;
+  }
+
+  /**
+   * @return The number of runs needed to store the set
+   */
+  int
+  num_runs() const {
+    return runs_.size() / 2;
+  }
+
+  size_type
+  count(int rank) const;
+
+  /**
+   * @return Whether the rank was not already present
+   */
+  bool
+  insert(int rank){
+    return insert_range(rank, rank+1) > 0;
+  }
+
+  /**
+   * Add every rank in [start,stop)
+   * @return The number of ranks that were not already present
+   */
+  int
+  insert_range(int start, int stop);
+
+  template <class InputIterator>
+  void
+  insert(InputIterator first, InputIterator last){
+    for ( ; first != last; ++first){
+      insert(*first);
+    }
+  }
+
+  /** Union with another set */
+  void
+  insert_all(const rank_set& other);
+
+  void
+  insert_all(const std::set<int>& other){
+    insert(other.begin(), other.end());
+  }
+
+  size_type
+  erase(int rank);
+
+  void
+  clear(){
+    runs_.clear();
+    size_ = 0;
+  }
+
+  std::set<int>
+  get_copy() const {
+    return std::set<int>(begin(), end());
+  }
+
+  bool
+  operator==(const rank_set& rhs) const {
+    return runs_ == rhs.runs_;
+  }
+
+  bool
+  operator!=(const rank_set& rhs) const {
+    return runs_ != rhs.runs_;
+  }
+
+  /**
+   * @return The set as runs, e.g. { 3 8-15 }
+   */
+  std::string
+  to_string() const;
+
+  void
+  serialize_order(sprockit::serializer& ser);
+
+  /**
+   * @return The first rank of a run, for walking the set run by run
+   */
+  int
+  start(int run) const {
+    return runs_[2*run];
+  }
+
+  /**
+   * @return One past the last rank of a run
+   */
+  int
+  stop(int run) const {
+    return runs_[2*run+1];
+  }
+
+ private:
+  /**
+   * @return The first run whose stop is after the rank
+   */
+  int
+  lower_run(int rank) const;
+
+  /** Flattened (start,stop) pairs, sorted, never overlapping or touching */
+  std::vector<int> runs_;
+
+  int size_;
+
+};
+
+/**
+ * Compute base - subtract by walking both sets of runs
+ * @param result [out] Overwritten with the difference
+ */
+void
+set_difference(const rank_set& base, const rank_set& subtract, rank_set& result);
+
+}
+
+#endif // sumi_api_RANK_SET_H
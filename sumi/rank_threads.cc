@@ -0,0 +1,89 @@
+#include <sumi/rank_threads.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <exception>
+#include <vector>
+
+namespace sumi {
+
+static void
+run_rank(void (*main_fxn)())
+{
+  try {
+    main_fxn();
+  } catch (std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    abort();
+  }
+}
+
+static void*
+run_rank_thread(void* args)
+{
+  run_rank((void (*)()) args);
+  return 0;
+}
+
+void
+run_rank_threads(void (*main_fxn)())
+{
+  const char* nthread_str = getenv("SUMI_THREAD_NPROC");
+  if (!nthread_str){
+    run_rank(main_fxn);
+    return;
+  }
+
+  int nthread = atoi(nthread_str);
+  std::vector<pthread_t> threads(nthread);
+  for (int i=0; i < nthread; ++i){
+    pthread_create(&threads[i], 0, run_rank_thread, (void*) main_fxn);
+  }
+  for (int i=0; i < nthread; ++i){
+    pthread_join(threads[i], 0);
+  }
+}
+
+int
+run_rank_procs(int nproc, void (*main_fxn)(int rank, int nproc))
+{
+  //nothing buffered may be written twice by the children
+  fflush(stdout);
+  fflush(stderr);
+
+  std::vector<pid_t> pids(nproc);
+  for (int i=0; i < nproc; ++i){
+    pids[i] = fork();
+    if (pids[i] == 0){
+      int rc = 0;
+      try {
+        main_fxn(i, nproc);
+      } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        rc = 1;
+      }
+      fflush(stdout);
+      _exit(rc);
+    } else if (pids[i] < 0){
+      perror("run_rank_procs: fork");
+      abort();
+    }
+  }
+
+  int num_failed = 0;
+  for (int i=0; i < nproc; ++i){
+    int status;
+    if (waitpid(pids[i], &status, 0) != pids[i]
+      || !WIFEXITED(status) || WEXITSTATUS(status) != 0){
+      std::cerr << "rank " << i << " failed" << std::endl;
+      ++num_failed;
+    }
+  }
+  return num_failed;
+}
+
+}
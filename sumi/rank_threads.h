@@ -0,0 +1,29 @@
+#ifndef sumi_api_RANK_THREADS_H
+#define sumi_api_RANK_THREADS_H
+
+namespace sumi {
+
+/**
+ * Run the body of a test or benchmark for every rank in this process.
+ * If SUMI_THREAD_NPROC is set, ranks are threads and each one runs
+ * main_fxn, building its own transport. Otherwise main_fxn runs once.
+ * An exception escaping main_fxn is printed and aborts the process.
+ * @param main_fxn  The rank body
+ */
+void
+run_rank_threads(void (*main_fxn)());
+
+/**
+ * Run the body of a test for nproc ranks as processes forked on this host,
+ * for transports whose ranks must live in separate processes.
+ * An exception escaping main_fxn is printed and fails the rank.
+ * @param nproc
+ * @param main_fxn  The rank body, given its rank and nproc
+ * @return The number of ranks that crashed or failed
+ */
+int
+run_rank_procs(int nproc, void (*main_fxn)(int rank, int nproc));
+
+}
+
+#endif
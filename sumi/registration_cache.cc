@@ -0,0 +1,193 @@
+#include <sumi/registration_cache.h>
+#include <sprockit/errors.h>
+
+namespace sumi {
+
+registration_cache::registration_cache(long max_bytes) :
+  max_bytes_(max_bytes),
+  max_region_size_(0),
+  registered_bytes_(0),
+  hits_(0),
+  misses_(0),
+  evictions_(0)
+{
+}
+
+registration_cache::~registration_cache()
+{
+  region_map::iterator it, end = regions_.end();
+  for (it=regions_.begin(); it != end; ++it){
+    delete it->second;
+  }
+  std::list<region*>::iterator sit, send = stale_.end();
+  for (sit=stale_.begin(); sit != send; ++sit){
+    delete *sit;
+  }
+}
+
+registration_cache::region*
+registration_cache::find(uintptr_t start, long size, bool in_use)
+{
+  uintptr_t stop = start + size;
+  region_map::iterator it = regions_.upper_bound(start);
+  while (it != regions_.begin()){
+    --it;
+    region* reg = it->second;
+    if (reg->start + max_region_size_ < stop){
+      //nothing further back can possibly reach
+      break;
+    }
+    if ((reg->start + reg->size) >= stop && (!in_use || reg->refcount > 0)){
+      return reg;
+    }
+  }
+  return 0;
+}
+
+registration_cache::region*
+registration_cache::find_stale(uintptr_t start, long size)
+{
+  uintptr_t stop = start + size;
+  std::list<region*>::iterator it, end = stale_.end();
+  for (it=stale_.begin(); it != end; ++it){
+    region* reg = *it;
+    if (reg->start <= start && (reg->start + reg->size) >= stop){
+      return reg;
+    }
+  }
+  return 0;
+}
+
+bool
+registration_cache::acquire(void* buf, long size, public_buffer& pbuf)
+{
+  region* reg = find((uintptr_t) buf, size, false);
+  if (!reg){
+    ++misses_;
+    return false;
+  }
+
+  ++hits_;
+  if (reg->refcount == 0){
+    unused_.erase(reg->lru);
+  }
+  ++reg->refcount;
+  pbuf = reg->buf;
+  pbuf.ptr = buf;
+  return true;
+}
+
+void
+registration_cache::insert(void* buf, long size, const public_buffer& pbuf,
+                           registration_list& evicted)
+{
+  region* reg = new region;
+  reg->start = (uintptr_t) buf;
+  reg->size = size;
+  reg->buf = pbuf;
+  reg->refcount = 1;
+  reg->stale = false;
+  reg->pos = regions_.insert(std::make_pair(reg->start, reg));
+  registered_bytes_ += size;
+  if (size > max_region_size_){
+    max_region_size_ = size;
+  }
+
+  while (registered_bytes_ > max_bytes_ && !unused_.empty()){
+    ++evictions_;
+    remove(unused_.back(), evicted);
+  }
+}
+
+void
+registration_cache::release(void* buf, long size, registration_list& dropped)
+{
+  //a holder from before an invalidate is releasing memory that is going away,
+  //so stale regions are matched first
+  region* reg = find_stale((uintptr_t) buf, size);
+  if (!reg){
+    reg = find((uintptr_t) buf, size, true);
+  }
+  if (!reg){
+    spkt_throw_printf(sprockit::value_error,
+      "registration_cache::release: buffer %p of size %ld was never acquired",
+      buf, size);
+  }
+
+  --reg->refcount;
+  if (reg->refcount == 0){
+    if (reg->stale){
+      stale_.erase(reg->lru);
+      drop(reg, dropped);
+    } else {
+      unused_.push_front(reg);
+      reg->lru = unused_.begin();
+    }
+  }
+}
+
+void
+registration_cache::drop(region* reg, registration_list& dropped)
+{
+  registered_bytes_ -= reg->size;
+  registration r;
+  r.buf = reg->buf;
+  r.size = reg->size;
+  dropped.push_back(r);
+  delete reg;
+}
+
+void
+registration_cache::remove(region* reg, registration_list& dropped)
+{
+  if (reg->refcount == 0){
+    unused_.erase(reg->lru);
+  }
+  regions_.erase(reg->pos);
+  drop(reg, dropped);
+}
+
+void
+registration_cache::invalidate(void* buf, long size, registration_list& dropped)
+{
+  uintptr_t start = (uintptr_t) buf;
+  uintptr_t stop = start + size;
+  uintptr_t search_start = start > uintptr_t(max_region_size_) ? start - max_region_size_ : 0;
+
+  std::list<region*> overlaps;
+  region_map::iterator it = regions_.lower_bound(search_start), end = regions_.end();
+  for ( ; it != end && it->first < stop; ++it){
+    region* reg = it->second;
+    if ((reg->start + reg->size) > start){
+      overlaps.push_back(reg);
+    }
+  }
+
+  std::list<region*>::iterator rit, rend = overlaps.end();
+  for (rit=overlaps.begin(); rit != rend; ++rit){
+    region* reg = *rit;
+    if (reg->refcount == 0){
+      remove(reg, dropped);
+    } else {
+      //still held - unregistering now would pull it out from under the holder
+      regions_.erase(reg->pos);
+      reg->stale = true;
+      stale_.push_front(reg);
+      reg->lru = stale_.begin();
+    }
+  }
+}
+
+void
+registration_cache::clear(registration_list& dropped)
+{
+  while (!regions_.empty()){
+    remove(regions_.begin()->second, dropped);
+  }
+  while (!stale_.empty()){
+    drop(stale_.front(), dropped);
+    stale_.pop_front();
+  }
+}
+
+}
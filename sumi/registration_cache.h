@@ -0,0 +1,171 @@
+#ifndef sumi_api_REGISTRATION_CACHE_H
+#define sumi_api_REGISTRATION_CACHE_H
+
+#include <sumi/rdma.h>
+#include <map>
+#include <list>
+#include <stdint.h>
+
+namespace sumi {
+
+/**
+ * @class registration_cache
+ * Keeps transport registrations (pinned, NIC-visible regions) alive after
+ * a buffer is unmade public so that collectives repeatedly run on the same
+ * user buffers skip registration entirely.
+ * Regions are kept sorted by start address. Regions can overlap, so a lookup
+ * walks back from the address no further than the longest region ever held,
+ * i.e. a simple interval stabbing query.
+ * Regions no longer in use are evicted least-recently-used first
+ * once the total registered size goes over the cap.
+ *
+ * WARNING: the cache only knows virtual addresses. It cannot tell when
+ * memory is freed and the same addresses handed out again by malloc,
+ * in which case a stale registration of the old pages would be reused.
+ * Anyone freeing or unmapping memory that was ever made public must
+ * call #invalidate (transport::invalidate_public_buffers) first.
+ */
+class registration_cache
+{
+ public:
+  struct registration {
+    public_buffer buf;
+    long size;
+  };
+
+  typedef std::list<registration> registration_list;
+
+  registration_cache(long max_bytes);
+
+  ~registration_cache();
+
+  /**
+   * @brief acquire
+   * @param buf   The start of the region to make public
+   * @param size  The size of the region in bytes
+   * @param pbuf  [out] On a hit, the registered buffer pointing at buf
+   * @return Whether an existing registration covers the region.
+   *         On a hit, a reference is taken that must be given back with #release
+   */
+  bool
+  acquire(void* buf, long size, public_buffer& pbuf);
+
+  /**
+   * @brief insert  Add a freshly registered region, holding one reference
+   * @param buf
+   * @param size
+   * @param pbuf    The registration returned by the transport
+   * @param evicted [out] Unused registrations dropped to stay under the cap.
+   *                The caller is responsible for unregistering these.
+   */
+  void
+  insert(void* buf, long size, const public_buffer& pbuf, registration_list& evicted);
+
+  /**
+   * @brief release Give back a reference taken by #acquire or #insert.
+   *        The registration stays cached unless it was invalidated.
+   * @param dropped [out] An invalidated registration whose last reference
+   *                this was. The caller is responsible for unregistering it.
+   */
+  void
+  release(void* buf, long size, registration_list& dropped);
+
+  /**
+   * @brief invalidate  Drop every registration overlapping the region,
+   *        e.g. because the memory is being freed. Registrations still
+   *        holding references are no longer handed out, but stay
+   *        registered until their last #release.
+   * @param dropped [out] The caller is responsible for unregistering these
+   */
+  void
+  invalidate(void* buf, long size, registration_list& dropped);
+
+  void
+  clear(registration_list& dropped);
+
+  long
+  hits() const {
+    return hits_;
+  }
+
+  long
+  misses() const {
+    return misses_;
+  }
+
+  long
+  evictions() const {
+    return evictions_;
+  }
+
+  long
+  registered_bytes() const {
+    return registered_bytes_;
+  }
+
+  int
+  num_regions() const {
+    return regions_.size();
+  }
+
+ private:
+  struct region;
+  typedef std::multimap<uintptr_t, region*> region_map;
+
+  struct region {
+    uintptr_t start;
+    long size;
+    public_buffer buf;
+    int refcount;
+    /** Invalidated while in use, dropped on the last release */
+    bool stale;
+    region_map::iterator pos;
+    /** Position in #unused_, or in #stale_ once invalidated */
+    std::list<region*>::iterator lru;
+  };
+
+  /**
+   * @param in_use  Only match regions currently holding references
+   */
+  region*
+  find(uintptr_t start, long size, bool in_use);
+
+  /**
+   * @return An invalidated region still in use that covers the range
+   */
+  region*
+  find_stale(uintptr_t start, long size);
+
+  void
+  remove(region* reg, registration_list& dropped);
+
+  void
+  drop(region* reg, registration_list& dropped);
+
+ private:
+  region_map regions_;
+
+  /** Regions with no references, most recently released at the front */
+  std::list<region*> unused_;
+
+  /** Invalidated regions waiting on their last release */
+  std::list<region*> stale_;
+
+  long max_bytes_;
+
+  /** Never shrinks - only bounds how far back a lookup must search */
+  long max_region_size_;
+
+  long registered_bytes_;
+
+  long hits_;
+
+  long misses_;
+
+  long evictions_;
+
+};
+
+}
+
+#endif // REGISTRATION_CACHE_H
@@ -0,0 +1,472 @@
+#include <sumi/swim.h>
+#include <sumi/transport.h>
+#include <sprockit/serializer.h>
+#include <sprockit/sim_parameters.h>
+#include <sprockit/keyword_registration.h>
+#include <sprockit/util.h>
+#include <stdlib.h>
+#include <cmath>
+#include <set>
+
+using namespace sprockit::dbg;
+
+RegisterKeywords(
+  "swim_period",
+  "swim_probe_timeout",
+  "swim_indirect_probes",
+  "swim_suspicion_mult",
+  "swim_retransmit_mult",
+  "swim_max_piggyback",
+  "swim_seed"
+);
+
+DeclareSerializable(sumi::swim_message);
+
+namespace sumi {
+
+SpktRegister("swim", activity_monitor, swim_monitor,
+  "Detect failures with randomized direct and indirect probes, disseminating membership by gossip");
+
+#define enumcase(x) case x: return #x
+
+const char*
+swim_message::tostr(type_t ty)
+{
+  switch(ty)
+  {
+  enumcase(probe);
+  enumcase(ack);
+  enumcase(probe_request);
+  }
+  spkt_throw_printf(sprockit::value_error,
+    "swim_message: unknown type %d", ty);
+}
+
+const char*
+swim_message::tostr(state_t state)
+{
+  switch(state)
+  {
+  enumcase(alive);
+  enumcase(suspect);
+  enumcase(dead);
+  }
+  spkt_throw_printf(sprockit::value_error,
+    "swim_message: unknown state %d", state);
+}
+
+void
+swim_message::serialize_order(sprockit::serializer& ser)
+{
+  ser & type_;
+  ser & subject_;
+  ser & seqnum_;
+  ser & updates_;
+  message::serialize_order(ser);
+}
+
+swim_monitor::swim_monitor() :
+  probe_idx_(0),
+  me_(-1),
+  nproc_(-1),
+  seqnum_(0),
+  incarnation_(0),
+  seed_(0),
+  probe_target_(-1),
+  probe_seqnum_(-1),
+  probe_acked_(false),
+  indirect_sent_(false),
+  period_start_(-1)
+{
+}
+
+void
+swim_monitor::init_factory_params(sprockit::sim_parameters* params)
+{
+  period_ = params->get_optional_time_param("swim_period", 5e-3);
+  probe_timeout_ = params->get_optional_time_param("swim_probe_timeout", period_ / 3);
+  num_indirect_ = params->get_optional_int_param("swim_indirect_probes", 3);
+  suspect_mult_ = params->get_optional_int_param("swim_suspicion_mult", 3);
+  retransmit_mult_ = params->get_optional_int_param("swim_retransmit_mult", 3);
+  max_piggyback_ = params->get_optional_int_param("swim_max_piggyback", 8);
+  seed_ = params->get_optional_int_param("swim_seed", 0);
+  if (probe_timeout_ >= period_){
+    spkt_throw_printf(sprockit::value_error,
+      "swim_monitor: probe timeout %8.4e must be shorter than the period %8.4e",
+      probe_timeout_, period_);
+  }
+  activity_monitor::init_factory_params(params);
+}
+
+int
+swim_monitor::random_int(int max)
+{
+  return rand_r(&seed_) % max;
+}
+
+void
+swim_monitor::shuffle_probe_order()
+{
+  for (int i=probe_order_.size() - 1; i > 0; --i){
+    int j = random_int(i + 1);
+    std::swap(probe_order_[i], probe_order_[j]);
+  }
+  probe_idx_ = 0;
+}
+
+void
+swim_monitor::init_members()
+{
+  //rank and nproc are not known yet when the monitor is built
+  me_ = api_->rank();
+  nproc_ = api_->nproc();
+  seed_ = seed_ * 7919 + me_ + 1;
+
+  member m;
+  m.state = swim_message::alive;
+  m.incarnation = 0;
+  m.suspect_deadline = 0;
+  members_.resize(nproc_, m);
+  for (int i=0; i < nproc_; ++i){
+    if (api_->is_failed(i)){
+      members_[i].state = swim_message::dead;
+    } else if (i != me_){
+      probe_order_.push_back(i);
+    }
+  }
+  shuffle_probe_order();
+
+  //detection latency and dissemination both scale with log(n)
+  int log_nproc = std::ceil(std::log(double(nproc_ + 1)) / std::log(2.0));
+  suspect_timeout_ = suspect_mult_ * log_nproc * period_;
+  retransmit_limit_ = retransmit_mult_ * log_nproc;
+}
+
+int
+swim_monitor::next_probe_target()
+{
+  int num_members = probe_order_.size();
+  for (int tries=0; tries < num_members; ++tries){
+    if (probe_idx_ == num_members){
+      shuffle_probe_order();
+    }
+    int target = probe_order_[probe_idx_++];
+    if (members_[target].state != swim_message::dead){
+      return target;
+    }
+  }
+  return -1;
+}
+
+void
+swim_monitor::send(int dst, swim_message::type_t ty, int subject, int seqnum)
+{
+  swim_message::ptr msg = new swim_message(ty, subject, seqnum);
+  piggyback(msg);
+  debug_printf(sumi_ping,
+    "Rank %d sending swim %s about %d to %d with seqnum %d and %d updates",
+    me_, swim_message::tostr(ty), subject, dst, seqnum, msg->num_updates());
+  api_->send_header(dst, msg);
+}
+
+void
+swim_monitor::piggyback(const swim_message::ptr& msg)
+{
+  int num_added = 0;
+  std::list<update>::iterator it = updates_.begin();
+  while (it != updates_.end() && num_added < max_piggyback_){
+    msg->add_update(it->rank, it->state, it->incarnation);
+    ++num_added;
+    --it->sends_left;
+    if (it->sends_left == 0){
+      it = updates_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  //whatever went out this time waits behind updates that have not
+  updates_.splice(updates_.end(), updates_, updates_.begin(), it);
+}
+
+void
+swim_monitor::disseminate(int rank, swim_message::state_t state, int incarnation)
+{
+  std::list<update>::iterator it = updates_.begin();
+  while (it != updates_.end()){
+    if (it->rank == rank){
+      it = updates_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  update up;
+  up.rank = rank;
+  up.state = state;
+  up.incarnation = incarnation;
+  up.sends_left = retransmit_limit_;
+  updates_.push_front(up);
+}
+
+void
+swim_monitor::mark_suspect(int rank, int incarnation, double wtime)
+{
+  member& m = members_[rank];
+  debug_printf(sumi_ping | sumi_failure,
+    "Rank %d suspects %d at incarnation %d",
+    me_, rank, incarnation);
+  if (m.state != swim_message::suspect){
+    suspects_.push_back(rank);
+  }
+  m.state = swim_message::suspect;
+  m.incarnation = incarnation;
+  m.suspect_deadline = wtime + suspect_timeout_;
+  disseminate(rank, swim_message::suspect, incarnation);
+}
+
+void
+swim_monitor::mark_dead(int rank)
+{
+  member& m = members_[rank];
+  if (m.state == swim_message::dead){
+    return;
+  }
+
+  debug_printf(sumi_ping | sumi_failure,
+    "Rank %d declaring %d dead", me_, rank);
+
+  m.state = swim_message::dead;
+  disseminate(rank, swim_message::dead, m.incarnation);
+  api_->failure_detected(rank);
+
+  std::map<int, function_set>::iterator it = listeners_.find(rank);
+  if (it != listeners_.end()){
+    it->second.timeout_all_listeners(rank);
+  }
+}
+
+void
+swim_monitor::apply_update(int rank, swim_message::state_t state, int incarnation, double wtime)
+{
+  if (rank == me_){
+    if (state == swim_message::suspect && incarnation >= incarnation_){
+      //refute - a newer incarnation overrides the suspicion everywhere
+      incarnation_ = incarnation + 1;
+      disseminate(me_, swim_message::alive, incarnation_);
+    }
+    return;
+  }
+
+  member& m = members_[rank];
+  if (m.state == swim_message::dead){
+    return;
+  }
+
+  switch(state)
+  {
+  case swim_message::alive:
+    if (incarnation > m.incarnation){
+      m.state = swim_message::alive;
+      m.incarnation = incarnation;
+      disseminate(rank, swim_message::alive, incarnation);
+    }
+    break;
+  case swim_message::suspect:
+    if (incarnation > m.incarnation
+      || (incarnation == m.incarnation && m.state == swim_message::alive)){
+      mark_suspect(rank, incarnation, wtime);
+    }
+    break;
+  case swim_message::dead:
+    mark_dead(rank);
+    break;
+  }
+}
+
+void
+swim_monitor::check_suspects(double wtime)
+{
+  std::list<int>::iterator it = suspects_.begin();
+  while (it != suspects_.end()){
+    member& m = members_[*it];
+    if (m.state != swim_message::suspect){
+      //refuted or already dead
+      it = suspects_.erase(it);
+    } else if (m.suspect_deadline < wtime){
+      int rank = *it;
+      it = suspects_.erase(it);
+      mark_dead(rank);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void
+swim_monitor::send_indirect_probes()
+{
+  indirect_sent_ = true;
+  std::set<int> helpers;
+  int num_members = probe_order_.size();
+  int max_tries = 4*num_indirect_;
+  for (int tries=0; tries < max_tries && int(helpers.size()) < num_indirect_; ++tries){
+    int helper = probe_order_[random_int(num_members)];
+    if (helper != probe_target_
+      && members_[helper].state == swim_message::alive
+      && helpers.insert(helper).second){
+      send(helper, swim_message::probe_request, probe_target_, probe_seqnum_);
+    }
+  }
+}
+
+void
+swim_monitor::start_period(double wtime)
+{
+  if (probe_target_ >= 0 && !probe_acked_
+    && members_[probe_target_].state == swim_message::alive){
+    //silent for a whole period, even through other members
+    mark_suspect(probe_target_, members_[probe_target_].incarnation, wtime);
+  }
+
+  //relays that never got an answer will not get one now
+  std::map<int, relay>::iterator it = relays_.begin();
+  while (it != relays_.end()){
+    if (it->second.sent + period_ < wtime){
+      relays_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+
+  period_start_ = wtime;
+  probe_acked_ = false;
+  indirect_sent_ = false;
+  probe_target_ = next_probe_target();
+  if (probe_target_ < 0){
+    return;
+  }
+  probe_seqnum_ = seqnum_++;
+  send(probe_target_, swim_message::probe, probe_target_, probe_seqnum_);
+}
+
+void
+swim_monitor::renew_pings(double wtime)
+{
+  if (nproc_ < 0){
+    init_members();
+  }
+
+  check_suspects(wtime);
+
+  if (probe_target_ >= 0 && !probe_acked_ && !indirect_sent_
+    && (wtime - period_start_) >= probe_timeout_){
+    send_indirect_probes();
+  }
+
+  if (period_start_ < 0 || (wtime - period_start_) >= period_){
+    start_period(wtime);
+  }
+}
+
+void
+swim_monitor::message_received(const message::ptr& msg)
+{
+  if (nproc_ < 0){
+    init_members();
+  }
+
+  swim_message::ptr smsg = ptr_safe_cast(swim_message, msg);
+  int src = smsg->sender();
+  if (members_[src].state == swim_message::dead){
+    //we have already moved on without this rank
+    return;
+  }
+
+  double wtime = api_->wall_time();
+  int num_updates = smsg->num_updates();
+  for (int i=0; i < num_updates; ++i){
+    int rank, incarnation;
+    swim_message::state_t state;
+    smsg->get_update(i, rank, state, incarnation);
+    apply_update(rank, state, incarnation, wtime);
+  }
+
+  debug_printf(sumi_ping,
+    "Rank %d got swim %s about %d from %d with seqnum %d",
+    me_, swim_message::tostr(smsg->type()), smsg->subject(), src, smsg->seqnum());
+
+  switch(smsg->type())
+  {
+  case swim_message::probe:
+    send(src, swim_message::ack, smsg->subject(), smsg->seqnum());
+    break;
+  case swim_message::probe_request: {
+    relay r;
+    r.origin = src;
+    r.seqnum = smsg->seqnum();
+    r.sent = wtime;
+    int seqnum = seqnum_++;
+    relays_[seqnum] = r;
+    send(smsg->subject(), swim_message::probe, smsg->subject(), seqnum);
+    break;
+  }
+  case swim_message::ack: {
+    std::map<int, relay>::iterator it = relays_.find(smsg->seqnum());
+    if (it != relays_.end()){
+      //an answer to a probe I did on someone else's behalf
+      send(it->second.origin, swim_message::ack, smsg->subject(), it->second.seqnum);
+      relays_.erase(it);
+    } else if (smsg->subject() == probe_target_ && smsg->seqnum() == probe_seqnum_){
+      probe_acked_ = true;
+    }
+    break;
+  }
+  }
+}
+
+void
+swim_monitor::ping(int dst, timeout_function* func)
+{
+  if (nproc_ < 0){
+    init_members();
+  }
+
+  debug_printf(sumi_ping,
+    "Rank %d watching %d for function %p", me_, dst, func);
+  listeners_[dst].append(func);
+}
+
+void
+swim_monitor::cancel_ping(int dst, timeout_function* func)
+{
+  std::map<int, function_set>::iterator it = listeners_.find(dst);
+  if (it == listeners_.end()){
+    spkt_throw_printf(sprockit::value_error,
+      "swim_monitor::cancel_ping: not watching neighbor %d",
+       dst);
+  }
+  if (it->second.erase(func) == 0){
+    listeners_.erase(it);
+  }
+}
+
+void
+swim_monitor::validate_done()
+{
+  std::map<int, function_set>::iterator it, end = listeners_.end();
+  for (it=listeners_.begin(); it != end; ++it){
+    if (it->second.refcount() != 0){
+      spkt_throw_printf(sprockit::illformed_error,
+        "rank %d still watching %d with refcount %d",
+        me_, it->first, it->second.refcount());
+    }
+  }
+}
+
+void
+swim_monitor::validate_all_pings()
+{
+  renew_pings(api_->wall_time());
+}
+
+}
@@ -0,0 +1,307 @@
+#ifndef sumi_api_SWIM_H
+#define sumi_api_SWIM_H
+
+#include <sumi/monitor.h>
+#include <sumi/message.h>
+#include <vector>
+#include <list>
+#include <map>
+
+namespace sumi {
+
+/**
+ * @class swim_message
+ * Probe traffic for the SWIM monitor. Every message also carries
+ * a handful of piggybacked membership updates.
+ */
+class swim_message :
+  public message,
+  public sprockit::serializable_type<swim_message>
+{
+  ImplementSerializable(swim_message)
+
+ public:
+  typedef sprockit::refcount_ptr<swim_message> ptr;
+
+  typedef enum {
+    probe, //are you alive?
+    ack, //yes, or a relayed yes for an indirect probe
+    probe_request //please probe the subject for me
+  } type_t;
+
+  typedef enum {
+    alive,
+    suspect,
+    dead
+  } state_t;
+
+  static const char*
+  tostr(type_t ty);
+
+  static const char*
+  tostr(state_t state);
+
+  swim_message(type_t ty, int subject, int seqnum) :
+    type_(ty),
+    subject_(subject),
+    seqnum_(seqnum)
+  {
+    class_ = ping;
+  }
+
+  type_t
+  type() const {
+    return type_;
+  }
+
+  /**
+   * @return The rank whose liveness is in question
+   */
+  int
+  subject() const {
+    return subject_;
+  }
+
+  int
+  seqnum() const {
+    return seqnum_;
+  }
+
+  int
+  num_updates() const {
+    return updates_.size() / 3;
+  }
+
+  void
+  add_update(int rank, state_t state, int incarnation){
+    updates_.push_back(rank);
+    updates_.push_back(state);
+    updates_.push_back(incarnation);
+  }
+
+  void
+  get_update(int idx, int& rank, state_t& state, int& incarnation) const {
+    rank = updates_[3*idx];
+    state = (state_t) updates_[3*idx+1];
+    incarnation = updates_[3*idx+2];
+  }
+
+  parent_message*
+  clone() const {
+    swim_message* cln = new swim_message;
+    clone_into(cln);
+    return cln;
+  }
+
+  virtual void
+  serialize_order(sprockit::serializer& ser);
+
+ protected:
+  void
+  clone_into(swim_message* cln) const {
+    cln->type_ = type_;
+    cln->subject_ = subject_;
+    cln->seqnum_ = seqnum_;
+    cln->updates_ = updates_;
+    message::clone_into(cln);
+  }
+
+ protected:
+  type_t type_;
+
+  int subject_;
+
+  int seqnum_;
+
+  /** Flattened (rank, state, incarnation) triples */
+  std::vector<int> updates_;
+
+};
+
+/**
+ * @class swim_monitor
+ * Failure detection following SWIM (Das, Gupta, Motivala).
+ * Once per protocol period each rank probes one member, chosen by walking
+ * a shuffled member list. A probe that is not acked within the probe
+ * timeout is retried indirectly through a few random members. A member
+ * that stays silent for the whole period becomes suspect, and is declared
+ * dead if nobody refutes the suspicion in time. Membership changes are
+ * piggybacked on probe traffic rather than broadcast, so every rank
+ * sends a constant number of messages per period regardless of scale.
+ */
+class swim_monitor :
+  public activity_monitor
+{
+ public:
+  std::string
+  to_string() const {
+    return "swim monitor";
+  }
+
+  swim_monitor();
+
+  virtual void
+  init_factory_params(sprockit::sim_parameters* params);
+
+  void
+  ping(int dst, timeout_function* func);
+
+  void
+  cancel_ping(int dst, timeout_function* func);
+
+  void
+  renew_pings(double wtime);
+
+  void
+  message_received(const message::ptr& msg);
+
+  void
+  validate_done();
+
+  void
+  validate_all_pings();
+
+  /**
+   * @param rank
+   * @return What this rank currently believes about the member
+   */
+  swim_message::state_t
+  member_state(int rank) const {
+    return members_[rank].state;
+  }
+
+  /**
+   * @return This rank's incarnation, bumped every time it refutes a suspicion
+   */
+  int
+  incarnation() const {
+    return incarnation_;
+  }
+
+  /**
+   * @return How long a suspect has to refute before it is declared dead
+   */
+  double
+  suspect_timeout() const {
+    return suspect_timeout_;
+  }
+
+ private:
+  struct member {
+    swim_message::state_t state;
+    int incarnation;
+    double suspect_deadline;
+  };
+
+  struct update {
+    int rank;
+    swim_message::state_t state;
+    int incarnation;
+    int sends_left;
+  };
+
+  struct relay {
+    int origin;
+    int seqnum;
+    double sent;
+  };
+
+  void
+  init_members();
+
+  void
+  shuffle_probe_order();
+
+  void
+  start_period(double wtime);
+
+  void
+  send_indirect_probes();
+
+  void
+  check_suspects(double wtime);
+
+  int
+  next_probe_target();
+
+  int
+  random_int(int max);
+
+  void
+  send(int dst, swim_message::type_t ty, int subject, int seqnum);
+
+  void
+  piggyback(const swim_message::ptr& msg);
+
+  void
+  disseminate(int rank, swim_message::state_t state, int incarnation);
+
+  void
+  apply_update(int rank, swim_message::state_t state, int incarnation, double wtime);
+
+  void
+  mark_suspect(int rank, int incarnation, double wtime);
+
+  void
+  mark_dead(int rank);
+
+  std::vector<member> members_;
+
+  /** Shuffled order in which members get probed */
+  std::vector<int> probe_order_;
+
+  int probe_idx_;
+
+  std::list<update> updates_;
+
+  /** Probes sent on behalf of someone else, keyed by my seqnum */
+  std::map<int, relay> relays_;
+
+  /** Functions waiting to hear that a rank has died */
+  std::map<int, function_set> listeners_;
+
+  /** Members currently under suspicion */
+  std::list<int> suspects_;
+
+  int me_;
+
+  int nproc_;
+
+  int seqnum_;
+
+  int incarnation_;
+
+  unsigned int seed_;
+
+  /** The member probed in the current period, -1 if none */
+  int probe_target_;
+
+  int probe_seqnum_;
+
+  bool probe_acked_;
+
+  bool indirect_sent_;
+
+  double period_start_;
+
+  double period_;
+
+  double probe_timeout_;
+
+  double suspect_timeout_;
+
+  int suspect_mult_;
+
+  int num_indirect_;
+
+  int retransmit_mult_;
+
+  int retransmit_limit_;
+
+  int max_piggyback_;
+
+};
+
+}
+
+#endif // sumi_api_SWIM_H
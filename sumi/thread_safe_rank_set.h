@@ -0,0 +1,138 @@
+#ifndef sumi_api_THREAD_SAFE_RANK_SET_H
+#define sumi_api_THREAD_SAFE_RANK_SET_H
+
+#include <sumi/rank_set.h>
+#include <sumi/lockable.h>
+
+namespace sumi {
+
+/**
+ * @class thread_safe_rank_set
+ * A rank_set behind a lock, for failure sets that the progress engine
+ * updates while other threads query them. Every call takes the lock.
+ * As with thread_safe_set, the lock is held from #start_iteration until
+ * #end_iteration, so the loop body must not touch the set again.
+ */
+class thread_safe_rank_set :
+  public lockable
+{
+ public:
+  typedef rank_set::const_iterator const_iterator;
+  typedef rank_set::size_type size_type;
+
+  thread_safe_rank_set() {}
+
+  thread_safe_rank_set(const thread_safe_rank_set& other) :
+    lockable(),
+    set_(other.get_copy())
+  {
+  }
+
+  thread_safe_rank_set&
+  operator=(const thread_safe_rank_set& other){
+    if (this != &other){
+      *this = other.get_copy();
+    }
+    return *this;
+  }
+
+  thread_safe_rank_set&
+  operator=(const rank_set& other){
+    lock();
+    set_ = other;
+    unlock();
+    return *this;
+  }
+
+  const_iterator
+  start_iteration() const {
+    lock();
+    return set_.end();
+  }
+
+  void
+  end_iteration() const {
+    unlock();
+  }
+
+  /**
+   * Only valid between #start_iteration and #end_iteration
+   */
+  const_iterator
+  begin() const {
+    return set_.begin();
+  }
+
+  /**
+   * @return A snapshot of the set that can be used without the lock
+   */
+  rank_set
+  get_copy() const {
+    lock();
+    rank_set ret(set_);
+    unlock();
+    return ret;
+  }
+
+  bool
+  empty() const {
+    lock();
+    bool ret = set_.empty();
+    unlock();
+    return ret;
+  }
+
+  size_type
+  size() const {
+    lock();
+    size_type ret = set_.size();
+    unlock();
+    return ret;
+  }
+
+  size_type
+  count(int rank) const {
+    lock();
+    size_type ret = set_.count(rank);
+    unlock();
+    return ret;
+  }
+
+  bool
+  insert(int rank){
+    lock();
+    bool ret = set_.insert(rank);
+    unlock();
+    return ret;
+  }
+
+  void
+  insert_all(const rank_set& other){
+    lock();
+    set_.insert_all(other);
+    unlock();
+  }
+
+  void
+  clear(){
+    lock();
+    set_.clear();
+    unlock();
+  }
+
+  std::string
+  to_string() const {
+    lock();
+    std::string ret = set_.to_string();
+    unlock();
+    return ret;
+  }
+
+ private:
+  rank_set set_;
+
+};
+
+}
+
+#endif // sumi_api_THREAD_SAFE_RANK_SET_H
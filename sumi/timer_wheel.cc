@@ -0,0 +1,192 @@
+#include <sumi/timer_wheel.h>
+#include <sprockit/errors.h>
+
+namespace sumi {
+
+timer_wheel::timer_wheel(double tick, int num_levels) :
+  tick_(tick),
+  num_levels_(num_levels),
+  current_tick_(0),
+  size_(0)
+{
+  if (tick <= 0 || num_levels <= 0){
+    spkt_throw_printf(sprockit::value_error,
+      "timer_wheel: invalid tick %8.4e or number of levels %d",
+      tick, num_levels);
+  }
+  span_ = 1L << (slot_bits*num_levels_);
+  slots_ = new head[num_levels_*num_slots];
+}
+
+timer_wheel::~timer_wheel()
+{
+  delete[] slots_;
+}
+
+void
+timer_wheel::link(head& h, entry* e)
+{
+  entry* first = h.next_;
+  e->prev_ = &h;
+  e->next_ = first;
+  first->prev_ = e;
+  h.next_ = e;
+}
+
+void
+timer_wheel::unlink(entry* e)
+{
+  e->prev_->next_ = e->next_;
+  e->next_->prev_ = e->prev_;
+  e->prev_ = e->next_ = 0;
+  if (e->parked_){
+    e->parked_ = false;
+  } else {
+    --size_;
+  }
+}
+
+void
+timer_wheel::insert(entry* e)
+{
+  long t = to_tick(e->deadline_);
+  if (t < current_tick_){
+    //already due, goes in the slot checked next
+    t = current_tick_;
+  }
+  long delta = t - current_tick_;
+  ++size_;
+  for (int l=0; l < num_levels_; ++l){
+    if (delta < (1L << (slot_bits*(l+1)))){
+      link(slot(l, (t >> (slot_bits*l)) & slot_mask), e);
+      return;
+    }
+  }
+  link(overflow_, e);
+}
+
+void
+timer_wheel::schedule(entry* e, double deadline)
+{
+  if (e->scheduled()){
+    unlink(e);
+  }
+  e->deadline_ = deadline;
+  insert(e);
+}
+
+void
+timer_wheel::park(entry* e)
+{
+  if (e->scheduled()){
+    unlink(e);
+  }
+  e->parked_ = true;
+  link(parked_, e);
+}
+
+void
+timer_wheel::cancel(entry* e)
+{
+  if (e->scheduled()){
+    unlink(e);
+  }
+}
+
+void
+timer_wheel::collect_parked(entry_list& parked)
+{
+  while (!parked_.empty()){
+    entry* e = parked_.next_;
+    unlink(e);
+    parked.push_back(e);
+  }
+}
+
+void
+timer_wheel::reinsert_all(head& h)
+{
+  //detach the whole list first, entries may land back in h
+  entry* e = h.next_;
+  entry* end = &h;
+  h.reset();
+  while (e != end){
+    entry* next = e->next_;
+    e->prev_ = e->next_ = 0;
+    --size_;
+    insert(e);
+    e = next;
+  }
+}
+
+void
+timer_wheel::cascade(int level)
+{
+  if (level >= num_levels_){
+    reinsert_all(overflow_);
+    return;
+  }
+
+  long idx = (current_tick_ >> (slot_bits*level)) & slot_mask;
+  if (idx == 0){
+    //entering a new revolution at this level, pull down from above first
+    cascade(level+1);
+  }
+  reinsert_all(slot(level, idx));
+}
+
+void
+timer_wheel::rehash(long now_tick)
+{
+  current_tick_ = now_tick;
+  for (int l=0; l < num_levels_; ++l){
+    for (long i=0; i < num_slots; ++i){
+      reinsert_all(slot(l, i));
+    }
+  }
+  reinsert_all(overflow_);
+}
+
+void
+timer_wheel::advance(double now, entry_list& expired)
+{
+  long now_tick = to_tick(now);
+  if (size_ == 0){
+    if (now_tick > current_tick_) current_tick_ = now_tick;
+    return;
+  }
+
+  if (now_tick - current_tick_ >= span_){
+    //jumped past the whole wheel, cheaper to start over
+    rehash(now_tick);
+  }
+
+  while (true){
+    if ((current_tick_ & slot_mask) == 0){
+      cascade(1);
+    }
+
+    head& h = slot(0, current_tick_ & slot_mask);
+    entry* e = h.next_;
+    while (e != &h){
+      entry* next = e->next_;
+      if (e->deadline_ < now){
+        unlink(e);
+        expired.push_back(e);
+      }
+      e = next;
+    }
+
+    if (current_tick_ >= now_tick){
+      break;
+    }
+
+    ++current_tick_;
+    if (size_ == 0){
+      current_tick_ = now_tick;
+      break;
+    }
+  }
+}
+
+}
@@ -0,0 +1,159 @@
+#ifndef sumi_api_TIMER_WHEEL_H
+#define sumi_api_TIMER_WHEEL_H
+
+#include <vector>
+
+namespace sumi {
+
+/**
+ * @class timer_wheel
+ * Hierarchical timing wheel. Each level has 64 slots, a slot at level l
+ * covering 64^l ticks. Scheduling, canceling and expiring an entry are
+ * O(1) amortized, independent of how many entries are outstanding.
+ * Entries further out than the top level are kept in an overflow list
+ * that is revisited once per revolution of the top level.
+ */
+class timer_wheel
+{
+ public:
+  /**
+   * @class entry
+   * Anything that wants a deadline, linked intrusively into the wheel
+   */
+  class entry
+  {
+    friend class timer_wheel;
+   public:
+    double
+    deadline() const {
+      return deadline_;
+    }
+
+    bool
+    scheduled() const {
+      return prev_ != 0;
+    }
+
+   protected:
+    entry() :
+      prev_(0), next_(0), deadline_(0), parked_(false)
+    {
+    }
+
+   private:
+    entry* prev_;
+    entry* next_;
+    double deadline_;
+    bool parked_;
+  };
+
+  typedef std::vector<entry*> entry_list;
+
+  static const int default_num_levels = 3;
+
+  /**
+   * @param tick The time covered by one slot of the lowest level
+   * @param num_levels
+   */
+  timer_wheel(double tick, int num_levels = default_num_levels);
+
+  ~timer_wheel();
+
+  /**
+   * Schedule, or reschedule, an entry. Deadlines already passed
+   * expire on the next call to #advance.
+   */
+  void
+  schedule(entry* e, double deadline);
+
+  /**
+   * Take an entry off the wheel but keep it around for #collect_parked
+   */
+  void
+  park(entry* e);
+
+  void
+  cancel(entry* e);
+
+  /**
+   * Move time forward, removing every entry whose deadline is before now
+   * @param expired [out] Appended to with the expired entries
+   */
+  void
+  advance(double now, entry_list& expired);
+
+  /**
+   * @param parked [out] Appended to with every parked entry, which are removed
+   */
+  void
+  collect_parked(entry_list& parked);
+
+  /**
+   * @return The number of entries on the wheel, not counting parked ones
+   */
+  int
+  size() const {
+    return size_;
+  }
+
+ private:
+  static const int slot_bits = 6;
+  static const long num_slots = 1L << slot_bits;
+  static const long slot_mask = num_slots - 1;
+
+  struct head : public entry {
+    head(){ reset(); }
+    void reset(){
+      entry* me = this;
+      me->prev_ = me->next_ = me;
+    }
+    bool empty() const {
+      return next_ == this;
+    }
+  };
+
+  long
+  to_tick(double t) const {
+    return long(t / tick_);
+  }
+
+  head&
+  slot(int level, long idx) {
+    return slots_[level*num_slots + idx];
+  }
+
+  void
+  link(head& h, entry* e);
+
+  void
+  unlink(entry* e);
+
+  void
+  insert(entry* e);
+
+  void
+  reinsert_all(head& h);
+
+  void
+  cascade(int level);
+
+  void
+  rehash(long now_tick);
+
+  timer_wheel(const timer_wheel&);
+  timer_wheel& operator=(const timer_wheel&);
+
+  head* slots_;
+  head overflow_;
+  head parked_;
+  double tick_;
+  int num_levels_;
+  long span_;
+  long current_tick_;
+  int size_;
+
+};
+
+}
+
+#endif // sumi_api_TIMER_WHEEL_H
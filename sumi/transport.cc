@@ -5,14 +5,28 @@
 #include <sumi/allgather.h>
 #include <sumi/domain.h>
 #include <sumi/bcast.h>
+#include <sumi/wire_header.h>
 #include <sprockit/stl_string.h>
 #include <sprockit/sim_parameters.h>
 #include <sprockit/keyword_registration.h>
+#include <sprockit/serializer.h>
 
 RegisterDebugSlot(sumi);
 ImplementFactory(sumi::transport);
 
-RegisterKeywords("lazy_watch", "eager_cutoff", "use_put_protocol");
+RegisterKeywords(
+"lazy_watch",
+"eager_cutoff",
+"vote_radix",
+"use_put_protocol",
+"smsg_coalesce",
+"smsg_coalesce_bytes",
+"smsg_coalesce_count",
+"smsg_coalesce_delay",
+"eager_credits",
+"eager_credit_return",
+"spare_poll_interval",
+"public_buffer_cache_size");
 
 #define START_PT2PT_FUNCTION(dst) \
   start_function(); \
@@ -36,6 +50,7 @@ transport::transport() :
   inited_(false),
   finalized_(false),
   eager_cutoff_(512),
+  vote_radix_(2),
   lazy_watch_(false),
   heartbeat_active_(false),
   heartbeat_running_(false),
@@ -44,8 +59,17 @@ transport::transport() :
   is_dead_(false),
   use_put_protocol_(false),
   use_hardware_ack_(false),
+  eager_credits_(0),
+  eager_credit_return_(0),
+  smsg_coalesce_(false),
+  smsg_coalesce_bytes_(4096),
+  smsg_coalesce_count_(16),
+  smsg_coalesce_delay_(1e-5),
   global_domain_(0),
   nspares_(0),
+  work_domain_(0),
+  spare_poll_interval_(1e-3),
+  reg_cache_(0),
   recovery_lock_(0)
 {
   heartbeat_tag_start_ = 1e9;
@@ -53,6 +77,15 @@ transport::transport() :
   heartbeat_tag_ = heartbeat_tag_start_;
 }
 
+transport::~transport()
+{
+  int ndomains = work_domains_.size();
+  for (int i=0; i < ndomains; ++i){
+    delete work_domains_[i];
+  }
+  if (reg_cache_) delete reg_cache_;
+}
+
 void
 transport::validate_api()
 {
@@ -121,28 +154,120 @@ transport::init()
 void
 transport::init_spares(int nspares)
 {
+  if (nspares < 0 || nspares >= nproc_){
+    spkt_throw_printf(sprockit::value_error,
+      "transport::init_spares: cannot hold back %d spares from %d ranks",
+      nspares, nproc_);
+  }
+  nspares_ = nspares;
+  if (nspares == 0){
+    return;
+  }
+  int nslots = nproc_ - nspares;
+  work_domain_ = new spare_domain(rank_, nslots, nproc_);
+  work_domains_.push_back(work_domain_);
+  spare_pool_.clear();
+  spare_pool_.insert_range(nslots, nproc_);
+}
+
+domain*
+transport::work_dom() const
+{
+  if (work_domain_){
+    return work_domain_;
+  }
+  return global_domain_;
+}
+
+bool
+transport::is_spare() const
+{
+  return work_domain_ && work_domain_->my_domain_rank() < 0;
+}
+
+int
+transport::wait_for_activation()
+{
+  std::list<message::ptr> held;
+  while (is_spare()){
+    message::ptr msg = idle_poll(spare_poll_interval_);
+    if (msg){
+      held.push_back(msg);
+    }
+  }
+  debug_printf(sprockit::dbg::sumi,
+    "Rank %d activated as spare in slot %d",
+    rank_, work_dom()->my_domain_rank());
+
+  std::list<message::ptr>::iterator it, end = held.end();
+  for (it=held.begin(); it != end; ++it){
+    completion_queue_.push_back(*it);
+  }
+  return work_dom()->my_domain_rank();
+}
+
+void
+transport::substitute_spares(const rank_set& failed)
+{
+  //every rank agreed on the same failures and walks them in the same order,
+  //so every rank makes the same substitutions
+  spare_domain* next = 0;
+  rank_set::const_iterator it, end = failed.start_iteration();
+  for (it=failed.begin(); it != end; ++it){
+    int rank = *it;
+    spare_pool_.erase(rank);
+    spare_domain* current = next ? next : work_domain_;
+    int slot = current->global_to_domain_rank(rank);
+    if (slot < 0 || spare_pool_.empty()){
+      //either not a working rank or already replaced
+      //with no spares left, collectives shrink around the failure
+      continue;
+    }
+    int spare = *spare_pool_.begin();
+    spare_pool_.erase(spare);
+    if (!next){
+      next = new spare_domain(*work_domain_);
+    }
+    next->substitute(slot, spare);
+    debug_printf(sprockit::dbg::sumi,
+      "Rank %d substituting spare %d for failed rank %d in slot %d",
+      rank_, spare, rank, slot);
+  }
+  failed.end_iteration();
 
+  if (next){
+    //collectives still running may hold the old domain, freed with the transport
+    work_domains_.push_back(next);
+    work_domain_ = next;
+  }
 }
 
 void
 transport::finalize()
 {
+  flush_smsgs();
   clean_up();
+  if (reg_cache_){
+    registration_cache::registration_list regs;
+    reg_cache_->clear(regs);
+    unregister_public_buffers(regs);
+  }
   //this should really loop through and kill off all the pings
   //so none of them execute
   finalized_ = true;
   debug_printf(sprockit::dbg::sumi,
       "Rank %d sending finalize terminate to %s",
       rank_, failed_ranks_.to_string().c_str());
-  thread_safe_set<int>::iterator it, end = failed_ranks_.start_iteration();
-  for (it=failed_ranks_.begin(); it != end; ++it){
+  //sending takes the transport lock, so never hold the set's lock for it
+  rank_set failed = failed_ranks_.get_copy();
+  rank_set::const_iterator it, end = failed.end();
+  for (it=failed.begin(); it != end; ++it){
     int dst = *it;
     debug_printf(sprockit::dbg::sumi,
         "Rank %d sending finalize terminate to %d",
         rank_, dst);
     send_terminate(dst);
   }
-  failed_ranks_.end_iteration();
 }
 
 void
@@ -189,6 +314,7 @@ transport::blocking_poll()
   if (empty){
     debug_printf(sprockit::dbg::sumi,
       "Rank %d blocking_poll: cq empty, blocking", rank_);
+    flush_smsgs();
     return block_until_message();
   }
   else {
@@ -207,6 +333,7 @@ transport::blocking_poll(double timeout)
     debug_printf(sprockit::dbg::sumi,
       "Rank %d blocking_poll: cq empty, blocking until timeout %8.4e",
       rank_, timeout);
+    flush_smsgs();
     return block_until_message(timeout);
   } else {
     debug_printf(sprockit::dbg::sumi,
@@ -219,7 +346,7 @@ transport::blocking_poll(double timeout)
 void
 transport::send(int dst, const message::ptr &msg)
 {
-  if (use_eager_protocol(msg->byte_length())){
+  if (use_eager_protocol(msg->byte_length()) && has_eager_credit(dst)){
     send_payload(dst, msg);
   } else {
     send_unexpected_rdma(dst, msg);
@@ -272,6 +399,10 @@ transport::handle(const message::ptr& msg)
     clean_up();
   }
 
+  if (eager_credits_){
+    recv_eager_credits(msg);
+  }
+
   switch (msg->class_type())
   {
   case message::terminate:
@@ -316,6 +447,21 @@ transport::handle(const message::ptr& msg)
     monitor_->message_received(msg);
     break;
   }
+  case message::credit:
+    //explicit credit return, already applied above
+    break;
+  case message::batch: {
+    batch_message::ptr bmsg = ptr_safe_cast(batch_message, msg);
+    const char* record = bmsg->packed().empty() ? 0 : &bmsg->packed()[0];
+    for (int i=0; i < bmsg->num_messages(); ++i){
+      uint32_t size;
+      ::memcpy(&size, record, sizeof(uint32_t));
+      record += sizeof(uint32_t);
+      handle(wire_header::unpack(record, size, this));
+      record += size;
+    }
+    break;
+  }
   case message::no_class: {
       spkt_throw_printf(sprockit::value_error,
         "transport::handle: got message %s with no class of type %s",
@@ -330,6 +476,32 @@ transport::handle(const message::ptr& msg)
   }
 }
 
+void
+transport::rdma_chunk_recved(const message::ptr& msg, long bytes_done)
+{
+  if (msg->class_type() != message::collective || !msg->needs_recv_ack()){
+    //nobody is going to look at partial data
+    return;
+  }
+
+  collective_work_message::ptr cmsg = ptr_safe_cast(collective_work_message, msg);
+  tag_to_collective_map::iterator it = collectives_[cmsg->type()].find(cmsg->tag());
+  if (it != collectives_[cmsg->type()].end()){
+    it->second->recv_chunk(cmsg, bytes_done);
+  }
+}
+
+void*
+transport::eager_landing_zone(const collective_work_message::ptr& msg)
+{
+  tag_to_collective_map::iterator it = collectives_[msg->type()].find(msg->tag());
+  if (it == collectives_[msg->type()].end()){
+    //collective not started yet, message will be queued
+    return 0;
+  }
+  return it->second->eager_landing_zone(msg);
+}
+
 void
 transport::send_self_terminate()
 {
@@ -423,6 +595,29 @@ transport::fail_watcher(int dst)
   watchers_.erase(dst);
 }
 
+void
+transport::failure_detected(int rank)
+{
+  debug_printf(sprockit::dbg::sumi | sprockit::dbg::sumi_failure,
+    "Rank %d detected failure of %d", rank_, rank);
+  detect_times_lock_.lock();
+  //keep the first detection
+  detect_times_.insert(std::make_pair(rank, wall_time()));
+  detect_times_lock_.unlock();
+  declare_failed(rank);
+  fail_watcher(rank);
+}
+
+double
+transport::failure_detect_time(int rank) const
+{
+  detect_times_lock_.lock();
+  std::map<int,double>::const_iterator it = detect_times_.find(rank);
+  double ret = it == detect_times_.end() ? -1 : it->second;
+  detect_times_lock_.unlock();
+  return ret;
+}
+
 void
 transport::init_factory_params(sprockit::sim_parameters* params)
 {
@@ -432,8 +627,35 @@ transport::init_factory_params(sprockit::sim_parameters* params)
   eager_cutoff_ = params->get_optional_int_param("eager_cutoff", 512);
   use_put_protocol_ = params->get_optional_bool_param("use_put_protocol", false);
 
+  spare_poll_interval_ = params->get_optional_time_param("spare_poll_interval", 1e-3);
+
+  vote_radix_ = params->get_optional_int_param("vote_radix", 2);
+  if (vote_radix_ < 2){
+    spkt_throw_printf(sprockit::value_error,
+      "vote_radix=%d must be at least 2", vote_radix_);
+  }
+
   lazy_watch_ = params->get_optional_bool_param("lazy_watch", true);
 
+  smsg_coalesce_ = params->get_optional_bool_param("smsg_coalesce", false);
+  smsg_coalesce_bytes_ = params->get_optional_byte_length_param("smsg_coalesce_bytes", 4096);
+  smsg_coalesce_count_ = params->get_optional_int_param("smsg_coalesce_count", 16);
+  smsg_coalesce_delay_ = params->get_optional_time_param("smsg_coalesce_delay", 1e-5);
+
+  long cache_size = params->get_optional_byte_length_param("public_buffer_cache_size", 0);
+  if (cache_size){
+    reg_cache_ = new registration_cache(cache_size);
+  }
+
+  eager_credits_ = params->get_optional_int_param("eager_credits", 0);
+  eager_credit_return_ = params->get_optional_int_param("eager_credit_return",
+                                                        (eager_credits_ + 1) / 2);
+  if (eager_credits_ && (eager_credit_return_ <= 0 || eager_credit_return_ > eager_credits_)){
+    spkt_throw_printf(sprockit::value_error,
+      "eager_credit_return=%d must be between 1 and eager_credits=%d",
+      eager_credit_return_, eager_credits_);
+  }
+
   allgathers_[0] = new bruck_collective;
   allreduces_[0] = new wilke_halving_allreduce;
   bcasts_[0] = new binary_tree_bcast_collective;
@@ -441,23 +663,67 @@ transport::init_factory_params(sprockit::sim_parameters* params)
 
 void
 transport::dynamic_tree_vote(int vote, int tag, vote_fxn fxn, int context, domain* dom)
+{
+  dynamic_tree_vote(vote, tag, fxn, 0, 0, 0, 0, &Null::op, context, dom);
+}
+
+void
+transport::dynamic_tree_vote(int vote, int tag, vote_fxn fxn,
+                             void* dst, void* src, int nelems, int type_size, reduce_fxn reduce,
+                             int context, domain* dom)
 {
   if (dom == 0) dom = global_domain_;
+  if (nelems && dst && max_smsg_size() >= 0){
+    //the smallest vote message the payload can travel in: every rank
+    //contributing, nobody failed yet
+    dynamic_tree_vote_message::ptr msg = new dynamic_tree_vote_message(
+      vote, dynamic_tree_vote_message::up_vote, tag, 0, 0);
+    msg->set_payload(src ? src : dst, nelems*type_size);
+    rank_set everyone;
+    everyone.insert_range(0, dom->nproc());
+    msg->set_contributors(everyone);
+    long needed = wire_header::packed_size(msg);
+    if (needed > max_smsg_size()){
+      spkt_throw_printf(sprockit::value_error,
+        "dynamic_tree_vote: payload of %d bytes on tag=%d needs vote messages of %ld bytes, "
+        "but short messages hold at most %ld - raise smsg_buffer_size or use allreduce",
+        nelems*type_size, tag, needed, max_smsg_size());
+    }
+  }
+
   if (dom->nproc() == 1){
+    if (dst && src && dst != src){
+      ::memcpy(dst, src, nelems*type_size);
+    }
     collective_done_message::ptr dmsg = new collective_done_message(tag, collective::dynamic_tree_vote, dom);
     dmsg->set_domain_rank(0);
     dmsg->set_vote(vote);
-    votes_done_[tag] = vote_result(vote, thread_safe_set<int>());
+    if (nelems){
+      dmsg->set_result(dst);
+    }
+    //nobody else to agree with, the context starts out failure-free
+    votes_done_[tag] = vote_result(vote, 0);
+    forget_rank_map(tag);
     handle(dmsg);
     return;
   }
 
   START_COLLECTIVE_FUNCTION();
   dynamic_tree_vote_collective* voter = new dynamic_tree_vote_collective(vote, fxn, tag, this, dom, context);
+  if (nelems){
+    voter->init_payload(dst, src, nelems, type_size, reduce);
+  }
   start_collective(voter);
   END_COLLECTIVE_FUNCTION();
 }
 
+void
+transport::survivor_allreduce(void* dst, void* src, int nelems, int type_size, int tag, reduce_fxn fxn, int context, domain* dom)
+{
+  int vote = 1;
+  dynamic_tree_vote(vote, tag, &And<int>::op, dst, src, nelems, type_size, fxn, context, dom);
+}
+
 template <class Map, class Val, class Key>
 bool
 pull_from_map(Val& val, const Map& m, const Key& k)
@@ -537,7 +803,7 @@ void
 transport::vote_done(const collective_done_message::ptr& dmsg)
 {
   //if we have some failures, let the watchers know that things have failed
-  thread_safe_set<int>::iterator it, end = dmsg->failed_procs().start_iteration();
+  rank_set::const_iterator it, end = dmsg->failed_procs().start_iteration();
   for (it=dmsg->failed_procs().begin(); it != end; ++it){
     fail_watcher(*it);
   }
@@ -589,6 +855,7 @@ transport::do_heartbeat(int prev_context)
   dynamic_tree_vote_collective* voter = new dynamic_tree_vote_collective(
     vote, &And<int>::op, heartbeat_tag_, this, global_domain_, prev_context);
   collectives_[collective::dynamic_tree_vote][heartbeat_tag_] = voter;
+  collective_started(collective::dynamic_tree_vote, heartbeat_tag_);
   voter->start();
   deliver_pending(voter, heartbeat_tag_, collective::dynamic_tree_vote);
 
@@ -631,6 +898,7 @@ transport::start_collective(collective* coll)
   }
 
   //validate_collective(ty, tag);
+  collective_started(ty, tag);
   collective*& existing = collectives_[ty][tag];
   if (existing){
     coll->start();
@@ -749,6 +1017,7 @@ transport::finish_collective(collective* coll, const collective_done_message::pt
   coll->complete();
   collective::type_t ty = dmsg->type();
   int tag = dmsg->tag();
+  collective_finished(ty, tag);
   if (delete_collective && !coll->persistent()){ //otherwise collective must exist FOREVER
     collectives_[ty].erase(tag);
     todel_.push_back(coll);
@@ -757,11 +1026,11 @@ transport::finish_collective(collective* coll, const collective_done_message::pt
   if (ty == collective::dynamic_tree_vote){
     //this requires some extra processing
     //and doesn't always generate an operation done
-    votes_done_[tag] = vote_result(dmsg->vote(), dmsg->failed_procs());
-    vote_result& prev_context = votes_done_[coll->context()];
-    //merge the previous context
-    votes_done_[tag].failed_ranks.insert_all(prev_context.failed_ranks);
-    failed_ranks_.insert_all(votes_done_[tag].failed_ranks);
+    //the new context is the previous one plus whatever is new in this vote
+    vote_agreed(tag, coll->context(), dmsg->vote(), dmsg->failed_procs(),
+                coll->dom() == global_domain_);
+    //heartbeat tags get recycled, drop any map built for an old vote
+    forget_rank_map(tag);
     vote_done(dmsg);
   } else {
     //this always generates an operation done
@@ -774,6 +1043,19 @@ transport::finish_collective(collective* coll, const collective_done_message::pt
     failed_ranks_.to_string().c_str());
 }
 
+void
+transport::vote_agreed(int tag, int context, int vote, const rank_set& failed, bool global)
+{
+  int prev_epoch = votes_done_[context].epoch;
+  int epoch = failure_log_.append(prev_epoch, failed);
+  votes_done_[tag] = vote_result(vote, epoch);
+  failed_ranks_.insert_all(failed);
+  if (work_domain_ && epoch != prev_epoch && global){
+    //earlier failures were already handled by the vote that found them
+    substitute_spares(failure_log_.delta(epoch));
+  }
+}
+
 void
 transport::barrier(int tag, bool fault_aware, domain* dom)
 {
@@ -783,13 +1065,11 @@ transport::barrier(int tag, bool fault_aware, domain* dom)
   if (coll) start_collective(coll);
 }
 
-static const thread_safe_set<int> empty_set;
-
-const thread_safe_set<int>&
+failure_log::snapshot
 transport::failed_ranks(int context) const
 {
   if (context == options::initial_context){
-    return empty_set;
+    return failure_log_.view(0);
   }
 
   vote_map::const_iterator it = votes_done_.find(context);
@@ -798,7 +1078,39 @@ transport::failed_ranks(int context) const
         "sumi_api::failed_rank: unknown or uncommitted context %d on rank %d",
         context, rank_);
   }
-  return it->second.failed_ranks;
+  return failure_log_.view(it->second.epoch);
+}
+
+void
+transport::forget_rank_map(int context)
+{
+  lock();
+  rank_maps_.erase(context);
+  unlock();
+}
+
+dense_rank_map
+transport::rank_map(int context, domain* dom)
+{
+  if (dom != global_domain_){
+    return dense_rank_map(failed_ranks(context), dom);
+  }
+
+  lock();
+  std::map<int, dense_rank_map>::iterator it = rank_maps_.find(context);
+  if (it != rank_maps_.end()){
+    dense_rank_map map = it->second;
+    unlock();
+    return map;
+  }
+  unlock();
+
+  //build outside the lock, losing a race only costs a duplicate build
+  dense_rank_map map(failed_ranks(context), dom);
+  lock();
+  rank_maps_[context] = map;
+  unlock();
+  return map;
 }
 
 void
@@ -838,6 +1150,65 @@ transport::start_function()
   }
 }
 
+public_buffer
+transport::make_public_buffer(void* buffer, int size)
+{
+  if (!reg_cache_){
+    return register_public_buffer(buffer, size);
+  }
+
+  public_buffer pbuf;
+  if (reg_cache_->acquire(buffer, size, pbuf)){
+    return pbuf;
+  }
+
+  pbuf = register_public_buffer(buffer, size);
+  registration_cache::registration_list evicted;
+  reg_cache_->insert(buffer, size, pbuf, evicted);
+  unregister_public_buffers(evicted);
+  return pbuf;
+}
+
+void
+transport::unmake_public_buffer(public_buffer buf, int size)
+{
+  if (reg_cache_){
+    registration_cache::registration_list dropped;
+    reg_cache_->release(buf.ptr, size, dropped);
+    unregister_public_buffers(dropped);
+  } else {
+    unregister_public_buffer(buf, size);
+  }
+}
+
+void
+transport::free_public_buffer(public_buffer buf, int size)
+{
+  unmake_public_buffer(buf, size);
+  //the memory is going away - cannot keep anything pinned over it
+  invalidate_public_buffers(buf.ptr, size);
+  ::free(buf.ptr);
+}
+
+void
+transport::invalidate_public_buffers(void* buffer, int size)
+{
+  if (reg_cache_){
+    registration_cache::registration_list regs;
+    reg_cache_->invalidate(buffer, size, regs);
+    unregister_public_buffers(regs);
+  }
+}
+
+void
+transport::unregister_public_buffers(const registration_cache::registration_list& regs)
+{
+  registration_cache::registration_list::const_iterator it, end = regs.end();
+  for (it=regs.begin(); it != end; ++it){
+    unregister_public_buffer(it->buf, it->size);
+  }
+}
+
 void
 transport::end_function()
 {
@@ -853,6 +1224,9 @@ transport::smsg_send(int dst, message::payload_type_t ev, const message::ptr& ms
   configure_send(dst, ev, msg);
   msg->set_needs_send_ack(needs_ack);
 
+  if (eager_credits_ && dst != rank_){
+    consume_eager_credit(dst, ev, msg);
+  }
 
   debug_printf(sprockit::dbg::sumi,
     "Rank %d SUMI sending short message to %d, ack %srequested ",
@@ -863,6 +1237,9 @@ transport::smsg_send(int dst, message::payload_type_t ev, const message::ptr& ms
     //deliver to self
     delayed_transport_handle(msg);
   }
+  else if (smsg_coalesce_) {
+    coalesce_smsg(dst, msg);
+  }
   else {
     do_smsg_send(dst, msg);
   }
@@ -870,6 +1247,219 @@ transport::smsg_send(int dst, message::payload_type_t ev, const message::ptr& ms
   END_PT2PT_FUNCTION();
 }
 
+bool
+transport::has_eager_credit(int dst) const
+{
+  if (eager_credits_ == 0 || dst == rank_)
+    return true;
+
+  credit_map::const_iterator it = send_credits_.find(dst);
+  if (it == send_credits_.end()){
+    //haven't sent anything yet, all slots free
+    return true;
+  }
+  return it->second > 0;
+}
+
+void
+transport::consume_eager_credit(int dst, message::payload_type_t ev, const message::ptr& msg)
+{
+  if (ev == message::eager_payload){
+    //control traffic cannot fall back to rendezvous
+    //so this may go negative - rendezvous-capable senders will back off
+    credit_map::iterator it = send_credits_.find(dst);
+    if (it == send_credits_.end()){
+      send_credits_[dst] = eager_credits_ - 1;
+    } else {
+      --it->second;
+    }
+  }
+
+  //piggyback anything I owe the destination
+  credit_map::iterator it = owed_credits_.find(dst);
+  if (it != owed_credits_.end() && it->second > 0){
+    msg->set_credits(it->second);
+    it->second = 0;
+  } else {
+    msg->set_credits(0);
+  }
+}
+
+void
+transport::recv_eager_credits(const message::ptr& msg)
+{
+  int src = msg->sender();
+  if (src == rank_){
+    return;
+  }
+
+  if (msg->credits()){
+    debug_printf(sprockit::dbg::sumi,
+      "Rank %d received %d eager credits back from %d",
+      rank_, msg->credits(), src);
+    credit_map::iterator it = send_credits_.find(src);
+    if (it != send_credits_.end()){
+      it->second += msg->credits();
+    }
+    //the message object might get reused for an ack - don't double count
+    msg->set_credits(0);
+  }
+
+  if (msg->payload_type() == message::eager_payload
+    && msg->class_type() != message::batch){
+    int& owed = owed_credits_[src];
+    ++owed;
+    if (owed >= eager_credit_return_){
+      debug_printf(sprockit::dbg::sumi,
+        "Rank %d explicitly returning %d eager credits to %d",
+        rank_, owed, src);
+      message::ptr cmsg = new message;
+      cmsg->set_class_type(message::credit);
+      //credits get attached on the way out
+      send_header(src, cmsg);
+    }
+  }
+}
+
+size_t
+transport::pack_smsg(smsg_batch& batch, const message::ptr& msg)
+{
+  if (batch.count == 0){
+    batch.packed.resize(smsg_coalesce_bytes_);
+    batch.bytes = 0;
+    batch.start = wall_time();
+  }
+
+  long room = smsg_coalesce_bytes_ - batch.bytes - long(sizeof(uint32_t));
+  if (room <= 0){
+    return 0;
+  }
+
+  char* record = &batch.packed[batch.bytes];
+  size_t size = wire_header::pack_if_fits(msg, record + sizeof(uint32_t), room);
+  if (size == 0){
+    return 0;
+  }
+  uint32_t record_size = size;
+  ::memcpy(record, &record_size, sizeof(uint32_t));
+  batch.bytes += sizeof(uint32_t) + size;
+  ++batch.count;
+  return size;
+}
+
+void
+transport::coalesce_smsg(int dst, const message::ptr& msg)
+{
+  if (msg->needs_send_ack()){
+    //the ack hands back this message object - it cannot share a buffer
+    //but must not overtake anything already queued
+    flush_smsgs(dst);
+    do_smsg_send(dst, msg);
+    return;
+  }
+
+  //pack right away - the message can point into a buffer
+  //the caller is free to reuse as soon as the send returns
+  bool was_empty = smsg_batches_[dst].count == 0;
+  size_t size = pack_smsg(smsg_batches_[dst], msg);
+  if (size == 0 && !was_empty){
+    //no room left, start a new batch
+    flush_smsgs(dst);
+    size = pack_smsg(smsg_batches_[dst], msg);
+  }
+
+  if (size == 0){
+    //too large to ever share a buffer, nothing is queued ahead of it
+    smsg_batches_.erase(dst);
+    do_smsg_send(dst, msg);
+    return;
+  }
+
+  smsg_batch& batch = smsg_batches_[dst];
+  debug_printf(sprockit::dbg::sumi,
+    "Rank %d coalescing %lu byte message to %d: %d messages, %ld bytes queued",
+    rank_, size, dst, batch.count, batch.bytes);
+
+  if (batch.count >= smsg_coalesce_count_){
+    flush_smsgs(dst);
+  }
+}
+
+void
+transport::send_smsg_batch(int dst, smsg_batch& batch)
+{
+  if (is_failed(dst)){
+    debug_printf(sprockit::dbg::sumi,
+      "Rank %d dropping %d coalesced messages to failed rank %d",
+      rank_, batch.count, dst);
+    return;
+  }
+
+  debug_printf(sprockit::dbg::sumi,
+    "Rank %d flushing %d coalesced messages to %d",
+    rank_, batch.count, dst);
+
+  batch.packed.resize(batch.bytes);
+  batch_message::ptr bmsg = new batch_message(batch.count, batch.packed);
+  configure_send(dst, message::eager_payload, bmsg);
+  do_smsg_send(dst, bmsg);
+}
+
+void
+transport::flush_smsgs(int dst)
+{
+  smsg_batch_map::iterator it = smsg_batches_.find(dst);
+  if (it == smsg_batches_.end())
+    return;
+
+  smsg_batch batch;
+  batch.packed.swap(it->second.packed);
+  batch.bytes = it->second.bytes;
+  batch.count = it->second.count;
+  smsg_batches_.erase(it);
+  if (batch.count){
+    send_smsg_batch(dst, batch);
+  }
+}
+
+void
+transport::flush_smsgs()
+{
+  if (smsg_batches_.empty())
+    return;
+
+  //swap out first in case sends trigger more coalescing
+  smsg_batch_map batches;
+  batches.swap(smsg_batches_);
+  smsg_batch_map::iterator it, end = batches.end();
+  for (it=batches.begin(); it != end; ++it){
+    if (it->second.count){
+      send_smsg_batch(it->first, it->second);
+    }
+  }
+}
+
+void
+transport::flush_expired_smsgs()
+{
+  if (smsg_batches_.empty())
+    return;
+
+  double now = wall_time();
+  std::list<int> expired;
+  smsg_batch_map::iterator it, end = smsg_batches_.end();
+  for (it=smsg_batches_.begin(); it != end; ++it){
+    if ((now - it->second.start) >= smsg_coalesce_delay_){
+      expired.push_back(it->first);
+    }
+  }
+
+  std::list<int>::iterator eit, eend = expired.end();
+  for (eit=expired.begin(); eit != eend; ++eit){
+    flush_smsgs(*eit);
+  }
+}
+
 void
 transport::rdma_get(int src, const message::ptr &msg, bool needs_send_ack, bool needs_recv_ack)
 {
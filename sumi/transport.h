@@ -4,13 +4,16 @@
 #include <sumi/collective_message.h>
 #include <sumi/collective.h>
 #include <sumi/comm_functions.h>
+#include <sumi/dense_rank_map.h>
 #include <sumi/options.h>
 #include <sumi/ping.h>
 #include <sumi/rdma.h>
+#include <sumi/registration_cache.h>
 #include <sumi/domain_fwd.h>
 #include <sumi/thread_safe_int.h>
 #include <sumi/thread_safe_list.h>
 #include <sumi/thread_safe_set.h>
+#include <sumi/thread_safe_rank_set.h>
 #include <sumi/thread_lock.h>
 #include <sprockit/debug.h>
 #include <sprockit/factories/factory.h>
@@ -30,6 +33,8 @@ class transport :
 {
 
  public:
+  virtual ~transport();
+
   virtual void
   init();
   
@@ -72,6 +77,13 @@ class transport :
   void
   send_payload(int dst, const message::ptr& msg, bool needs_ack = false);
 
+  /**
+   Push out any small messages held back by the coalescing stage.
+   Called automatically on poll, but can be forced (e.g. before a long compute phase).
+   */
+  void
+  flush_smsgs();
+
   /**
    Put a message directly to the destination node.
    This assumes the application has properly configured local/remote buffers for the transfer.
@@ -183,6 +195,17 @@ class transport :
   virtual message::ptr
   block_until_message(double timeout) = 0;
 
+  /**
+   * Wait up to timeout for a message without keeping a core busy.
+   * By default this is just a timed blocking poll.
+   * @param timeout
+   * @return The next message, NULL if none arrived
+   */
+  virtual message::ptr
+  idle_poll(double timeout){
+    return blocking_poll(timeout);
+  }
+
   bool
   use_eager_protocol(long byte_length) const {
     return byte_length < eager_cutoff_;
@@ -193,6 +216,15 @@ class transport :
     eager_cutoff_ = bytes;
   }
 
+  /**
+   * Whether an eager slot is still available at the destination.
+   * If not, the caller should fall back to a rendezvous (RDMA header) protocol.
+   * Always true if eager flow control is disabled.
+   * @param dst The global rank being sent to
+   */
+  bool
+  has_eager_credit(int dst) const;
+
   bool
   use_put_protocol() const {
     return use_put_protocol_;
@@ -215,10 +247,50 @@ class transport :
   supports_hardware_ack() const {
     return false;
   }
+
+  /**
+   * @return The largest packed message that can be sent as one short message,
+   *         -1 if the transport takes messages of any size
+   */
+  virtual long
+  max_smsg_size() const {
+    return -1;
+  }
   
+  /**
+   * Hold the last nspares global ranks back as spares.
+   * The remaining ranks form the working domain. Whenever a vote on the
+   * global domain agrees on failures, every rank hands the failed slots
+   * of the working domain to the lowest live spares in the same order,
+   * so no messages are needed to agree on substitutions.
+   * Spares must take part in heartbeats to see the failures.
+   * @param nspares
+   */
   virtual void
   init_spares(int nspares);
 
+  /**
+   * @return The domain that collectives should run on. The global domain
+   *         without spares, otherwise the current working domain.
+   */
+  domain*
+  work_dom() const;
+
+  /**
+   * @return Whether this rank is an idle spare holding no working slot
+   */
+  bool
+  is_spare() const;
+
+  /**
+   * Sit idle until this rank takes over a slot in the working domain.
+   * Messages received while waiting are kept for the application.
+   * Returns immediately if this rank is not a spare.
+   * @return The slot (rank in #work_dom) this rank now holds
+   */
+  int
+  wait_for_activation();
+
   /**
    * Cancel a currently active ping
    * @param dst
@@ -306,6 +378,37 @@ class transport :
     dynamic_tree_vote(vote, tag, &op_class_type::op, context, dom);
   }
 
+  /**
+   * A vote that also reduces a small buffer in the same pass over the tree,
+   * with the same failure handling. All survivors agree on the result buffer.
+   * The total size of the input/result buffer in bytes is nelems*type_size
+   * The buffer travels eagerly inside every vote message, so on transports
+   * with a #max_smsg_size the packed vote (payload, contributors, failures)
+   * must fit in one short message. Payloads that cannot fit even before
+   * any failures are added are rejected up front with a value_error.
+   * @param vote The vote from this process
+   * @param tag A unique tag identifier for the collective
+   * @param fxn The function that merges vote
+   * @param dst Buffer for the result
+   * @param src Buffer for the input. Can be NULL or equal to dst for an in-place vote.
+   * @param nelems The number of elements in the input and result buffer.
+   * @param type_size The size of the input type, i.e. sizeof(int), sizeof(double)
+   * @param reduce The function that combines the buffers
+   * @param context The context (i.e. initial set of failed procs)
+   */
+  virtual void
+  dynamic_tree_vote(int vote, int tag, vote_fxn fxn,
+                    void* dst, void* src, int nelems, int type_size, reduce_fxn reduce,
+                    int context = options::initial_context, domain* dom = 0);
+
+  template <typename data_t, template <typename> class Op>
+  void
+  vote(void* dst, void* src, int nelems, int tag, int context = options::initial_context, domain* dom = 0){
+    typedef ReduceOp<Op, data_t> op_class_type;
+    dynamic_tree_vote(1, tag, &And<int>::op, dst, src, nelems, sizeof(data_t),
+                      &op_class_type::op, context, dom);
+  }
+
   /**
    * The total size of the input/result buffer in bytes is nelems*type_size
    * @param dst  Buffer for the result. Can be NULL to ignore payloads.
@@ -327,6 +430,35 @@ class transport :
     allreduce(dst, src, nelems, sizeof(data_t), tag, &op_class_type::op, fault_aware, context, dom);
   }
 
+  /**
+   * An allreduce that keeps going when ranks fail, finishing with the
+   * contributions of the survivors instead of failing as a whole.
+   * This runs over the dynamic tree of #dynamic_tree_vote, which rebuilds itself
+   * around failures, so it completes like a vote: the done message has type
+   * dynamic_tree_vote, its failed procs are the agreed-upon failures,
+   * its result is dst, and its missing contributions are exactly the ranks
+   * whose input is not in the result. The tag can be used as the context for
+   * the next collective. The buffer is sent eagerly in the vote messages,
+   * so it is subject to the same #max_smsg_size limit as the payload of
+   * #dynamic_tree_vote and is meant for a handful of values.
+   * @param dst  Buffer for the result
+   * @param src  Buffer for the input. Can be NULL or equal to dst for in-place.
+   * @param nelems The number of elements in the input and result buffer.
+   * @param type_size The size of the input type, i.e. sizeof(int), sizeof(double)
+   * @param tag A unique tag identifier for the collective
+   * @param fxn The function that will actually perform the reduction
+   * @param context The context (i.e. initial set of failed procs)
+   */
+  virtual void
+  survivor_allreduce(void* dst, void* src, int nelems, int type_size, int tag, reduce_fxn fxn, int context = options::initial_context, domain* dom = 0);
+
+  template <typename data_t, template <typename> class Op>
+  void
+  survivor_allreduce(void* dst, void* src, int nelems, int tag, int context = options::initial_context, domain* dom = 0){
+    typedef ReduceOp<Op, data_t> op_class_type;
+    survivor_allreduce(dst, src, nelems, sizeof(data_t), tag, &op_class_type::op, context, dom);
+  }
+
 
   /**
    * The total size of the input/result buffer in bytes is nelems*type_size
@@ -346,10 +478,10 @@ class transport :
    * @param tag
    * @param fault_aware
    */
-  void
+  virtual void
   barrier(int tag, bool fault_aware = false, domain* dom = 0);
 
-  void
+  virtual void
   bcast(void* buf, int nelems, int type_size, int tag, bool fault_aware, int context=options::initial_context, domain* dom=0);
   
   int 
@@ -384,25 +516,52 @@ class transport :
   eager_cutoff() const {
     return eager_cutoff_;
   }
+
+  /**
+   * The number of children of each node in the tree used by votes
+   * @return
+   */
+  int
+  vote_radix() const {
+    return vote_radix_;
+  }
   
   /**
    * Get the set of failed ranks associated with a given context
    * @param context The context for which you want to know the set of failed procs,
    *                default parameter is "default_context" which is the beginning, i.e. no failed procs
    * @throw If the context is unknown - i.e. no vote has executed with that tag number
-   * @return The set of failed procs
+   * @return A view of the failed procs in the failure log
    */
-  const thread_safe_set<int>&
+  failure_log::snapshot
   failed_ranks(int context) const;
 
-  const thread_safe_set<int>&
+  /**
+   * The translation between sparse and dense ranks for a context.
+   * On the global domain the index is built once per context
+   * and shared by every collective and actor on that context.
+   * @param context
+   * @param dom
+   * @return A handle to the (possibly shared) rank map
+   */
+  dense_rank_map
+  rank_map(int context, domain* dom);
+
+  /**
+   * @return A snapshot of every failure this rank knows of,
+   *         the set itself may be updated by the progress engine at any time
+   */
+  rank_set
   failed_ranks() const {
-    return failed_ranks_;
+    return failed_ranks_.get_copy();
   }
 
   void
   clear_failures() {
     failed_ranks_.clear();
+    detect_times_lock_.lock();
+    detect_times_.clear();
+    detect_times_lock_.unlock();
   }
 
   void
@@ -410,6 +569,22 @@ class transport :
     failed_ranks_.insert(rank);
   }
 
+  /**
+   * An activity monitor has decided a rank is dead.
+   * Records the failure and times out anyone lazily watching the rank.
+   */
+  void
+  failure_detected(int rank);
+
+  /**
+   * @param rank
+   * @return The wall time at which an activity monitor first declared
+   *         the rank failed, or a negative time if none has since
+   *         the failures were last cleared
+   */
+  double
+  failure_detect_time(int rank) const;
+
   bool
   is_failed(int rank) const {
     return failed_ranks_.count(rank);
@@ -456,24 +631,69 @@ class transport :
   void
   handle(const message::ptr& msg);
 
+  /**
+   Ask the collective an eager message is headed for where its payload
+   will end up, so the transport can decode straight into place.
+   * @param msg The eager message being decoded, payload not yet attached
+   * @return The final location of the payload, null if it needs its own buffer
+   */
+  void*
+  eager_landing_zone(const collective_work_message::ptr& msg);
+
+  /**
+   * Allocate a buffer already made public with #make_public_buffer.
+   * Give it back with #free_public_buffer.
+   */
   virtual public_buffer
   allocate_public_buffer(int size) {
-    return public_buffer(::malloc(size));
+    return make_public_buffer(::malloc(size), size);
   }
 
-  virtual public_buffer
-  make_public_buffer(void* buffer, int size) {
-    return public_buffer(buffer);
-  }
+  /**
+   * Make a buffer visible for RDMA. If the registration cache is enabled,
+   * an existing registration covering the buffer is reused.
+   */
+  public_buffer
+  make_public_buffer(void* buffer, int size);
 
-  virtual void
-  unmake_public_buffer(public_buffer buf, int size) {
-    //nothing to do
+  /**
+   * Give back a buffer from #make_public_buffer. With the registration cache
+   * enabled, the buffer stays registered until evicted or invalidated.
+   */
+  void
+  unmake_public_buffer(public_buffer buf, int size);
+
+  /**
+   * Release and free a buffer from #allocate_public_buffer
+   */
+  void
+  free_public_buffer(public_buffer buf, int size);
+
+  /**
+   * Drop any cached registrations overlapping the buffer.
+   * WARNING: the cache is keyed on virtual address only. This must be called
+   * before freeing or unmapping memory that was ever made public while the
+   * registration cache is enabled, otherwise a later allocation at the same
+   * address is handed the old, stale registration.
+   * Registrations still in use are unregistered on their last release.
+   */
+  void
+  invalidate_public_buffers(void* buffer, int size);
+
+  /**
+   * @return The registration cache, null if disabled
+   */
+  const registration_cache*
+  public_buffer_cache() const {
+    return reg_cache_;
   }
 
-  virtual void
-  free_public_buffer(public_buffer buf, int size) {
-    ::free(buf.ptr);
+  /**
+   * @return The activity monitor that decides which ranks have failed
+   */
+  const activity_monitor*
+  monitor() const {
+    return monitor_;
   }
 
   /**
@@ -514,6 +734,16 @@ class transport :
   virtual void
   do_smsg_send(int dst, const message::ptr& msg) = 0;
 
+  virtual public_buffer
+  register_public_buffer(void* buffer, int size) {
+    return public_buffer(buffer);
+  }
+
+  virtual void
+  unregister_public_buffer(public_buffer buf, int size) {
+    //nothing to do
+  }
+
   virtual void
   do_rdma_put(int dst, const message::ptr& msg) = 0;
 
@@ -539,6 +769,34 @@ class transport :
   void
   operation_done(const message::ptr& msg);
 
+  /**
+   Notify that a prefix of a large, chunked RDMA transfer has landed.
+   The final completion still arrives through #handle as usual.
+   * @param msg         The RDMA message being received into
+   * @param bytes_done  The leading number of bytes now valid in the recv buffer
+   */
+  void
+  rdma_chunk_recved(const message::ptr& msg, long bytes_done);
+
+  /**
+   Push out coalesced messages that have been waiting longer than #smsg_coalesce_delay_.
+   Should be invoked regularly from the progress loop of the transport.
+   */
+  void
+  flush_expired_smsgs();
+
+  /**
+   Notification that a collective has started on this rank. Default does nothing.
+   */
+  virtual void
+  collective_started(collective::type_t ty, int tag){}
+
+  /**
+   Notification that a collective has completed on this rank. Default does nothing.
+   */
+  virtual void
+  collective_finished(collective::type_t ty, int tag){}
+
  private:  
   bool
   is_heartbeat(const collective_done_message::ptr& dmsg) const {
@@ -558,6 +816,39 @@ class transport :
   void 
   vote_done(const collective_done_message::ptr& dmsg);
 
+  /**
+   * Hand working slots held by failed ranks over to live spares
+   * @param failed The failures a vote on the global domain newly agreed on
+   */
+  void
+  substitute_spares(const rank_set& failed);
+
+  void
+  unregister_public_buffers(const registration_cache::registration_list& regs);
+
+  struct smsg_batch;
+
+  void
+  coalesce_smsg(int dst, const message::ptr& msg);
+
+  void
+  flush_smsgs(int dst);
+
+  void
+  send_smsg_batch(int dst, smsg_batch& batch);
+
+  /**
+   * @return The packed size of the message, 0 if it did not fit in the batch
+   */
+  size_t
+  pack_smsg(smsg_batch& batch, const message::ptr& msg);
+
+  void
+  consume_eager_credit(int dst, message::payload_type_t ev, const message::ptr& msg);
+
+  void
+  recv_eager_credits(const message::ptr& msg);
+
   void 
   validate_collective(collective::type_t ty, int tag);
 
@@ -580,6 +871,18 @@ class transport :
   void
   fail_watcher(int dst);
 
+  /**
+   * Record the failures a finished vote agreed on
+   * @param tag     The tag of the vote, also the context it starts
+   * @param context The context the vote ran in
+   * @param vote
+   * @param failed  Every failure the vote agreed on, old and new
+   * @param global  Whether the vote ran on the global domain. Only those
+   *                votes hand the slots of new failures to spares.
+   */
+  void
+  vote_agreed(int tag, int context, int vote, const rank_set& failed, bool global);
+
   void lock();
 
   void unlock();
@@ -642,7 +945,12 @@ class transport :
   typedef spkt_enum_map<collective::type_t, tag_to_pending_map> pending_map;
   pending_map pending_collective_msgs_;
 
-  thread_safe_set<int> failed_ranks_;
+  thread_safe_rank_set failed_ranks_;
+
+  /** Wall time of the first failure_detected for each rank */
+  std::map<int,double> detect_times_;
+
+  lockable detect_times_lock_;
 
   int heartbeat_tag_start_;
 
@@ -653,19 +961,46 @@ class transport :
 
   std::list<collective*> todel_;
 
+  struct smsg_batch {
+    /** (uint32 size, wire bytes) records, packed when each message is queued */
+    std::vector<char> packed;
+    long bytes;
+    int count;
+    double start;
+    smsg_batch() : bytes(0), count(0), start(0) {}
+  };
+  typedef spkt_unordered_map<int, smsg_batch> smsg_batch_map;
+  smsg_batch_map smsg_batches_;
+
+  typedef spkt_unordered_map<int, int> credit_map;
+  /** Eager slots I have left at each destination */
+  credit_map send_credits_;
+  /** Eager slots freed up here that have not yet been returned to each sender */
+  credit_map owed_credits_;
+
  protected:
   struct vote_result {
     int vote;
-    thread_safe_set<int> failed_ranks;
-    vote_result(int v, const thread_safe_set<int>& f) :
-      vote(v), failed_ranks(f)
+    /** The epoch in #failure_log_ holding the failures of the context */
+    int epoch;
+    vote_result(int v, int e) :
+      vote(v), epoch(e)
     {
     }
-    vote_result() : vote(0) {}
+    vote_result() : vote(0), epoch(0) {}
   };
   typedef std::map<int, vote_result> vote_map;
   vote_map votes_done_;
 
+  /** Every context's failures, stored once as deltas between epochs */
+  failure_log failure_log_;
+
+  void
+  forget_rank_map(int context);
+
+  /** Rank maps on the global domain, indexed by context */
+  std::map<int, dense_rank_map> rank_maps_;
+
   bool inited_;
   
   bool finalized_;
@@ -676,6 +1011,8 @@ class transport :
   
   int eager_cutoff_;
 
+  int vote_radix_;
+
   bool lazy_watch_;
 
   activity_monitor* monitor_;
@@ -698,10 +1035,44 @@ class transport :
 
   bool use_hardware_ack_;
 
+  /** Number of eager slots each sender gets at each receiver, 0 disables flow control */
+  int eager_credits_;
+
+  /** Return credits explicitly once this many are owed to a sender */
+  int eager_credit_return_;
+
+  /** Whether small messages to the same destination are packed into a single send */
+  bool smsg_coalesce_;
+
+  /** Flush a destination once its packed messages reach this many bytes */
+  long smsg_coalesce_bytes_;
+
+  /** Flush a destination once this many messages are packed */
+  int smsg_coalesce_count_;
+
+  /** Flush a destination once its oldest packed message has waited this long */
+  double smsg_coalesce_delay_;
+
   domain* global_domain_;
 
   int nspares_;
 
+  /** The working slots, replaced (never modified) on each substitution
+      so collectives already running keep a consistent view */
+  spare_domain* work_domain_;
+
+  /** Every working domain ever built, owned here since collectives
+      still running may hold a replaced one */
+  std::vector<spare_domain*> work_domains_;
+
+  /** Live spares not yet holding a slot */
+  rank_set spare_pool_;
+
+  /** How long an idle spare waits between progress checks */
+  double spare_poll_interval_;
+
+  registration_cache* reg_cache_;
+
 #if SPKT_USE_SPINLOCK
   spin_thread_lock lock_;
 #else
@@ -0,0 +1,267 @@
+#include <sumi/wire_header.h>
+#include <sumi/collective_message.h>
+#include <sumi/transport.h>
+#include <sprockit/serializer.h>
+#include <sprockit/errors.h>
+#include <typeinfo>
+#include <cstring>
+
+namespace sumi {
+
+#define enumcase(x) case x: return #x
+
+const char*
+wire_header::tostr(format_t fmt)
+{
+  switch(fmt)
+  {
+  enumcase(plain);
+  enumcase(rdma);
+  enumcase(collective_eager);
+  enumcase(collective_rdma);
+  enumcase(serialized);
+  }
+  spkt_throw_printf(sprockit::value_error,
+    "wire_header::invalid format %d", fmt);
+}
+
+wire_header::format_t
+wire_header::pick_format(const message* msg)
+{
+  //exact types only - a subclass may carry more state than the header
+  const std::type_info& ty = typeid(*msg);
+  if (ty == typeid(message)){
+    return plain;
+  } else if (ty == typeid(rdma_message)){
+    return rdma;
+  } else if (ty == typeid(collective_eager_message)){
+    const collective_eager_message* cmsg = static_cast<const collective_eager_message*>(msg);
+    return cmsg->failed_procs().empty() ? collective_eager : serialized;
+  } else if (ty == typeid(collective_rdma_message)){
+    const collective_rdma_message* cmsg = static_cast<const collective_rdma_message*>(msg);
+    return cmsg->failed_procs().empty() ? collective_rdma : serialized;
+  } else {
+    return serialized;
+  }
+}
+
+size_t
+wire_header::packed_size(const message::ptr& msg)
+{
+  message* m = msg.get();
+  switch (pick_format(m))
+  {
+  case plain:
+    return sizeof(wire_header);
+  case rdma:
+  case collective_rdma:
+    return sizeof(wire_header) + 2*sizeof(public_buffer);
+  case collective_eager:
+    return sizeof(wire_header) + (m->eager_buffer() ? m->byte_length() : 0);
+  case serialized: {
+    sprockit::serializer ser;
+    ser.start_sizing();
+    message::ptr tmp = msg;
+    ser & tmp;
+    return sizeof(wire_header) + ser.size();
+  }
+  }
+  return 0;
+}
+
+static void
+pack_base(const message* msg, wire_header* hdr)
+{
+  hdr->class_type = msg->class_type();
+  hdr->payload_type = msg->payload_type();
+  hdr->flags = 0;
+  if (msg->needs_send_ack()) hdr->flags |= wire_header::needs_send_ack_flag;
+  if (msg->needs_recv_ack()) hdr->flags |= wire_header::needs_recv_ack_flag;
+  hdr->sender = msg->sender();
+  hdr->recver = msg->recver();
+  hdr->transaction_id = msg->transaction_id();
+  hdr->credits = msg->credits();
+  hdr->num_bytes = msg->byte_length();
+}
+
+static void
+pack_collective(const collective_work_message* msg, wire_header* hdr)
+{
+  hdr->collective_type = msg->type();
+  hdr->action = msg->action();
+  hdr->tag = msg->tag();
+  hdr->round = msg->round();
+  hdr->dense_sender = msg->dense_sender();
+  hdr->dense_recver = msg->dense_recver();
+  hdr->nelems = msg->nelems();
+}
+
+static void
+unpack_base(const wire_header* hdr, message* msg)
+{
+  msg->set_class_type((message::class_t) hdr->class_type);
+  msg->set_payload_type((message::payload_type_t) hdr->payload_type);
+  msg->set_needs_send_ack(hdr->flags & wire_header::needs_send_ack_flag);
+  msg->set_needs_recv_ack(hdr->flags & wire_header::needs_recv_ack_flag);
+  msg->set_sender(hdr->sender);
+  msg->set_recver(hdr->recver);
+  msg->set_transaction_id(hdr->transaction_id);
+  msg->set_credits(hdr->credits);
+  msg->set_byte_length(hdr->num_bytes);
+}
+
+static bool
+check_fits(size_t needed, size_t max_size, bool must_fit)
+{
+  if (needed <= max_size){
+    return true;
+  } else if (must_fit){
+    spkt_throw_printf(sprockit::value_error,
+      "wire_header::pack: message needs %lu bytes, buffer only has %lu",
+      needed, max_size);
+  }
+  return false;
+}
+
+size_t
+wire_header::pack(const message::ptr& msg, char* buf, size_t max_size)
+{
+  return pack(msg, buf, max_size, true);
+}
+
+size_t
+wire_header::pack_if_fits(const message::ptr& msg, char* buf, size_t max_size)
+{
+  return pack(msg, buf, max_size, false);
+}
+
+size_t
+wire_header::pack(const message::ptr& msg, char* buf, size_t max_size, bool must_fit)
+{
+  if (!check_fits(sizeof(wire_header), max_size, must_fit)){
+    return 0;
+  }
+  message* m = msg.get();
+  wire_header* hdr = reinterpret_cast<wire_header*>(buf);
+  ::memset(hdr, 0, sizeof(wire_header));
+  hdr->version = current_version;
+  format_t fmt = pick_format(m);
+  hdr->format = fmt;
+  char* body = buf + sizeof(wire_header);
+
+  switch (fmt)
+  {
+  case plain:
+    pack_base(m, hdr);
+    return sizeof(wire_header);
+  case rdma:
+  case collective_rdma: {
+    //the whole struct, transports such as gni keep memory handles next to the pointer
+    size_t bufs_size = 2*sizeof(public_buffer);
+    if (!check_fits(sizeof(wire_header) + bufs_size, max_size, must_fit)){
+      return 0;
+    }
+    pack_base(m, hdr);
+    if (fmt == collective_rdma){
+      pack_collective(static_cast<collective_work_message*>(m), hdr);
+    }
+    ::memcpy(body, &m->local_buffer(), sizeof(public_buffer));
+    ::memcpy(body + sizeof(public_buffer), &m->remote_buffer(), sizeof(public_buffer));
+    return sizeof(wire_header) + bufs_size;
+  }
+  case collective_eager: {
+    pack_base(m, hdr);
+    pack_collective(static_cast<collective_work_message*>(m), hdr);
+    void* payload = m->eager_buffer();
+    if (!payload){
+      return sizeof(wire_header);
+    }
+    if (!check_fits(sizeof(wire_header) + m->byte_length(), max_size, must_fit)){
+      return 0;
+    }
+    hdr->flags |= has_payload_flag;
+    ::memcpy(body, payload, m->byte_length());
+    return sizeof(wire_header) + m->byte_length();
+  }
+  case serialized: {
+    sprockit::serializer ser;
+    message::ptr tmp = msg;
+    ser.start_sizing();
+    ser & tmp;
+    size_t size = ser.size();
+    if (!check_fits(sizeof(wire_header) + size, max_size, must_fit)){
+      return 0;
+    }
+    ser.start_packing(body, size);
+    ser & tmp;
+    return sizeof(wire_header) + size;
+  }
+  }
+  return 0;
+}
+
+message::ptr
+wire_header::unpack(const char* buf, size_t size, transport* t)
+{
+  const wire_header* hdr = peek(buf);
+  if (hdr->version != current_version){
+    spkt_throw_printf(sprockit::value_error,
+      "wire_header::unpack: got version %d, expected %d",
+      hdr->version, current_version);
+  }
+
+  const char* body = buf + sizeof(wire_header);
+  switch (hdr->format)
+  {
+  case plain: {
+    message* msg = new message;
+    unpack_base(hdr, msg);
+    return msg;
+  }
+  case rdma:
+  case collective_rdma: {
+    message* msg;
+    if (hdr->format == rdma){
+      msg = new rdma_message;
+    } else {
+      msg = new collective_rdma_message(
+        (collective::type_t) hdr->collective_type,
+        (collective_work_message::action_t) hdr->action,
+        hdr->nelems, 0, hdr->tag, hdr->round,
+        hdr->dense_sender, hdr->dense_recver);
+    }
+    unpack_base(hdr, msg);
+    ::memcpy(&msg->local_buffer(), body, sizeof(public_buffer));
+    ::memcpy(&msg->remote_buffer(), body + sizeof(public_buffer), sizeof(public_buffer));
+    return msg;
+  }
+  case collective_eager: {
+    collective_work_message::ptr msg = new collective_eager_message(
+      (collective::type_t) hdr->collective_type,
+      (collective_work_message::action_t) hdr->action,
+      0, hdr->nelems, 0, hdr->tag, hdr->round,
+      hdr->dense_sender, hdr->dense_recver);
+    unpack_base(hdr, msg.get());
+    if (hdr->flags & has_payload_flag){
+      void* payload = t ? t->eager_landing_zone(msg) : 0;
+      if (!payload){
+        payload = new char[hdr->num_bytes];
+      }
+      ::memcpy(payload, body, hdr->num_bytes);
+      msg->eager_buffer() = payload;
+    }
+    return msg;
+  }
+  case serialized: {
+    sprockit::serializer ser;
+    ser.start_unpacking(const_cast<char*>(body), size - sizeof(wire_header));
+    message::ptr msg;
+    ser & msg;
+    return msg;
+  }
+  }
+  spkt_throw_printf(sprockit::value_error,
+    "wire_header::unpack: invalid format %d", hdr->format);
+}
+
+}
@@ -0,0 +1,106 @@
+#ifndef sumi_WIRE_HEADER_H
+#define sumi_WIRE_HEADER_H
+
+#include <sumi/message.h>
+#include <sumi/transport_fwd.h>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace sumi {
+
+/**
+ * @struct wire_header
+ * Fixed-layout header put on the wire in front of every message.
+ * Plain messages and collective messages that carry no failure set
+ * are described completely by the header (plus RDMA buffers or the eager
+ * payload right behind it) and can be read in place by the receiver.
+ * Anything else falls back to full object serialization after the header.
+ */
+struct wire_header
+{
+  typedef enum {
+    plain,
+    rdma,
+    collective_eager,
+    collective_rdma,
+    serialized
+  } format_t;
+
+  static const uint8_t current_version = 2;
+
+  static const uint8_t needs_send_ack_flag = 1;
+  static const uint8_t needs_recv_ack_flag = 2;
+  static const uint8_t has_payload_flag = 4;
+
+  uint8_t version;
+  uint8_t format;
+  uint8_t class_type;
+  uint8_t payload_type;
+  uint8_t flags;
+  uint8_t collective_type;
+  uint8_t action;
+  uint8_t pad;
+  int32_t sender;
+  int32_t recver;
+  int32_t transaction_id;
+  int32_t credits;
+  int32_t tag;
+  int32_t round;
+  int32_t dense_sender;
+  int32_t dense_recver;
+  int32_t nelems;
+  int32_t pad2;
+  int64_t num_bytes;
+
+  /**
+   * Look at the header of a packed message without decoding anything
+   */
+  static const wire_header*
+  peek(const char* buf) {
+    return reinterpret_cast<const wire_header*>(buf);
+  }
+
+  /**
+   * @return The number of bytes #pack will write for the message
+   */
+  static size_t
+  packed_size(const message::ptr& msg);
+
+  /**
+   * @param buf Must hold at least #packed_size bytes
+   * @param max_size The capacity of buf, an error is thrown if exceeded
+   * @return The number of bytes written
+   */
+  static size_t
+  pack(const message::ptr& msg, char* buf, size_t max_size);
+
+  /**
+   * Same as #pack, but a message that does not fit is not an error
+   * @return The number of bytes written, 0 if the message does not fit
+   */
+  static size_t
+  pack_if_fits(const message::ptr& msg, char* buf, size_t max_size);
+
+  /**
+   * @param size Bytes available in buf, only needed as a bound
+   * @param t  If given, eager collective payloads are decoded straight
+   *           into the location returned by transport::eager_landing_zone
+   */
+  static message::ptr
+  unpack(const char* buf, size_t size, transport* t = 0);
+
+  static const char*
+  tostr(format_t fmt);
+
+ private:
+  static format_t
+  pick_format(const message* msg);
+
+  static size_t
+  pack(const message::ptr& msg, char* buf, size_t max_size, bool must_fit);
+
+};
+
+}
+
+#endif // sumi_WIRE_HEADER_H
@@ -0,0 +1,919 @@
+#include <tcp/tcp_transport.h>
+#include <sumi/wire_header.h>
+#include <sprockit/serializer.h>
+#include <sprockit/sim_parameters.h>
+#include <sprockit/keyword_registration.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fstream>
+#include <sstream>
+
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#include <linux/errqueue.h>
+#define SUMI_TCP_ZEROCOPY 1
+#else
+#define SUMI_TCP_ZEROCOPY 0
+#endif
+
+#define tcp_debug_out(...) \
+  debug_printf(sprockit::dbg::tcp, "Rank %d: %s at t=%8.4e", rank(), sprockit::printf(__VA_ARGS__).c_str(), wall_time())
+
+DeclareDebugSlot(tcp);
+RegisterDebugSlot(tcp);
+
+RegisterKeywords(
+  "tcp_rank",
+  "tcp_nproc",
+  "tcp_hostfile",
+  "tcp_base_port",
+  "tcp_zerocopy_threshold",
+  "tcp_connect_timeout"
+);
+
+namespace sumi {
+
+SpktRegister("tcp", transport, tcp_transport,
+            "Create a SUMI transport over TCP sockets");
+
+#define enumcase(x) case x: return #x
+
+const char*
+tcp_frame::tostr(type_t ty)
+{
+  switch(ty)
+  {
+  enumcase(smsg);
+  enumcase(rdma_put);
+  enumcase(rdma_get_request);
+  enumcase(rdma_get_response);
+  enumcase(ping_request);
+  enumcase(ping_response);
+  enumcase(finalize);
+  }
+  return "unknown";
+}
+
+static int
+env_int(const char* name, int deflt)
+{
+  const char* str = getenv(name);
+  return str ? atoi(str) : deflt;
+}
+
+static void
+set_nonblocking(int fd)
+{
+  int flags = fcntl(fd, F_GETFL, 0);
+  fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static void
+set_nodelay(int fd)
+{
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(int));
+}
+
+tcp_connection::tcp_connection(int f, int p, bool out) :
+  fd(f),
+  peer(p),
+  outgoing(out),
+  failed(false),
+  connecting(false),
+  connect_deadline(0),
+  retry_time(0),
+  want_write(false),
+  zerocopy(false),
+  zerocopy_next_seq(0),
+  state(out ? recv_header : recv_rank),
+  peer_rank(-1),
+  offset(0),
+  payload(0)
+{
+}
+
+tcp_transport::tcp_transport() :
+ listen_fd_(-1),
+ epoll_fd_(-1),
+ ping_status_(i_am_alive),
+ zerocopy_threshold_(65536),
+ connect_timeout_(30),
+ base_port_(23400),
+ num_finalize_recvd_(0),
+ finalize_released_(false)
+{
+}
+
+tcp_transport::~tcp_transport()
+{
+}
+
+void
+tcp_transport::init_factory_params(sprockit::sim_parameters* params)
+{
+  active_msg_transport::init_factory_params(params);
+  //the launcher is expected to export these if not given as params
+  rank_ = params->get_optional_int_param("tcp_rank", env_int("SUMI_TCP_RANK", -1));
+  nproc_ = params->get_optional_int_param("tcp_nproc", env_int("SUMI_TCP_NPROC", -1));
+  base_port_ = params->get_optional_int_param("tcp_base_port",
+                  env_int("SUMI_TCP_BASE_PORT", 23400));
+  zerocopy_threshold_ = params->get_optional_byte_length_param("tcp_zerocopy_threshold", 65536);
+  connect_timeout_ = params->get_optional_time_param("tcp_connect_timeout", 30);
+
+  if (rank_ < 0 || nproc_ <= 0 || rank_ >= nproc_){
+    spkt_throw_printf(sprockit::value_error,
+      "tcp_transport: invalid rank %d of %d - set tcp_rank/tcp_nproc "
+      "or SUMI_TCP_RANK/SUMI_TCP_NPROC",
+      rank_, nproc_);
+  }
+
+  hosts_.resize(nproc_);
+  ports_.resize(nproc_);
+  for (int i=0; i < nproc_; ++i){
+    hosts_[i] = "127.0.0.1";
+    ports_[i] = base_port_ + i;
+  }
+
+  const char* hostfile = getenv("SUMI_TCP_HOSTFILE");
+  std::string fname = params->get_optional_param("tcp_hostfile", hostfile ? hostfile : "");
+  if (!fname.empty()){
+    read_hostfile(fname);
+  }
+}
+
+void
+tcp_transport::read_hostfile(const std::string& fname)
+{
+  //one line per rank: host [port], port defaults to base port + rank
+  std::ifstream in(fname.c_str());
+  if (!in.is_open()){
+    spkt_throw_printf(sprockit::value_error,
+      "tcp_transport: could not open hostfile %s",
+      fname.c_str());
+  }
+
+  int rank = 0;
+  std::string line;
+  while (rank < nproc_ && std::getline(in, line)){
+    std::istringstream sstr(line);
+    std::string host;
+    if (!(sstr >> host) || host[0] == '#'){
+      continue;
+    }
+    int port;
+    if (sstr >> port){
+      ports_[rank] = port;
+    }
+    hosts_[rank] = host;
+    ++rank;
+  }
+
+  if (rank < nproc_){
+    spkt_throw_printf(sprockit::value_error,
+      "tcp_transport: hostfile %s has %d entries, need %d",
+      fname.c_str(), rank, nproc_);
+  }
+}
+
+void
+tcp_transport::start_listening()
+{
+  listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(int));
+
+  sockaddr_in addr;
+  ::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(ports_[rank_]);
+  if (bind(listen_fd_, (sockaddr*) &addr, sizeof(addr)) != 0
+    || listen(listen_fd_, 128) != 0){
+    spkt_throw_printf(sprockit::value_error,
+      "tcp_transport: rank %d could not listen on port %d: %s",
+      rank_, ports_[rank_], strerror(errno));
+  }
+  set_nonblocking(listen_fd_);
+
+  epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = 0;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &ev);
+}
+
+void
+tcp_transport::init()
+{
+  epoll_fd_ = epoll_create1(0);
+  if (epoll_fd_ < 0){
+    spkt_throw_printf(sprockit::value_error,
+      "tcp_transport: epoll_create failed: %s",
+      strerror(errno));
+  }
+  out_conns_.resize(nproc_, 0);
+  start_listening();
+  active_msg_transport::init();
+  tcp_debug_out("listening on port %d", ports_[rank_]);
+}
+
+tcp_connection*
+tcp_transport::connection_to(int dst)
+{
+  tcp_connection* conn = out_conns_[dst];
+  if (conn){
+    return conn;
+  }
+
+  //connect lazily - most ranks only ever talk to a few peers
+  char port_str[16];
+  sprintf(port_str, "%d", ports_[dst]);
+  addrinfo hints;
+  ::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* res = 0;
+  if (getaddrinfo(hosts_[dst].c_str(), port_str, &hints, &res) != 0){
+    spkt_throw_printf(sprockit::value_error,
+      "tcp_transport: could not resolve host %s for rank %d",
+      hosts_[dst].c_str(), dst);
+  }
+
+  conn = new tcp_connection(-1, dst, true);
+  out_conns_[dst] = conn;
+  ::memcpy(&conn->addr, res->ai_addr, sizeof(sockaddr_in));
+  freeaddrinfo(res);
+
+  //the peer may not be listening yet
+  conn->connecting = true;
+  conn->connect_deadline = wall_time() + connect_timeout_;
+  start_connect(conn);
+  return conn;
+}
+
+void
+tcp_transport::start_connect(tcp_connection* conn)
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  set_nonblocking(fd);
+  if (connect(fd, (sockaddr*) &conn->addr, sizeof(sockaddr_in)) != 0
+    && errno != EINPROGRESS){
+    ::close(fd);
+    retry_connect(conn);
+    return;
+  }
+
+  //epoll reports the socket writable once the connect completes or fails
+  conn->fd = fd;
+  conn->want_write = true;
+  epoll_event ev;
+  ev.events = EPOLLOUT;
+  ev.data.ptr = conn;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+}
+
+void
+tcp_transport::retry_connect(tcp_connection* conn)
+{
+  if (conn->fd >= 0){
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, conn->fd, 0);
+    ::close(conn->fd);
+    conn->fd = -1;
+  }
+  conn->want_write = false;
+
+  double now = wall_time();
+  if (now > conn->connect_deadline){
+    tcp_debug_out("failed connecting to %d at %s:%d",
+      conn->peer, hosts_[conn->peer].c_str(), ports_[conn->peer]);
+    connection_failed(conn);
+    return;
+  }
+  conn->retry_time = now + 0.01;
+  retry_conns_.push_back(conn);
+}
+
+void
+tcp_transport::retry_connects()
+{
+  double now = wall_time();
+  std::list<tcp_connection*>::iterator it = retry_conns_.begin();
+  while (it != retry_conns_.end()){
+    tcp_connection* conn = *it;
+    if (conn->retry_time <= now){
+      it = retry_conns_.erase(it);
+      start_connect(conn);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void
+tcp_transport::finish_connect(tcp_connection* conn)
+{
+  int err = 0;
+  socklen_t len = sizeof(int);
+  getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+  if (err != 0){
+    retry_connect(conn);
+    return;
+  }
+
+  conn->connecting = false;
+  set_nodelay(conn->fd);
+  //identify ourselves before anything else goes on the wire
+  //the send buffer of a fresh connection always has room for this
+  int32_t me = rank_;
+  if (::send(conn->fd, &me, sizeof(int32_t), MSG_NOSIGNAL) != sizeof(int32_t)){
+    connection_failed(conn);
+    return;
+  }
+
+#if SUMI_TCP_ZEROCOPY
+  if (zerocopy_threshold_ > 0){
+    int one = 1;
+    conn->zerocopy = setsockopt(conn->fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(int)) == 0;
+  }
+#endif
+
+  tcp_debug_out("connected to %d at %s:%d",
+    conn->peer, hosts_[conn->peer].c_str(), ports_[conn->peer]);
+  progress_sends(conn);
+}
+
+void
+tcp_transport::accept_connections()
+{
+  while (true){
+    int fd = accept(listen_fd_, 0, 0);
+    if (fd < 0){
+      return;
+    }
+    set_nodelay(fd);
+    set_nonblocking(fd);
+
+    //the peer sends its rank right after connecting, read with the frames
+    tcp_connection* conn = new tcp_connection(fd, -1, false);
+    in_conns_[fd] = conn;
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = conn;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+  }
+}
+
+void
+tcp_transport::watch(tcp_connection* conn, bool write)
+{
+  if (conn->want_write == write){
+    return;
+  }
+  conn->want_write = write;
+  epoll_event ev;
+  ev.events = write ? (uint32_t) EPOLLOUT : 0;
+  ev.data.ptr = conn;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, conn->fd, &ev);
+}
+
+void
+tcp_transport::post_send(int dst, tcp_frame::type_t ty, const message::ptr& msg,
+                         void* payload, uint64_t payload_size,
+                         const message::ptr& done_msg, uint32_t status)
+{
+  tcp_connection* conn = connection_to(dst);
+  if (conn->failed){
+    tcp_debug_out("dropping %s to failed rank %d",
+      tcp_frame::tostr(ty), dst);
+    if (ty == tcp_frame::ping_request){
+      ping_response(dst, false);
+    }
+    return;
+  }
+
+  tcp_send* send = new tcp_send;
+  send->frame.type = ty;
+  send->frame.status = status;
+  send->frame.msg_size = 0;
+  send->frame.payload_size = payload_size;
+  send->payload = (char*) payload;
+  send->offset = 0;
+  send->done_msg = done_msg;
+  send->zerocopy_seq = -1;
+
+  if (msg){
+    send->msg_buf.resize(wire_header::packed_size(msg));
+    wire_header::pack(msg, &send->msg_buf[0], send->msg_buf.size());
+    send->frame.msg_size = send->msg_buf.size();
+  }
+
+  tcp_debug_out("post %s to %d with message of %u bytes, payload of %lu bytes",
+    tcp_frame::tostr(ty), dst, send->frame.msg_size, payload_size);
+
+  conn->sends.push_back(send);
+  if (conn->sends.size() == 1 && !conn->connecting){
+    progress_sends(conn);
+  }
+}
+
+void
+tcp_transport::progress_sends(tcp_connection* conn)
+{
+  while (!conn->sends.empty()){
+    tcp_send* send = conn->sends.front();
+    uint64_t header_size = sizeof(tcp_frame) + send->frame.msg_size;
+    bool zerocopy = conn->zerocopy
+      && send->frame.payload_size >= zerocopy_threshold_;
+
+    ssize_t rc;
+    if (zerocopy && send->offset >= header_size){
+#if SUMI_TCP_ZEROCOPY
+      //the kernel pins the payload, which cannot be reused until reaped
+      uint64_t pay_offset = send->offset - header_size;
+      iovec iov;
+      iov.iov_base = send->payload + pay_offset;
+      iov.iov_len = send->frame.payload_size - pay_offset;
+      msghdr mh;
+      ::memset(&mh, 0, sizeof(mh));
+      mh.msg_iov = &iov;
+      mh.msg_iovlen = 1;
+      rc = sendmsg(conn->fd, &mh, MSG_ZEROCOPY | MSG_NOSIGNAL);
+      if (rc >= 0){
+        send->zerocopy_seq = conn->zerocopy_next_seq++;
+      }
+#else
+      rc = -1;
+#endif
+    } else {
+      //scatter-gather the header, message and payload in one call
+      char* bases[3] = { (char*) &send->frame, send->msg_buf.empty() ? 0 : &send->msg_buf[0], send->payload };
+      uint64_t sizes[3] = { sizeof(tcp_frame), send->frame.msg_size, zerocopy ? 0 : send->frame.payload_size };
+      iovec iov[3];
+      int niov = 0;
+      uint64_t skip = send->offset;
+      for (int i=0; i < 3; ++i){
+        if (skip >= sizes[i]){
+          skip -= sizes[i];
+          continue;
+        }
+        iov[niov].iov_base = bases[i] + skip;
+        iov[niov].iov_len = sizes[i] - skip;
+        skip = 0;
+        ++niov;
+      }
+      msghdr mh;
+      ::memset(&mh, 0, sizeof(mh));
+      mh.msg_iov = iov;
+      mh.msg_iovlen = niov;
+      rc = sendmsg(conn->fd, &mh, MSG_NOSIGNAL);
+    }
+
+    if (rc < 0){
+      if (errno == EINTR){
+        continue;
+      } else if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS){
+        watch(conn, true);
+        return;
+      }
+      tcp_debug_out("send to %d failed: %s", conn->peer, strerror(errno));
+      connection_failed(conn);
+      return;
+    }
+
+    send->offset += rc;
+    if (send->offset == send->total_size()){
+      conn->sends.pop_front();
+      if (send->zerocopy_seq >= 0){
+        conn->zerocopy_pending.push_back(send);
+      } else {
+        send_done(send);
+      }
+    }
+  }
+  watch(conn, false);
+}
+
+void
+tcp_transport::send_done(tcp_send* send)
+{
+  if (send->done_msg){
+    //never call up into handle from inside a send
+    completions_.push_back(send->done_msg);
+  }
+  delete send;
+}
+
+void
+tcp_transport::reap_zerocopy(tcp_connection* conn)
+{
+#if SUMI_TCP_ZEROCOPY
+  while (!conn->zerocopy_pending.empty()){
+    char control[128];
+    msghdr mh;
+    ::memset(&mh, 0, sizeof(mh));
+    mh.msg_control = control;
+    mh.msg_controllen = sizeof(control);
+    if (recvmsg(conn->fd, &mh, MSG_ERRQUEUE) < 0){
+      return;
+    }
+
+    cmsghdr* cm = CMSG_FIRSTHDR(&mh);
+    if (!cm){
+      return;
+    }
+    sock_extended_err* serr = (sock_extended_err*) CMSG_DATA(cm);
+    if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY){
+      continue;
+    }
+
+    //completions cover the inclusive range [ee_info, ee_data]
+    int64_t last = serr->ee_data;
+    while (!conn->zerocopy_pending.empty()
+      && conn->zerocopy_pending.front()->zerocopy_seq <= last){
+      send_done(conn->zerocopy_pending.front());
+      conn->zerocopy_pending.pop_front();
+    }
+  }
+#endif
+}
+
+void
+tcp_transport::flush_sends()
+{
+  bool pending = true;
+  while (pending){
+    pending = false;
+    for (int i=0; i < nproc_; ++i){
+      tcp_connection* conn = out_conns_[i];
+      if (conn && !conn->failed
+        && (!conn->sends.empty() || !conn->zerocopy_pending.empty())){
+        pending = true;
+      }
+    }
+    if (pending){
+      block_inner_loop();
+    }
+  }
+}
+
+void
+tcp_transport::progress_recv(tcp_connection* conn)
+{
+  while (true){
+    char* buf;
+    uint64_t size;
+    switch (conn->state)
+    {
+    case tcp_connection::recv_rank:
+      buf = (char*) &conn->peer_rank;
+      size = sizeof(int32_t);
+      break;
+    case tcp_connection::recv_header:
+      buf = (char*) &conn->frame;
+      size = sizeof(tcp_frame);
+      break;
+    case tcp_connection::recv_msg:
+      buf = &conn->msg_buf[0];
+      size = conn->frame.msg_size;
+      break;
+    case tcp_connection::recv_payload:
+      buf = conn->payload;
+      size = conn->frame.payload_size;
+      break;
+    }
+
+    ssize_t rc = recv(conn->fd, buf + conn->offset, size - conn->offset, 0);
+    if (rc == 0){
+      tcp_debug_out("connection from %d closed", conn->peer);
+      close_connection(conn);
+      return;
+    } else if (rc < 0){
+      if (errno == EINTR){
+        continue;
+      } else if (errno != EAGAIN && errno != EWOULDBLOCK){
+        tcp_debug_out("recv from %d failed: %s", conn->peer, strerror(errno));
+        close_connection(conn);
+      }
+      return;
+    }
+
+    conn->offset += rc;
+    if (conn->offset < size){
+      continue;
+    }
+
+    conn->offset = 0;
+    if (conn->state == tcp_connection::recv_rank){
+      conn->peer = conn->peer_rank;
+      conn->state = tcp_connection::recv_header;
+      tcp_debug_out("accepted connection from %d", conn->peer);
+      continue;
+    }
+
+    if (conn->state == tcp_connection::recv_header && conn->frame.msg_size > 0){
+      conn->msg_buf.resize(conn->frame.msg_size);
+      conn->state = tcp_connection::recv_msg;
+      continue;
+    }
+
+    if (conn->state == tcp_connection::recv_msg){
+      conn->msg = wire_header::unpack(&conn->msg_buf[0], conn->frame.msg_size, this);
+    }
+
+    if (conn->state != tcp_connection::recv_payload && conn->frame.payload_size > 0){
+      //land the payload directly in its final buffer
+      if (conn->frame.type == tcp_frame::rdma_put){
+        conn->payload = (char*) conn->msg->remote_buffer().ptr;
+      } else {
+        conn->payload = (char*) conn->msg->local_buffer().ptr;
+      }
+      conn->state = tcp_connection::recv_payload;
+      continue;
+    }
+
+    frame_done(conn);
+  }
+}
+
+void
+tcp_transport::frame_done(tcp_connection* conn)
+{
+  message::ptr msg = conn->msg;
+  tcp_frame::type_t ty = (tcp_frame::type_t) conn->frame.type;
+  int src = conn->peer;
+  conn->state = tcp_connection::recv_header;
+  conn->msg = 0;
+  conn->payload = 0;
+
+  tcp_debug_out("received %s from %d", tcp_frame::tostr(ty), src);
+
+  switch(ty)
+  {
+  case tcp_frame::smsg:
+    CHECK_IF_I_AM_DEAD(return);
+    handle(msg);
+    break;
+  case tcp_frame::rdma_put:
+    CHECK_IF_I_AM_DEAD(return);
+    if (msg->needs_recv_ack()){
+      handle(msg);
+    }
+    break;
+  case tcp_frame::rdma_get_request: {
+    CHECK_IF_I_AM_DEAD(return);
+    //this msg is from the perspective of the request issuer
+    //it is packed on post, so it can be passed back up as the ack
+    bool ack = msg->needs_send_ack();
+    post_send(src, tcp_frame::rdma_get_response, msg,
+              msg->remote_buffer().ptr, msg->byte_length(),
+              ack ? msg : message::ptr());
+    msg->set_payload_type(message::rdma_get_ack);
+    break;
+  }
+  case tcp_frame::rdma_get_response:
+    CHECK_IF_I_AM_DEAD(return);
+    if (msg->needs_recv_ack()){
+      msg->set_payload_type(message::rdma_get);
+      handle(msg);
+    }
+    break;
+  case tcp_frame::ping_request:
+    post_send(src, tcp_frame::ping_response, message::ptr(),
+              0, 0, message::ptr(), (uint32_t) ping_status_);
+    break;
+  case tcp_frame::ping_response:
+    --pings_out_[src];
+    ping_response(src, conn->frame.status == (uint32_t) i_am_alive);
+    break;
+  case tcp_frame::finalize:
+    if (rank_ == 0){
+      ++num_finalize_recvd_;
+    } else {
+      finalize_released_ = true;
+    }
+    break;
+  }
+}
+
+void
+tcp_transport::ping_response(int src, bool alive)
+{
+  message::ptr ping_msg = new message;
+  ping_msg->set_sender(src);
+  ping_msg->set_recver(rank_);
+  ping_msg->set_class_type(message::ping);
+  if (alive){
+    ping_msg->set_payload_type(message::rdma_get);
+  } else {
+    //oh no! he done died!
+    ping_msg->set_payload_type(message::rdma_get_nack);
+  }
+  completions_.push_back(ping_msg);
+}
+
+void
+tcp_transport::connection_failed(tcp_connection* conn)
+{
+  conn->failed = true;
+  conn->connecting = false;
+  if (conn->fd >= 0){
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, conn->fd, 0);
+    ::close(conn->fd);
+    conn->fd = -1;
+  }
+
+  std::list<tcp_send*>::iterator it, end = conn->sends.end();
+  for (it=conn->sends.begin(); it != end; ++it){
+    delete *it;
+  }
+  conn->sends.clear();
+  end = conn->zerocopy_pending.end();
+  for (it=conn->zerocopy_pending.begin(); it != end; ++it){
+    delete *it;
+  }
+  conn->zerocopy_pending.clear();
+
+  //anyone waiting on this peer hears it is dead
+  int num_pings = pings_out_[conn->peer];
+  for (int i=0; i < num_pings; ++i){
+    ping_response(conn->peer, false);
+  }
+  pings_out_[conn->peer] = 0;
+}
+
+void
+tcp_transport::close_connection(tcp_connection* conn)
+{
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, conn->fd, 0);
+  ::close(conn->fd);
+  in_conns_.erase(conn->fd);
+  delete conn;
+}
+
+void
+tcp_transport::block_inner_loop()
+{
+  static const int max_events = 64;
+  epoll_event events[max_events];
+  int timeout_ms = completions_.empty() ? 1 : 0;
+  int nevents = epoll_wait(epoll_fd_, events, max_events, timeout_ms);
+  if (!retry_conns_.empty()){
+    retry_connects();
+  }
+  for (int i=0; i < nevents; ++i){
+    tcp_connection* conn = (tcp_connection*) events[i].data.ptr;
+    if (!conn){
+      accept_connections();
+    } else if (!conn->outgoing){
+      progress_recv(conn);
+    } else if (conn->connecting){
+      finish_connect(conn);
+    } else if (!conn->failed){
+      if (events[i].events & EPOLLERR){
+        //zero-copy completions are also delivered as errors
+        reap_zerocopy(conn);
+        int err = 0;
+        socklen_t len = sizeof(int);
+        getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err != 0){
+          connection_failed(conn);
+          continue;
+        }
+      }
+      if (events[i].events & EPOLLHUP){
+        connection_failed(conn);
+      } else if (events[i].events & EPOLLOUT){
+        progress_sends(conn);
+      }
+    }
+  }
+
+  while (!completions_.empty()){
+    message::ptr msg = completions_.front();
+    completions_.pop_front();
+    handle(msg);
+  }
+
+  maybe_do_heartbeat();
+  renew_pings();
+}
+
+void
+tcp_transport::do_smsg_send(int dst, const message::ptr &msg)
+{
+  CHECK_IF_I_AM_DEAD(return);
+  tcp_debug_out("smsg send %s to %d", msg->to_string().c_str(), dst);
+  post_send(dst, tcp_frame::smsg, msg);
+}
+
+void
+tcp_transport::do_send_terminate(int dst)
+{
+  tcp_debug_out("send terminate request to %d", dst);
+  message::ptr msg = new message;
+  msg->set_class_type(message::terminate);
+  post_send(dst, tcp_frame::smsg, msg);
+}
+
+void
+tcp_transport::do_send_ping_request(int dst)
+{
+  tcp_debug_out("send ping request to %d", dst);
+  ++pings_out_[dst];
+  post_send(dst, tcp_frame::ping_request, message::ptr());
+}
+
+void
+tcp_transport::do_rdma_get(int src, const message::ptr &msg)
+{
+  CHECK_IF_I_AM_DEAD(return);
+  tcp_debug_out("rdma get %s from %d", msg->to_string().c_str(), src);
+  //the peer writes the data back, landing directly in our local buffer
+  post_send(src, tcp_frame::rdma_get_request, msg);
+}
+
+void
+tcp_transport::do_rdma_put(int dst, const message::ptr &msg)
+{
+  CHECK_IF_I_AM_DEAD(return);
+  tcp_debug_out("rdma put %s to %d", msg->to_string().c_str(), dst);
+  message::ptr ack;
+  if (msg->needs_send_ack()){
+    ack = msg->clone_msg();
+    ack->set_payload_type(message::rdma_put_ack);
+  }
+  post_send(dst, tcp_frame::rdma_put, msg,
+            msg->local_buffer().ptr, msg->byte_length(), ack);
+}
+
+void
+tcp_transport::do_nvram_get(int /*src*/, const message::ptr& /*msg*/)
+{
+  spkt_throw(sprockit::unimplemented_error,
+    "tcp_transport: cannot do nvram get");
+}
+
+void
+tcp_transport::go_die()
+{
+  ping_status_ = i_am_dead;
+}
+
+void
+tcp_transport::go_revive()
+{
+  ping_status_ = i_am_alive;
+}
+
+void
+tcp_transport::finalize()
+{
+  transport::finalize();
+  flush_sends();
+
+  //gather at rank 0 so nobody closes a socket a peer is still writing to
+  if (rank_ == 0){
+    while (num_finalize_recvd_ < nproc_alive() - 1){
+      block_inner_loop();
+    }
+    for (int i=1; i < nproc_; ++i){
+      if (is_alive(i)){
+        post_send(i, tcp_frame::finalize, message::ptr());
+      }
+    }
+  } else {
+    post_send(0, tcp_frame::finalize, message::ptr());
+    while (!finalize_released_){
+      block_inner_loop();
+    }
+  }
+  flush_sends();
+
+  for (int i=0; i < nproc_; ++i){
+    tcp_connection* conn = out_conns_[i];
+    if (conn){
+      if (conn->fd >= 0) ::close(conn->fd);
+      delete conn;
+    }
+  }
+  out_conns_.clear();
+  retry_conns_.clear();
+  std::map<int, tcp_connection*>::iterator it, end = in_conns_.end();
+  for (it=in_conns_.begin(); it != end; ++it){
+    ::close(it->first);
+    delete it->second;
+  }
+  in_conns_.clear();
+  ::close(listen_fd_);
+  ::close(epoll_fd_);
+}
+
+}
@@ -0,0 +1,245 @@
+#ifndef tcp_tcp_transport_h
+#define tcp_tcp_transport_h
+
+#include <sumi/active_msg_transport.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <vector>
+#include <list>
+#include <map>
+
+namespace sumi {
+
+/**
+ * @class tcp_frame
+ * Fixed header in front of everything written to a socket.
+ * The serialized message follows, then the raw RDMA payload, if any.
+ */
+struct tcp_frame
+{
+  typedef enum {
+    smsg,
+    rdma_put,
+    rdma_get_request,
+    rdma_get_response,
+    ping_request,
+    ping_response,
+    finalize
+  } type_t;
+
+  uint32_t type;
+  /** Only used for ping responses */
+  uint32_t status;
+  uint32_t msg_size;
+  uint64_t payload_size;
+
+  static const char*
+  tostr(type_t ty);
+};
+
+/**
+ * @class tcp_send
+ * A frame queued on an outgoing connection
+ */
+struct tcp_send
+{
+  tcp_frame frame;
+  std::vector<char> msg_buf;
+  char* payload;
+  /** Bytes of header+message+payload written so far */
+  uint64_t offset;
+  /** The message to pass up once the payload may be reused, if any */
+  message::ptr done_msg;
+  /** If sent zero-copy, the last kernel sequence number covering this send */
+  int64_t zerocopy_seq;
+
+  uint64_t
+  total_size() const {
+    return sizeof(tcp_frame) + frame.msg_size + frame.payload_size;
+  }
+};
+
+/**
+ * @class tcp_connection
+ * Connections are one-way: a rank only ever writes to connections it
+ * opened (lazily, on first send) and only reads from connections it
+ * accepted. Simultaneous connects therefore never race.
+ * Connects never block - sends queue up until epoll reports the
+ * socket writable, and refused connects are retried until the timeout.
+ */
+struct tcp_connection
+{
+  typedef enum {
+    recv_rank,
+    recv_header,
+    recv_msg,
+    recv_payload
+  } recv_state_t;
+
+  int fd;
+  int peer;
+  bool outgoing;
+  bool failed;
+
+  //outgoing side
+  sockaddr_in addr;
+  bool connecting;
+  /** Give up on the peer if still not connected by this time */
+  double connect_deadline;
+  double retry_time;
+  std::list<tcp_send*> sends;
+  bool want_write;
+  bool zerocopy;
+  int64_t zerocopy_next_seq;
+  std::list<tcp_send*> zerocopy_pending;
+
+  //incoming side
+  recv_state_t state;
+  /** The peer identifies itself before sending any frames */
+  int32_t peer_rank;
+  tcp_frame frame;
+  uint64_t offset;
+  std::vector<char> msg_buf;
+  message::ptr msg;
+  char* payload;
+
+  tcp_connection(int f, int p, bool out);
+};
+
+class tcp_transport :
+  public active_msg_transport
+{
+ public:
+  tcp_transport();
+
+  virtual ~tcp_transport();
+
+  void init();
+
+  void finalize();
+
+  virtual void
+  init_factory_params(sprockit::sim_parameters* params);
+
+ protected:
+  void block_inner_loop();
+
+  void do_send_terminate(int dst);
+
+  void do_send_ping_request(int dst);
+
+  void do_smsg_send(int dst, const message::ptr &msg);
+
+  void do_rdma_get(int src, const message::ptr &msg);
+
+  void do_rdma_put(int dst, const message::ptr &msg);
+
+  void do_nvram_get(int src, const message::ptr &msg);
+
+  void go_die();
+
+  void go_revive();
+
+ private:
+  void read_hostfile(const std::string& fname);
+
+  void start_listening();
+
+  tcp_connection*
+  connection_to(int dst);
+
+  void
+  start_connect(tcp_connection* conn);
+
+  void
+  finish_connect(tcp_connection* conn);
+
+  void
+  retry_connect(tcp_connection* conn);
+
+  void
+  retry_connects();
+
+  void
+  accept_connections();
+
+  void
+  watch(tcp_connection* conn, bool write);
+
+  /**
+   * @param payload   Raw bytes written directly after the message, not copied
+   * @param done_msg  Passed to #handle once the payload is no longer needed
+   */
+  void
+  post_send(int dst, tcp_frame::type_t ty, const message::ptr& msg,
+            void* payload = 0, uint64_t payload_size = 0,
+            const message::ptr& done_msg = message::ptr(),
+            uint32_t status = 0);
+
+  void
+  progress_sends(tcp_connection* conn);
+
+  void
+  flush_sends();
+
+  void
+  send_done(tcp_send* send);
+
+  void
+  reap_zerocopy(tcp_connection* conn);
+
+  void
+  progress_recv(tcp_connection* conn);
+
+  void
+  frame_done(tcp_connection* conn);
+
+  void
+  connection_failed(tcp_connection* conn);
+
+  void
+  close_connection(tcp_connection* conn);
+
+  void
+  ping_response(int src, bool alive);
+
+ private:
+  std::vector<std::string> hosts_;
+
+  std::vector<int> ports_;
+
+  int listen_fd_;
+
+  int epoll_fd_;
+
+  /** Outgoing connections, indexed by destination */
+  std::vector<tcp_connection*> out_conns_;
+
+  /** Outgoing connections waiting to retry a refused connect */
+  std::list<tcp_connection*> retry_conns_;
+
+  /** Incoming connections, keyed by fd */
+  std::map<int, tcp_connection*> in_conns_;
+
+  /** Pings awaiting a response, by destination */
+  std::map<int, int> pings_out_;
+
+  std::list<message::ptr> completions_;
+
+  ping_status_t ping_status_;
+
+  uint64_t zerocopy_threshold_;
+
+  double connect_timeout_;
+
+  int base_port_;
+
+  int num_finalize_recvd_;
+
+  bool finalize_released_;
+
+};
+
+}
+
+#endif
@@ -1,6 +1,7 @@
 
 #include <pthread.h>
 #include <sumi/transport.h>
+#include <sumi/rank_threads.h>
 #include <sprockit/sim_parameters.h>
 #include <sprockit/serializer.h>
 #include <sprockit/util.h>
@@ -22,7 +23,8 @@ run_test()
 {
   sprockit::sim_parameters params;
   params["ping_timeout"] = "100ms";
-  params["transport"] = DEFAULT_TRANSPORT;
+  const char* transport_name = getenv("SUMI_TRANSPORT");
+  params["transport"] = transport_name ? transport_name : DEFAULT_TRANSPORT;
   params["eager_cutoff"] = "0";
   transport* t = transport_factory::get_param("transport", &params);
 
@@ -67,18 +69,12 @@ run_test()
 
 int main(int argc, char** argv)
 {
-  try {
 #if DEBUG
   sprockit::debug::turn_on(DEFAULT_TRANSPORT);
   sprockit::debug::turn_on("sumi");
   sprockit::debug::turn_on("sumi_collective");
 #endif
-    run_test();
-  } catch (std::exception& e) {
-    std::cerr << e.what() << std::endl;
-    abort();
-  }
-
+  run_rank_threads(run_test);
   return 0;
 }
 
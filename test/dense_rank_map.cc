@@ -0,0 +1,159 @@
+#include <sprockit/test/test.h>
+#include <sprockit/errors.h>
+#include <sumi/dense_rank_map.h>
+#include <sumi/failure_log.h>
+#include <sumi/domain.h>
+#include <vector>
+
+using sumi::dense_rank_map;
+using sumi::rank_set;
+using sumi::failure_log;
+using sumi::subrange_domain;
+
+/**
+ * Walk every sparse rank, checking the dense numbering packs the live
+ * ranks in order and that translating back recovers the sparse rank
+ * @param failed  Which domain ranks are failed
+ */
+static void
+check_round_trip(UnitTest& unit, const char* desc, const dense_rank_map& map,
+                 const std::vector<bool>& failed)
+{
+  int nproc = failed.size();
+  int dense = 0;
+  bool dense_ok = true;
+  bool sparse_ok = true;
+  for (int sparse=0; sparse < nproc; ++sparse){
+    if (failed[sparse]) continue;
+    dense_ok = dense_ok && map.dense_rank(sparse) == dense;
+    sparse_ok = sparse_ok && map.sparse_rank(dense) == sparse;
+    ++dense;
+  }
+  std::string prefix(desc);
+  assertTrue(unit, (prefix + ": sparse to dense").c_str(), dense_ok);
+  assertTrue(unit, (prefix + ": dense to sparse").c_str(), sparse_ok);
+  assertEqual(unit, (prefix + ": dense nproc").c_str(), map.dense_rank(nproc), dense);
+}
+
+static bool
+throws_on_failed(const dense_rank_map& map, int sparse_rank)
+{
+  try {
+    map.dense_rank(sparse_rank);
+  } catch (sprockit::value_error& e) {
+    return true;
+  }
+  return false;
+}
+
+void
+test_rank_set_failures(UnitTest& unit)
+{
+  int nproc = 300;
+  std::vector<bool> failed(nproc, false);
+  rank_set failed_set;
+
+  dense_rank_map empty(failed_set);
+  check_round_trip(unit, "no failures", empty, failed);
+
+  //scattered, a whole word, a run across a word boundary and the last rank
+  int scattered[] = { 0, 5, 63, 64, 100, 299 };
+  for (int i=0; i < 6; ++i){
+    failed[scattered[i]] = true;
+    failed_set.insert(scattered[i]);
+  }
+  for (int r=128; r < 192; ++r) failed[r] = true;
+  failed_set.insert_range(128, 192);
+  for (int r=250; r < 270; ++r) failed[r] = true;
+  failed_set.insert_range(250, 270);
+
+  dense_rank_map map(failed_set);
+  check_round_trip(unit, "rank set", map, failed);
+
+  assertTrue(unit, "failed rank throws", throws_on_failed(map, 5));
+  assertTrue(unit, "failed run throws", throws_on_failed(map, 150));
+  assertTrue(unit, "live rank does not throw", !throws_on_failed(map, 6));
+}
+
+void
+test_epoch_failures(UnitTest& unit)
+{
+  int nproc = 200;
+  failure_log log;
+  std::vector<bool> failed(nproc, false);
+
+  rank_set first;
+  first.insert(3);
+  first.insert(4);
+  int epoch1 = log.append(0, first);
+  failed[3] = failed[4] = true;
+
+  rank_set second;
+  second.insert(4); //already known, only the rest is new
+  second.insert_range(70, 140);
+  int epoch2 = log.append(epoch1, second);
+  for (int r=70; r < 140; ++r) failed[r] = true;
+
+  dense_rank_map map(log.view(epoch2));
+  check_round_trip(unit, "epoch chain", map, failed);
+
+  //the union of the deltas must agree with the gathered set
+  rank_set all;
+  log.view(epoch2).collect(all);
+  dense_rank_map gathered(all);
+  bool agree = true;
+  for (int r=0; r < nproc; ++r){
+    if (!failed[r]){
+      agree = agree && map.dense_rank(r) == gathered.dense_rank(r);
+    }
+  }
+  assertTrue(unit, "deltas agree with gathered set", agree);
+
+  //a sibling branch off the first epoch sees none of the second
+  rank_set other;
+  other.insert(199);
+  int sibling = log.append(epoch1, other);
+  std::vector<bool> sibling_failed(nproc, false);
+  sibling_failed[3] = sibling_failed[4] = sibling_failed[199] = true;
+  dense_rank_map sibling_map(log.view(sibling));
+  check_round_trip(unit, "sibling epoch", sibling_map, sibling_failed);
+  assertTrue(unit, "sibling epoch live rank", !throws_on_failed(sibling_map, 100));
+
+  dense_rank_map initial(log.view(0));
+  check_round_trip(unit, "initial epoch", initial, std::vector<bool>(nproc, false));
+}
+
+void
+test_domain_failures(UnitTest& unit)
+{
+  //domain ranks 0..149 are global ranks 100..249
+  subrange_domain dom(100, 100, 150);
+  rank_set global_failed;
+  global_failed.insert(5);              //outside the domain
+  global_failed.insert_range(100, 103); //domain ranks 0-2
+  global_failed.insert(200);            //domain rank 100
+  global_failed.insert(260);            //outside the domain
+
+  std::vector<bool> failed(150, false);
+  failed[0] = failed[1] = failed[2] = failed[100] = true;
+
+  dense_rank_map map(global_failed, &dom);
+  check_round_trip(unit, "subrange domain", map, failed);
+  assertTrue(unit, "failed domain rank throws", throws_on_failed(map, 100));
+}
+
+int main(int argc, char** argv)
+{
+  UnitTest unit;
+  try {
+    SPROCKIT_RUN_TEST_NO_ARGS(test_rank_set_failures, unit);
+    SPROCKIT_RUN_TEST_NO_ARGS(test_epoch_failures, unit);
+    SPROCKIT_RUN_TEST_NO_ARGS(test_domain_failures, unit);
+  } catch (std::exception& e) {
+    std::cerr << "Dense rank map test failed to initialize: "
+      << e.what() << std::endl;
+    return 1;
+  }
+
+  return unit.validate();
+}
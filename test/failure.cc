@@ -69,8 +69,8 @@ run_test(int me, int todie, int nproc_live, int context, int tag, transport* t)
   }
 
   if (me == 0){
-    const thread_safe_set<int>& failed = t->failed_ranks();
-    thread_safe_set<int>::iterator it, end = failed.start_iteration();
+    const rank_set& failed = t->failed_ranks();
+    rank_set::const_iterator it, end = failed.start_iteration();
     std::stringstream sstr;
     sstr << "Failed = {";
     for (it = failed.begin(); it != end; ++it){
@@ -0,0 +1,146 @@
+#include <sprockit/test/test.h>
+#include <sprockit/errors.h>
+#include <sumi/failure_log.h>
+#include <vector>
+#include <set>
+
+using sumi::failure_log;
+using sumi::rank_set;
+
+void
+test_chain(UnitTest& unit)
+{
+  failure_log log;
+  assertEqual(unit, "starts with the empty epoch", log.num_epochs(), 1);
+  assertTrue(unit, "initial epoch empty", log.view(0).empty());
+
+  rank_set first;
+  first.insert_range(10, 20);
+  int epoch1 = log.append(0, first);
+  assertEqual(unit, "first epoch", epoch1, 1);
+
+  //repeats older failures, only 30-39 are new
+  rank_set second;
+  second.insert(15);
+  second.insert_range(30, 40);
+  int epoch2 = log.append(epoch1, second);
+  assertEqual(unit, "delta holds only new ranks", log.delta(epoch2).to_string(),
+              std::string("{ 30-39 }"));
+  assertEqual(unit, "cumulative size", int(log.view(epoch2).size()), 20);
+
+  //nothing new shares the parent epoch
+  assertEqual(unit, "no new failures", log.append(epoch2, first), epoch2);
+  assertEqual(unit, "no epoch added", log.num_epochs(), 3);
+
+  failure_log::snapshot snap = log.view(epoch2);
+  assertEqual(unit, "count in parent delta", int(snap.count(12)), 1);
+  assertEqual(unit, "count in own delta", int(snap.count(35)), 1);
+  assertEqual(unit, "count live rank", int(snap.count(5)), 0);
+  assertEqual(unit, "count past end", int(snap.count(40)), 0);
+  assertEqual(unit, "parent does not see child", int(log.view(epoch1).count(35)), 0);
+
+  std::vector<const rank_set*> deltas;
+  snap.deltas(deltas);
+  assertEqual(unit, "one delta per epoch", int(deltas.size()), 2);
+  assertTrue(unit, "newest delta first", deltas[0] == &log.delta(epoch2));
+
+  rank_set all;
+  snap.collect(all);
+  assertEqual(unit, "collect", all.to_string(), std::string("{ 10-19 30-39 }"));
+}
+
+void
+test_siblings(UnitTest& unit)
+{
+  failure_log log;
+  rank_set base;
+  base.insert(1);
+  int root = log.append(0, base);
+
+  //two contexts committed off the same parent by different domains
+  rank_set left_failed, right_failed;
+  left_failed.insert_range(10, 20);
+  right_failed.insert_range(15, 25);
+  int left = log.append(root, left_failed);
+  int right = log.append(root, right_failed);
+
+  failure_log::snapshot lsnap = log.view(left);
+  failure_log::snapshot rsnap = log.view(right);
+  assertEqual(unit, "left sees shared rank", int(lsnap.count(17)), 1);
+  assertEqual(unit, "right sees shared rank", int(rsnap.count(17)), 1);
+  assertEqual(unit, "left misses right only rank", int(lsnap.count(22)), 0);
+  assertEqual(unit, "right misses left only rank", int(rsnap.count(12)), 0);
+  assertEqual(unit, "both see the parent", int(lsnap.count(1)) + int(rsnap.count(1)), 2);
+
+  //another vote off the same parent finding the same failures
+  int nepochs = log.num_epochs();
+  assertEqual(unit, "same failures share an epoch", log.append(root, left_failed), left);
+  rank_set left_again;
+  left_again.insert(1);
+  left_again.insert_range(10, 20);
+  assertEqual(unit, "old failures filtered before sharing", log.append(root, left_again), left);
+  assertEqual(unit, "shared epoch adds nothing", log.num_epochs(), nepochs);
+
+  //extending one branch never leaks into the other
+  rank_set more;
+  more.insert(22);
+  int left2 = log.append(left, more);
+  assertEqual(unit, "extended left sees it", int(log.view(left2).count(22)), 1);
+  assertEqual(unit, "extended left sees own branch", int(log.view(left2).count(10)), 1);
+  assertEqual(unit, "right branch unchanged", int(log.view(right).size()), 11);
+}
+
+void
+test_deep_history(UnitTest& unit)
+{
+  //a long-running job: many small epochs, some branching off older ones
+  failure_log log;
+  std::vector<std::set<int> > expected(1);
+  std::vector<int> epochs(1, 0);
+  for (int i=1; i < 2000; ++i){
+    int parent = (i % 7 == 0) ? epochs[i / 2] : epochs.back();
+    rank_set failed;
+    failed.insert((i * 7919) % 5000);
+    if (i % 11 == 0){
+      failed.insert_range(i % 4000, i % 4000 + 8);
+    }
+    int epoch = log.append(parent, failed);
+    std::set<int> all = expected[parent];
+    rank_set::const_iterator it, end = failed.end();
+    for (it=failed.begin(); it != end; ++it){
+      all.insert(*it);
+    }
+    if (epoch == int(expected.size())){
+      expected.push_back(all);
+    }
+    epochs.push_back(epoch);
+  }
+
+  bool counts_ok = true;
+  bool sizes_ok = true;
+  for (int e=0; e < log.num_epochs(); e += 37){
+    failure_log::snapshot snap = log.view(e);
+    sizes_ok = sizes_ok && snap.size() == expected[e].size();
+    for (int r=0; r < 5000; r += 3){
+      counts_ok = counts_ok && snap.count(r) == expected[e].count(r);
+    }
+  }
+  assertTrue(unit, "deep history counts", counts_ok);
+  assertTrue(unit, "deep history sizes", sizes_ok);
+}
+
+int main(int argc, char** argv)
+{
+  UnitTest unit;
+  try {
+    SPROCKIT_RUN_TEST_NO_ARGS(test_chain, unit);
+    SPROCKIT_RUN_TEST_NO_ARGS(test_siblings, unit);
+    SPROCKIT_RUN_TEST_NO_ARGS(test_deep_history, unit);
+  } catch (std::exception& e) {
+    std::cerr << "Failure log test failed to initialize: "
+      << e.what() << std::endl;
+    return 1;
+  }
+
+  return unit.validate();
+}
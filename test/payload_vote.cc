@@ -0,0 +1,141 @@
+#include <sumi/transport.h>
+#include <sumi/rank_threads.h>
+#include <sprockit/sim_parameters.h>
+#include <sprockit/errors.h>
+#include <sprockit/util.h>
+#include <vector>
+
+#define DEBUG 0
+
+using namespace sumi;
+
+static const int nelems = 4;
+
+static inline int
+val(int rank, int idx){
+  return (idx+1)*(rank+1);
+}
+
+collective_done_message::ptr
+wait_for_vote(transport* t, int tag)
+{
+  while (1){
+    message::ptr msg = t->blocking_poll();
+    if (msg->class_type() != message::collective_done) continue;
+    collective_done_message::ptr dmsg = ptr_safe_cast(collective_done_message, msg);
+    if (dmsg->type() == collective::dynamic_tree_vote && dmsg->tag() == tag){
+      return dmsg;
+    }
+  }
+}
+
+void
+check_vote(transport* t, int tag, int* result)
+{
+  int me = t->rank();
+  int nproc = t->nproc();
+  collective_done_message::ptr dmsg = wait_for_vote(t, tag);
+  if (dmsg->vote() != 1 || !dmsg->succeeded()
+      || !dmsg->missing_contributions().empty()){
+    spkt_throw_printf(sprockit::value_error,
+      "Rank %d: payload vote tag=%d finished with vote=%d failed=%s missing=%s",
+      me, tag, dmsg->vote(), dmsg->failed_procs().to_string().c_str(),
+      dmsg->missing_contributions().to_string().c_str());
+  }
+  if (dmsg->result() != result){
+    spkt_throw_printf(sprockit::value_error,
+      "Rank %d: payload vote tag=%d reported the wrong result buffer",
+      me, tag);
+  }
+  for (int i=0; i < nelems; ++i){
+    int correct = 0;
+    for (int r=0; r < nproc; ++r){
+      correct += val(r, i);
+    }
+    if (result[i] != correct){
+      spkt_throw_printf(sprockit::value_error,
+        "Rank %d: payload vote tag=%d result[%d] = %d != %d",
+        me, tag, i, result[i], correct);
+    }
+  }
+}
+
+void
+test_payload_vote(transport* t)
+{
+  int me = t->rank();
+  int src[nelems];
+  int dst[nelems];
+  for (int i=0; i < nelems; ++i){
+    src[i] = val(me, i);
+  }
+  t->vote<int,Add>(dst, src, nelems, 0);
+  check_vote(t, 0, dst);
+
+  //in place
+  t->vote<int,Add>(src, src, nelems, 1);
+  check_vote(t, 1, src);
+}
+
+void
+test_oversize_payload(transport* t)
+{
+  long max_size = t->max_smsg_size();
+  if (max_size < 0){
+    //no limit to check on this transport
+    return;
+  }
+
+  int count = max_size / sizeof(int) + 1;
+  std::vector<int> buf(count, 1);
+  bool caught = false;
+  try {
+    t->vote<int,Add>(&buf[0], &buf[0], count, 2);
+  } catch (sprockit::value_error& e) {
+    caught = true;
+  }
+  if (!caught){
+    spkt_throw_printf(sprockit::value_error,
+      "Rank %d: payload vote of %d bytes was not rejected, short messages hold %ld",
+      t->rank(), int(count*sizeof(int)), max_size);
+  }
+
+  //nothing was started, so the same tag is still free
+  int dst[nelems];
+  for (int i=0; i < nelems; ++i){
+    dst[i] = val(t->rank(), i);
+  }
+  t->vote<int,Add>(dst, dst, nelems, 2);
+  check_vote(t, 2, dst);
+}
+
+void
+run_test()
+{
+  sprockit::sim_parameters params;
+  params["ping_timeout"] = "100ms";
+  const char* transport_name = getenv("SUMI_TRANSPORT");
+  params["transport"] = transport_name ? transport_name : DEFAULT_TRANSPORT;
+  params["eager_cutoff"] = "0";
+  transport* t = transport_factory::get_param("transport", &params);
+
+  t->init();
+
+  test_payload_vote(t);
+  test_oversize_payload(t);
+
+  std::cout << "All tests passed on rank " << t->rank() << std::endl;
+
+  t->finalize();
+}
+
+int main(int argc, char** argv)
+{
+#if DEBUG
+  sprockit::debug::turn_on("sumi");
+  sprockit::debug::turn_on("sumi_collective");
+  sprockit::debug::turn_on("sumi_vote");
+#endif
+  run_rank_threads(run_test);
+  return 0;
+}
@@ -0,0 +1,224 @@
+#include <sprockit/test/test.h>
+#include <sprockit/errors.h>
+#include <sumi/rank_set.h>
+#include <sumi/thread_safe_rank_set.h>
+#include <pthread.h>
+#include <set>
+#include <vector>
+
+using sumi::rank_set;
+using sumi::thread_safe_rank_set;
+
+static std::vector<int>
+ranks_of(const rank_set& set)
+{
+  return std::vector<int>(set.begin(), set.end());
+}
+
+void
+test_insert_merge(UnitTest& unit)
+{
+  rank_set set;
+  assertTrue(unit, "starts empty", set.empty());
+  assertTrue(unit, "new rank inserted", set.insert(5));
+  assertTrue(unit, "duplicate not inserted", !set.insert(5));
+  assertEqual(unit, "single run", set.num_runs(), 1);
+
+  //touching on either side extends the run rather than adding one
+  set.insert(6);
+  set.insert(4);
+  assertEqual(unit, "adjacent ranks merged", set.num_runs(), 1);
+  assertEqual(unit, "merged size", int(set.size()), 3);
+
+  set.insert(10);
+  assertEqual(unit, "gap makes a new run", set.num_runs(), 2);
+  //bridging the gap joins both runs
+  assertEqual(unit, "new ranks in bridge", set.insert_range(7, 10), 3);
+  assertEqual(unit, "bridged runs merged", set.num_runs(), 1);
+  assertEqual(unit, "bridged size", int(set.size()), 7);
+
+  //overlapping range only counts what was not there
+  assertEqual(unit, "overlap counts new ranks", set.insert_range(8, 14), 3);
+  assertEqual(unit, "overlap merged", set.num_runs(), 1);
+  assertEqual(unit, "empty range adds nothing", set.insert_range(20, 20), 0);
+
+  //a range swallowing several runs
+  set.insert(20);
+  set.insert(22);
+  set.insert(24);
+  assertEqual(unit, "separate runs", set.num_runs(), 4);
+  set.insert_range(18, 30);
+  assertEqual(unit, "runs swallowed", set.num_runs(), 2);
+  assertEqual(unit, "to_string", set.to_string(), std::string("{ 4-13 18-29 }"));
+
+  //erasing from the middle splits a run
+  assertEqual(unit, "erase present", int(set.erase(8)), 1);
+  assertEqual(unit, "erase absent", int(set.erase(8)), 0);
+  assertEqual(unit, "split run", set.num_runs(), 3);
+  assertEqual(unit, "count erased", int(set.count(8)), 0);
+  assertEqual(unit, "count kept", int(set.count(9)), 1);
+
+  rank_set other;
+  other.insert_range(14, 18);
+  other.insert(40);
+  set.insert_all(other);
+  assertEqual(unit, "union bridges runs", set.to_string(), std::string("{ 4-7 9-29 40 }"));
+  assertEqual(unit, "union size", int(set.size()), 4 + 21 + 1);
+}
+
+void
+test_set_difference(UnitTest& unit)
+{
+  rank_set base;
+  base.insert_range(0, 10);
+  base.insert_range(20, 30);
+  base.insert(50);
+
+  rank_set sub;
+  sub.insert_range(5, 25);
+  sub.insert(50);
+  sub.insert(60);
+
+  rank_set result;
+  sumi::set_difference(base, sub, result);
+  assertEqual(unit, "difference", result.to_string(), std::string("{ 0-4 25-29 }"));
+  assertEqual(unit, "difference size", int(result.size()), 10);
+
+  rank_set none;
+  sumi::set_difference(base, none, result);
+  assertTrue(unit, "subtract nothing", result == base);
+
+  sumi::set_difference(base, base, result);
+  assertTrue(unit, "subtract self", result.empty());
+
+  //the result may alias the base
+  rank_set alias = base;
+  sumi::set_difference(alias, sub, alias);
+  assertEqual(unit, "aliased difference", alias.to_string(), std::string("{ 0-4 25-29 }"));
+
+  //agrees with std::set over an irregular pattern
+  std::set<int> sbase, ssub;
+  rank_set rbase, rsub;
+  for (int r=0; r < 500; ++r){
+    if ((r*7919) % 13 < 6){ sbase.insert(r); rbase.insert(r); }
+    if ((r*104729) % 11 < 4){ ssub.insert(r); rsub.insert(r); }
+  }
+  std::set<int> expected;
+  std::set<int>::iterator it, end = sbase.end();
+  for (it=sbase.begin(); it != end; ++it){
+    if (!ssub.count(*it)) expected.insert(*it);
+  }
+  sumi::set_difference(rbase, rsub, result);
+  assertTrue(unit, "matches std::set difference", result.get_copy() == expected);
+  assertEqual(unit, "matches std::set size", int(result.size()), int(expected.size()));
+}
+
+void
+test_iteration(UnitTest& unit)
+{
+  rank_set set;
+  assertTrue(unit, "empty iteration", set.begin() == set.end());
+
+  set.insert_range(3, 6);
+  set.insert(10);
+  set.insert_range(64, 66);
+  int expected[] = { 3, 4, 5, 10, 64, 65 };
+  std::vector<int> ranks = ranks_of(set);
+  assertEqual(unit, "iterated count", int(ranks.size()), 6);
+  bool in_order = ranks.size() == 6;
+  for (int i=0; in_order && i < 6; ++i){
+    in_order = ranks[i] == expected[i];
+  }
+  assertTrue(unit, "iterates ranks in order", in_order);
+
+  //thread_safe_set style iteration
+  int sum = 0;
+  rank_set::const_iterator it, end = set.start_iteration();
+  for (it=set.begin(); it != end; ++it){
+    sum += *it;
+  }
+  set.end_iteration();
+  assertEqual(unit, "iterated sum", sum, 3+4+5+10+64+65);
+
+  std::set<int> copy = set.get_copy();
+  rank_set from_copy(copy);
+  assertTrue(unit, "round trip through std::set", from_copy == set);
+}
+
+static const int num_inserters = 4;
+static const int inserts_per_thread = 1000;
+
+struct inserter_args {
+  thread_safe_rank_set* set;
+  int offset;
+};
+
+static void*
+insert_every_other(void* args)
+{
+  inserter_args* ins = (inserter_args*) args;
+  //interleaved with the other threads, so runs keep merging and splitting
+  for (int i=0; i < inserts_per_thread; ++i){
+    ins->set->insert(i*num_inserters + ins->offset);
+  }
+  return 0;
+}
+
+void
+test_thread_safe_rank_set(UnitTest& unit)
+{
+  thread_safe_rank_set set;
+  std::vector<pthread_t> threads(num_inserters);
+  std::vector<inserter_args> args(num_inserters);
+  for (int i=0; i < num_inserters; ++i){
+    args[i].set = &set;
+    args[i].offset = i;
+    pthread_create(&threads[i], 0, insert_every_other, &args[i]);
+  }
+  //read while the others write
+  for (int i=0; i < inserts_per_thread; ++i){
+    int last = -1;
+    bool sorted = true;
+    thread_safe_rank_set::const_iterator it, end = set.start_iteration();
+    for (it=set.begin(); it != end; ++it){
+      sorted = sorted && *it > last;
+      last = *it;
+    }
+    set.end_iteration();
+    assertTrue(unit, "concurrent iteration sorted", sorted);
+  }
+  for (int i=0; i < num_inserters; ++i){
+    pthread_join(threads[i], 0);
+  }
+
+  int total = num_inserters*inserts_per_thread;
+  assertEqual(unit, "concurrent inserts", int(set.size()), total);
+  rank_set all;
+  all.insert_range(0, total);
+  assertTrue(unit, "concurrent inserts merge into one run", set.get_copy() == all);
+
+  thread_safe_rank_set copy(set);
+  assertEqual(unit, "copy size", int(copy.size()), total);
+  copy.clear();
+  assertTrue(unit, "copy cleared", copy.empty());
+  assertEqual(unit, "original kept", int(set.size()), total);
+  copy = set;
+  assertTrue(unit, "assigned", copy.count(total-1) == 1);
+}
+
+int main(int argc, char** argv)
+{
+  UnitTest unit;
+  try {
+    SPROCKIT_RUN_TEST_NO_ARGS(test_insert_merge, unit);
+    SPROCKIT_RUN_TEST_NO_ARGS(test_set_difference, unit);
+    SPROCKIT_RUN_TEST_NO_ARGS(test_iteration, unit);
+    SPROCKIT_RUN_TEST_NO_ARGS(test_thread_safe_rank_set, unit);
+  } catch (std::exception& e) {
+    std::cerr << "Rank set test failed to initialize: "
+      << e.what() << std::endl;
+    return 1;
+  }
+
+  return unit.validate();
+}
@@ -0,0 +1,139 @@
+#include <sprockit/test/test.h>
+#include <sprockit/errors.h>
+#include <sprockit/sim_parameters.h>
+#include <sumi/registration_cache.h>
+#include <sumi/transport.h>
+
+using sumi::registration_cache;
+using sumi::public_buffer;
+using sumi::transport;
+
+void
+test_registration_cache(UnitTest& unit)
+{
+  char* mem = new char[4096];
+  registration_cache cache(2048);
+  registration_cache::registration_list dropped;
+  public_buffer pbuf;
+
+  assertTrue(unit, "empty cache misses", !cache.acquire(mem, 1024, pbuf));
+  cache.insert(mem, 1024, public_buffer(mem), dropped);
+  cache.release(mem, 1024, dropped);
+  assertEqual(unit, "registered bytes", cache.registered_bytes(), 1024);
+
+  assertTrue(unit, "same region hits", cache.acquire(mem, 1024, pbuf));
+  assertTrue(unit, "hit points at region", pbuf.ptr == (void*) mem);
+  cache.release(mem, 1024, dropped);
+
+  assertTrue(unit, "subregion hits", cache.acquire(mem + 100, 200, pbuf));
+  assertTrue(unit, "hit points at subregion", pbuf.ptr == (void*) (mem + 100));
+  cache.release(mem + 100, 200, dropped);
+
+  assertTrue(unit, "overhanging region misses", !cache.acquire(mem + 512, 1024, pbuf));
+  assertEqual(unit, "hits", cache.hits(), 2);
+  assertEqual(unit, "misses", cache.misses(), 2);
+
+  //goes over the cap, the unused first region must go
+  cache.insert(mem + 1024, 1536, public_buffer(mem + 1024), dropped);
+  assertEqual(unit, "evictions", cache.evictions(), 1);
+  assertEqual(unit, "evicted registrations", dropped.size(), 1);
+  assertTrue(unit, "evicted first region", dropped.front().buf.ptr == (void*) mem);
+  assertEqual(unit, "regions after eviction", cache.num_regions(), 1);
+
+  //in use, so cannot be evicted even though over cap
+  dropped.clear();
+  cache.insert(mem, 1024, public_buffer(mem), dropped);
+  assertEqual(unit, "no eviction of in-use regions", dropped.size(), 0);
+  assertEqual(unit, "regions held over cap", cache.num_regions(), 2);
+
+  cache.release(mem, 1024, dropped);
+  cache.release(mem + 1024, 1536, dropped);
+  cache.invalidate(mem + 2000, 8, dropped);
+  assertEqual(unit, "invalidated overlapping region", dropped.size(), 1);
+  assertEqual(unit, "regions after invalidate", cache.num_regions(), 1);
+
+  //invalidated while in use, kept registered until the last release
+  dropped.clear();
+  assertTrue(unit, "hit before stale", cache.acquire(mem, 1024, pbuf));
+  assertTrue(unit, "second ref before stale", cache.acquire(mem, 1024, pbuf));
+  cache.invalidate(mem, 8, dropped);
+  assertEqual(unit, "in-use region not dropped", dropped.size(), 0);
+  assertEqual(unit, "stale region not found", cache.num_regions(), 0);
+  assertTrue(unit, "stale region not handed out", !cache.acquire(mem, 1024, pbuf));
+  assertEqual(unit, "stale region still registered", cache.registered_bytes(), 1024);
+  cache.release(mem, 1024, dropped);
+  assertEqual(unit, "stale region held by second ref", dropped.size(), 0);
+  cache.release(mem, 1024, dropped);
+  assertEqual(unit, "stale region dropped on last release", dropped.size(), 1);
+  assertEqual(unit, "stale bytes released", cache.registered_bytes(), 0);
+
+  cache.insert(mem, 1024, public_buffer(mem), dropped);
+  cache.release(mem, 1024, dropped);
+  dropped.clear();
+  cache.clear(dropped);
+  assertEqual(unit, "cleared regions", dropped.size(), 1);
+  assertEqual(unit, "cleared bytes", cache.registered_bytes(), 0);
+
+  delete[] mem;
+}
+
+void
+test_transport_registration_cache(UnitTest& unit)
+{
+  sprockit::sim_parameters params;
+  params["transport"] = "fake";
+  params["fake_transport_nproc"] = "1";
+  params["fake_transport_rank"] = "0";
+  params["public_buffer_cache_size"] = "1MB";
+  transport* t = sumi::transport_factory::get_param("transport", &params);
+  t->init();
+
+  const registration_cache* cache = t->public_buffer_cache();
+  assertTrue(unit, "transport built registration cache", cache != 0);
+
+  int size = 4096;
+  char* buf = new char[size];
+  for (int i=0; i < 3; ++i){
+    public_buffer pbuf = t->make_public_buffer(buf, size);
+    t->unmake_public_buffer(pbuf, size);
+  }
+  assertEqual(unit, "transport misses", cache->misses(), 1);
+  assertEqual(unit, "transport hits", cache->hits(), 2);
+
+  t->invalidate_public_buffers(buf, size);
+  assertEqual(unit, "transport invalidate", cache->num_regions(), 0);
+  delete[] buf;
+
+  //every allocation is registered, every free must give it back,
+  //including when malloc hands out the same address again
+  for (int i=0; i < 100; ++i){
+    public_buffer pbuf = t->allocate_public_buffer(size);
+    assertTrue(unit, "allocated buffer registered", cache->registered_bytes() >= size);
+    t->free_public_buffer(pbuf, size);
+  }
+  assertEqual(unit, "allocate/free leaves nothing registered", cache->registered_bytes(), 0);
+  assertEqual(unit, "allocate/free leaves no regions", cache->num_regions(), 0);
+
+  //two live allocations, freed in the opposite order
+  public_buffer first = t->allocate_public_buffer(size);
+  public_buffer second = t->allocate_public_buffer(2*size);
+  t->free_public_buffer(second, 2*size);
+  assertEqual(unit, "first buffer still registered", cache->registered_bytes(), size);
+  t->free_public_buffer(first, size);
+  assertEqual(unit, "all buffers released", cache->registered_bytes(), 0);
+}
+
+int main(int argc, char** argv)
+{
+  UnitTest unit;
+  try {
+    SPROCKIT_RUN_TEST_NO_ARGS(test_registration_cache, unit);
+    SPROCKIT_RUN_TEST_NO_ARGS(test_transport_registration_cache, unit);
+  } catch (std::exception& e) {
+    std::cerr << "Registration cache test failed to initialize: "
+      << e.what() << std::endl;
+    return 1;
+  }
+
+  return unit.validate();
+}
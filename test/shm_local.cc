@@ -0,0 +1,86 @@
+#include <sprockit/test/test.h>
+#include <sprockit/sim_parameters.h>
+#include <sprockit/errors.h>
+#include <sumi/transport.h>
+#include <sumi/rank_threads.h>
+#include <vector>
+
+using namespace sumi;
+
+static const int test_nproc = 4;
+
+static inline int
+val(int rank, int idx){
+  return idx*10 + rank;
+}
+
+void
+check_collectives(transport* t, int tag)
+{
+  int me = t->rank();
+  int nproc = t->nproc();
+
+  std::vector<int> reduce_buf(nproc, 0);
+  reduce_buf[me] = val(me, 0);
+  t->allreduce<int,Add>(&reduce_buf[0], &reduce_buf[0], nproc, tag);
+  t->blocking_poll();
+
+  std::vector<int> gather_buf(nproc, -1);
+  int mine = val(me, 1);
+  t->allgather(&gather_buf[0], &mine, 1, sizeof(int), tag + 1);
+  t->blocking_poll();
+
+  for (int i=0; i < nproc; ++i){
+    if (reduce_buf[i] != val(i, 0) || gather_buf[i] != val(i, 1)){
+      spkt_throw_printf(sprockit::value_error,
+        "Rank %d: tag=%d got reduce[%d]=%d, gather[%d]=%d, expected %d, %d",
+        me, tag, i, reduce_buf[i], i, gather_buf[i], val(i, 0), val(i, 1));
+    }
+  }
+}
+
+/**
+ * Every collective message goes by rendezvous, so each transfer is a
+ * process_vm_readv (get) or process_vm_writev (put) between processes
+ */
+void
+run_rank(int rank, int nproc)
+{
+  sprockit::sim_parameters params;
+  params["transport"] = "shm";
+  params["shm_rank"] = sprockit::printf("%d", rank);
+  params["shm_nproc"] = sprockit::printf("%d", nproc);
+  params["shm_attach_timeout"] = "4s";
+  params["eager_cutoff"] = "0";
+  transport* t = transport_factory::get_param("transport", &params);
+  t->init();
+
+  t->set_put_protocol(false);
+  check_collectives(t, 0);
+
+  t->set_put_protocol(true);
+  check_collectives(t, 2);
+
+  t->finalize();
+}
+
+void
+test_shm_ranks(UnitTest& unit)
+{
+  int num_failed = run_rank_procs(test_nproc, run_rank);
+  assertEqual(unit, "failed shm ranks", num_failed, 0);
+}
+
+int main(int argc, char** argv)
+{
+  UnitTest unit;
+  try {
+    SPROCKIT_RUN_TEST_NO_ARGS(test_shm_ranks, unit);
+  } catch (std::exception& e) {
+    std::cerr << "shm test failed to initialize: "
+      << e.what() << std::endl;
+    return 1;
+  }
+
+  return unit.validate();
+}
@@ -0,0 +1,156 @@
+#include <sprockit/test/test.h>
+#include <sprockit/sim_parameters.h>
+#include <sprockit/errors.h>
+#include <sumi/domain.h>
+#include <sumi/rank_set.h>
+#include <fake/fake_transport.h>
+#include <vector>
+#include <set>
+
+using namespace sumi;
+
+static const int test_nproc = 8;
+
+static const int test_nspares = 3;
+
+static bool
+throws_on_holder(spare_domain& dom, int slot, int global_rank)
+{
+  try {
+    dom.substitute(slot, global_rank);
+  } catch (sprockit::value_error& e) {
+    return true;
+  }
+  return false;
+}
+
+void
+test_spare_domain(UnitTest& unit)
+{
+  spare_domain dom(5, 4, 6);
+  assertEqual(unit, "slots", dom.nproc(), 4);
+  assertEqual(unit, "spare holds no slot", dom.my_domain_rank(), -1);
+  assertEqual(unit, "slot starts with its rank", dom.domain_to_global_rank(2), 2);
+  assertEqual(unit, "spare maps to no slot", dom.global_to_domain_rank(4), -1);
+
+  dom.substitute(2, 5);
+  assertEqual(unit, "spare takes slot", dom.domain_to_global_rank(2), 5);
+  assertEqual(unit, "spare maps to slot", dom.global_to_domain_rank(5), 2);
+  assertEqual(unit, "replaced rank maps to no slot", dom.global_to_domain_rank(2), -1);
+  assertEqual(unit, "activated spare has slot", dom.my_domain_rank(), 2);
+  assertTrue(unit, "slot holder cannot take another slot", throws_on_holder(dom, 1, 5));
+
+  spare_domain working(1, 4, 6);
+  working.substitute(1, 4);
+  assertEqual(unit, "replaced rank holds no slot", working.my_domain_rank(), -1);
+}
+
+/**
+ * Every rank must make the same substitutions from the same votes
+ */
+static void
+check_slots(UnitTest& unit, const char* desc, const std::vector<fake_transport*>& ranks,
+            const int* slots)
+{
+  int nslots = test_nproc - test_nspares;
+  int nranks = ranks.size();
+  for (int r=0; r < nranks; ++r){
+    domain* dom = ranks[r]->work_dom();
+    assertEqual(unit, desc, dom->nproc(), nslots);
+    bool match = true;
+    for (int s=0; s < nslots; ++s){
+      match = match && dom->domain_to_global_rank(s) == slots[s]
+                    && dom->global_to_domain_rank(slots[s]) == s;
+    }
+    assertTrue(unit, desc, match);
+    assertEqual(unit, desc, dom->my_domain_rank(), dom->global_to_domain_rank(ranks[r]->rank()));
+  }
+}
+
+void
+test_substitute_spares(UnitTest& unit)
+{
+  sprockit::sim_parameters params;
+  params["transport"] = "fake";
+  params["fake_transport_nproc"] = sprockit::printf("%d", test_nproc);
+  //one working rank and every spare
+  int my_ranks[] = { 0, 5, 6, 7 };
+  std::vector<fake_transport*> ranks;
+  for (int i=0; i < 4; ++i){
+    params["fake_transport_rank"] = sprockit::printf("%d", my_ranks[i]);
+    fake_transport* t = safe_cast(fake_transport,
+      transport_factory::get_param("transport", &params));
+    t->init();
+    t->init_spares(test_nspares);
+    ranks.push_back(t);
+  }
+  fake_transport* working = ranks[0];
+  fake_transport* spare6 = ranks[2];
+  fake_transport* spare7 = ranks[3];
+
+  int initial[] = { 0, 1, 2, 3, 4 };
+  check_slots(unit, "initial slots", ranks, initial);
+  assertTrue(unit, "working rank is not a spare", !working->is_spare());
+  assertTrue(unit, "spare starts idle", spare7->is_spare());
+
+  //a spare fails along with a working rank, so the failed spare is skipped
+  std::set<int> first;
+  first.insert(1);
+  first.insert(5);
+  for (int r=0; r < 4; ++r){
+    ranks[r]->simulate_global_vote(10, options::initial_context, rank_set(first));
+  }
+  int after_first[] = { 0, 6, 2, 3, 4 };
+  check_slots(unit, "slot of failed rank to lowest live spare", ranks, after_first);
+  assertTrue(unit, "spare activated", !spare6->is_spare());
+  assertTrue(unit, "next spare still idle", spare7->is_spare());
+
+  //the next vote reports the earlier failures again, only the new one is handled
+  domain* before = working->work_dom();
+  std::set<int> second(first);
+  second.insert(3);
+  for (int r=0; r < 4; ++r){
+    ranks[r]->simulate_global_vote(11, 10, rank_set(second));
+  }
+  int after_second[] = { 0, 6, 2, 7, 4 };
+  check_slots(unit, "only new failures substituted", ranks, after_second);
+  assertTrue(unit, "last spare activated", !spare7->is_spare());
+  assertTrue(unit, "substitution builds a new domain", working->work_dom() != before);
+  assertEqual(unit, "running collectives keep the old slots",
+    before->domain_to_global_rank(3), 3);
+
+  //no failures beyond the context, so nothing to do
+  before = working->work_dom();
+  for (int r=0; r < 4; ++r){
+    ranks[r]->simulate_global_vote(12, 11, rank_set(second));
+  }
+  assertTrue(unit, "no new failures keeps the domain", working->work_dom() == before);
+
+  //out of spares, the slot stays with the failed rank
+  std::set<int> third(second);
+  third.insert(4);
+  for (int r=0; r < 4; ++r){
+    ranks[r]->simulate_global_vote(13, 12, rank_set(third));
+  }
+  check_slots(unit, "no spares left", ranks, after_second);
+  assertTrue(unit, "no spares left keeps the domain", working->work_dom() == before);
+
+  for (int r=0; r < 4; ++r){
+    delete ranks[r];
+  }
+}
+
+int main(int argc, char** argv)
+{
+  UnitTest unit;
+  try {
+    SPROCKIT_RUN_TEST_NO_ARGS(test_spare_domain, unit);
+    SPROCKIT_RUN_TEST_NO_ARGS(test_substitute_spares, unit);
+  } catch (std::exception& e) {
+    std::cerr << "Spare domain test failed to initialize: "
+      << e.what() << std::endl;
+    return 1;
+  }
+
+  return unit.validate();
+}
@@ -0,0 +1,142 @@
+#include <sumi/transport.h>
+#include <sumi/rank_threads.h>
+#include <sprockit/sim_parameters.h>
+#include <sprockit/errors.h>
+#include <sprockit/util.h>
+
+#define DEBUG 0
+
+using namespace sumi;
+
+static inline int
+val(int rank){
+  //one bit per rank, so the sum tells exactly whose input is in it
+  return 1 << rank;
+}
+
+collective_done_message::ptr
+wait_for_allreduce(transport* t, int tag)
+{
+  while (1){
+    message::ptr msg = t->blocking_poll();
+    if (msg->class_type() != message::collective_done) continue;
+    collective_done_message::ptr dmsg = ptr_safe_cast(collective_done_message, msg);
+    if (dmsg->type() == collective::dynamic_tree_vote && dmsg->tag() == tag){
+      return dmsg;
+    }
+  }
+}
+
+/**
+ * The result must hold the input of exactly the ranks that are not
+ * missing, and only ranks that failed may be missing
+ */
+void
+check_result(transport* t, int tag, int result, int victim, bool victim_missing)
+{
+  int me = t->rank();
+  int nproc = t->nproc();
+  collective_done_message::ptr dmsg = wait_for_allreduce(t, tag);
+  const rank_set& failed = dmsg->failed_procs();
+  const rank_set& missing = dmsg->missing_contributions();
+  if (failed.count(victim) == 0){
+    spkt_throw_printf(sprockit::value_error,
+      "Rank %d: survivor allreduce tag=%d did not agree on failed rank %d: failed=%s",
+      me, tag, victim, failed.to_string().c_str());
+  }
+  if (victim_missing && missing.count(victim) == 0){
+    spkt_throw_printf(sprockit::value_error,
+      "Rank %d: survivor allreduce tag=%d has input from rank %d, failed in the context",
+      me, tag, victim);
+  }
+
+  int correct = 0;
+  for (int r=0; r < nproc; ++r){
+    if (missing.count(r)){
+      if (failed.count(r) == 0){
+        spkt_throw_printf(sprockit::value_error,
+          "Rank %d: survivor allreduce tag=%d is missing live rank %d: missing=%s failed=%s",
+          me, tag, r, missing.to_string().c_str(), failed.to_string().c_str());
+      }
+    } else {
+      correct += val(r);
+    }
+  }
+
+  if (result != correct){
+    spkt_throw_printf(sprockit::value_error,
+      "Rank %d: survivor allreduce tag=%d got %x, expected %x for missing=%s",
+      me, tag, result, correct, missing.to_string().c_str());
+  }
+  printf("Rank %d passed survivor allreduce tag=%d with missing=%s\n",
+    me, tag, missing.to_string().c_str());
+}
+
+void
+run_test(transport* t)
+{
+  int me = t->rank();
+  int nproc = t->nproc();
+  if (nproc < 3 || nproc > 30){
+    spkt_throw_printf(sprockit::value_error,
+      "survivor allreduce test needs 3 to 30 ranks, got %d", nproc);
+  }
+  //not the root of the vote tree
+  int victim = nproc / 2;
+
+  t->start_heartbeat(100e-1);
+
+  //the victim dies right after starting, its input may or may not
+  //make it into the result before its partners notice
+  int result = val(me);
+  t->survivor_allreduce<int,Add>(&result, &result, 1, 0);
+  if (me == victim){
+    printf("Rank %d going down!\n", me);
+    t->die();
+  }
+  check_result(t, 0, result, victim, false);
+
+  //the victim is failed in the new context and can only be missing
+  result = val(me);
+  t->survivor_allreduce<int,Add>(&result, &result, 1, 1, 0);
+  check_result(t, 1, result, victim, true);
+
+  t->stop_heartbeat();
+}
+
+void
+run_test()
+{
+  sprockit::sim_parameters params;
+  const char* transport_name = getenv("SUMI_TRANSPORT");
+  params["transport"] = transport_name ? transport_name : DEFAULT_TRANSPORT;
+  params["lazy_watch"] = "true";
+  params["eager_cutoff"] = "0";
+  params["use_put_protocol"] = "false";
+  params["ping_timeout"] = "10ms";
+  transport* t = transport_factory::get_param("transport", &params);
+
+  t->init();
+  int me = t->rank();
+
+  try {
+    run_test(t);
+  } catch (terminate_exception& e) {
+    //do nothing - must finalize
+    t->block_until_message();
+    printf("Rank %d is dead but exiting loop!\n", me);
+  }
+
+  t->finalize();
+}
+
+int main(int argc, char** argv)
+{
+#if DEBUG
+  sprockit::debug::turn_on("sumi");
+  sprockit::debug::turn_on("sumi_collective");
+  sprockit::debug::turn_on("sumi_vote");
+#endif
+  run_rank_threads(run_test);
+  return 0;
+}
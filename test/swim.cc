@@ -0,0 +1,267 @@
+#include <sprockit/test/test.h>
+#include <sprockit/sim_parameters.h>
+#include <sprockit/errors.h>
+#include <sumi/swim.h>
+#include <fake/fake_transport.h>
+#include <vector>
+#include <set>
+
+using sumi::fake_transport;
+using sumi::swim_monitor;
+using sumi::swim_message;
+using sumi::message;
+
+static const int test_nproc = 8;
+
+static const double period = 5e-3;
+
+/** Time moves in steps well below the period */
+static const double tick = period / 5;
+
+/**
+ * A job of fake transports in this process. Messages go out only when
+ * delivered by hand, and never to or from a rank that is cut off.
+ */
+class swim_job {
+ public:
+  swim_job(int suspicion_mult = 3) : step_(0)
+  {
+    sprockit::sim_parameters params;
+    params["transport"] = "fake";
+    params["fake_transport_nproc"] = sprockit::printf("%d", test_nproc);
+    params["activity_monitor"] = "swim";
+    params["swim_period"] = sprockit::printf("%.3fms", period*1e3);
+    params["swim_suspicion_mult"] = sprockit::printf("%d", suspicion_mult);
+    for (int i=0; i < test_nproc; ++i){
+      params["fake_transport_rank"] = sprockit::printf("%d", i);
+      fake_transport* t = safe_cast(fake_transport,
+        sumi::transport_factory::get_param("transport", &params));
+      t->init();
+      ranks_.push_back(t);
+    }
+  }
+
+  ~swim_job(){
+    for (int i=0; i < test_nproc; ++i){
+      delete ranks_[i];
+    }
+  }
+
+  double
+  now() const {
+    return step_ * tick;
+  }
+
+  /**
+   * Run one step of every rank still up, then deliver until nothing is left
+   */
+  void
+  advance(){
+    ++step_;
+    for (int i=0; i < test_nproc; ++i){
+      if (!dead_.count(i)){
+        ranks_[i]->set_wall_time(now());
+        ranks_[i]->renew_pings();
+      }
+    }
+    deliver();
+  }
+
+  void
+  kill(int rank){
+    dead_.insert(rank);
+  }
+
+  void
+  cut_off(int rank){
+    cut_off_.insert(rank);
+  }
+
+  void
+  reconnect(int rank){
+    cut_off_.erase(rank);
+  }
+
+  bool
+  is_dead(int rank) const {
+    return dead_.count(rank);
+  }
+
+  fake_transport*
+  rank(int rank) const {
+    return ranks_[rank];
+  }
+
+  const swim_monitor*
+  monitor(int rank) const {
+    return safe_cast(const swim_monitor, ranks_[rank]->monitor());
+  }
+
+  /**
+   * @return How many live ranks other than the subject hold it in the state
+   */
+  int
+  num_in_state(int subject, swim_message::state_t state) const {
+    int count = 0;
+    for (int i=0; i < test_nproc; ++i){
+      if (i != subject && !dead_.count(i) && monitor(i)->member_state(subject) == state){
+        ++count;
+      }
+    }
+    return count;
+  }
+
+  /**
+   * @return The earliest time any live rank declared the subject failed,
+   *         negative if none has
+   */
+  double
+  first_detection(int subject) const {
+    double first = -1;
+    for (int i=0; i < test_nproc; ++i){
+      double t = ranks_[i]->failure_detect_time(subject);
+      if (!dead_.count(i) && t >= 0 && (first < 0 || t < first)){
+        first = t;
+      }
+    }
+    return first;
+  }
+
+ private:
+  bool
+  dropped(const message::ptr& msg) const {
+    int src = msg->sender();
+    int dst = msg->recver();
+    return dead_.count(dst) || cut_off_.count(src) || cut_off_.count(dst);
+  }
+
+  void
+  deliver(){
+    bool delivered = true;
+    while (delivered){
+      delivered = false;
+      for (int i=0; i < test_nproc; ++i){
+        message::ptr msg = ranks_[i]->pop_send();
+        while (msg){
+          delivered = true;
+          if (!dropped(msg)){
+            ranks_[msg->recver()]->delayed_transport_handle(msg);
+          }
+          msg = ranks_[i]->pop_send();
+        }
+      }
+    }
+  }
+
+  std::vector<fake_transport*> ranks_;
+
+  std::set<int> dead_;
+
+  std::set<int> cut_off_;
+
+  int step_;
+};
+
+void
+test_dead_rank(UnitTest& unit)
+{
+  swim_job job;
+  //one full cycle through the probe order with everyone up
+  for (int i=0; i < test_nproc*5; ++i){
+    job.advance();
+  }
+
+  int victim = 3;
+  job.kill(victim);
+  double suspect_timeout = job.monitor(0)->suspect_timeout();
+  //probe order is shuffled per cycle, so a rank might get around
+  //to the victim only two cycles from now
+  double bound = job.now() + 2*test_nproc*period + 2*suspect_timeout;
+  double suspected = -1;
+  while (job.now() < bound && job.num_in_state(victim, swim_message::dead) < test_nproc - 1){
+    job.advance();
+    if (suspected < 0 && job.num_in_state(victim, swim_message::suspect)){
+      suspected = job.now();
+    }
+  }
+
+  assertTrue(unit, "dead rank suspected", suspected >= 0);
+  double detected = job.first_detection(victim);
+  assertTrue(unit, "dead rank declared failed", detected >= 0);
+  //nobody refutes for a dead rank, so the first suspect gives up
+  //on the first step after its suspicion times out
+  assertTrue(unit, "declared failed after suspicion timeout",
+    detected > suspected + suspect_timeout - tick/2);
+  assertTrue(unit, "declared failed within suspicion timeout",
+    detected < suspected + suspect_timeout + 3*tick/2);
+  assertEqual(unit, "all survivors declared failure",
+    job.num_in_state(victim, swim_message::dead), test_nproc - 1);
+
+  for (int i=0; i < test_nproc; ++i){
+    if (job.is_dead(i)) continue;
+    assertTrue(unit, "survivor sees victim failed", job.rank(i)->is_failed(victim));
+    for (int j=0; j < test_nproc; ++j){
+      if (j != victim){
+        assertTrue(unit, "survivor sees no false failure", !job.rank(i)->is_failed(j));
+      }
+    }
+  }
+}
+
+void
+test_refuted_suspicion(UnitTest& unit)
+{
+  //while cut off, the rank also suspects everyone it probes, so every
+  //suspicion must outlast the two cycles it may take to be suspected back
+  swim_job job(10);
+  for (int i=0; i < test_nproc*5; ++i){
+    job.advance();
+  }
+
+  //the rank is only unreachable until somebody suspects it
+  int slow = 5;
+  job.cut_off(slow);
+  double suspect_timeout = job.monitor(0)->suspect_timeout();
+  double bound = job.now() + 2*test_nproc*period + suspect_timeout;
+  while (job.now() < bound && job.num_in_state(slow, swim_message::suspect) == 0){
+    job.advance();
+  }
+  assertTrue(unit, "unreachable rank suspected",
+    job.num_in_state(slow, swim_message::suspect) > 0);
+  assertEqual(unit, "unreachable rank not yet declared failed",
+    job.num_in_state(slow, swim_message::dead), 0);
+  job.reconnect(slow);
+
+  //well past every suspicion deadline, including those that were
+  //handed on by gossip after the first
+  bound = job.now() + 3*suspect_timeout;
+  while (job.now() < bound){
+    job.advance();
+  }
+
+  assertTrue(unit, "suspect refuted with a new incarnation",
+    job.monitor(slow)->incarnation() > 0);
+  assertEqual(unit, "suspicion cleared everywhere",
+    job.num_in_state(slow, swim_message::alive), test_nproc - 1);
+  for (int i=0; i < test_nproc; ++i){
+    for (int j=0; j < test_nproc; ++j){
+      assertTrue(unit, "refuted suspicion not declared failed",
+        !job.rank(i)->is_failed(j));
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  UnitTest unit;
+  try {
+    SPROCKIT_RUN_TEST_NO_ARGS(test_dead_rank, unit);
+    SPROCKIT_RUN_TEST_NO_ARGS(test_refuted_suspicion, unit);
+  } catch (std::exception& e) {
+    std::cerr << "SWIM test failed to initialize: "
+      << e.what() << std::endl;
+    return 1;
+  }
+
+  return unit.validate();
+}
@@ -0,0 +1,117 @@
+#include <sprockit/test/test.h>
+#include <sprockit/sim_parameters.h>
+#include <sprockit/errors.h>
+#include <sumi/transport.h>
+#include <sumi/rank_threads.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace sumi;
+
+static const int test_nproc = 4;
+
+static std::string hostfile;
+
+static inline int
+val(int rank, int idx){
+  return idx*10 + rank;
+}
+
+/**
+ * One line per rank, mixing names and addresses. Ports come from our pid
+ * so that tests running side by side do not collide
+ */
+void
+write_hostfile()
+{
+  char fname[] = "/tmp/sumi_tcp_hostsXXXXXX";
+  int fd = mkstemp(fname);
+  if (fd < 0){
+    spkt_throw(sprockit::value_error,
+      "tcp test could not create a hostfile");
+  }
+  FILE* f = fdopen(fd, "w");
+  int base_port = 30000 + (getpid() % 1000) * 16;
+  fprintf(f, "# host port\n");
+  for (int i=0; i < test_nproc; ++i){
+    fprintf(f, "%s %d\n", i % 2 ? "localhost" : "127.0.0.1", base_port + i);
+  }
+  fclose(f);
+  hostfile = fname;
+}
+
+void
+check_collectives(transport* t, int tag)
+{
+  int me = t->rank();
+  int nproc = t->nproc();
+
+  std::vector<int> reduce_buf(nproc, 0);
+  reduce_buf[me] = val(me, 0);
+  t->allreduce<int,Add>(&reduce_buf[0], &reduce_buf[0], nproc, tag);
+  t->blocking_poll();
+
+  std::vector<int> gather_buf(nproc, -1);
+  int mine = val(me, 1);
+  t->allgather(&gather_buf[0], &mine, 1, sizeof(int), tag + 1);
+  t->blocking_poll();
+
+  for (int i=0; i < nproc; ++i){
+    if (reduce_buf[i] != val(i, 0) || gather_buf[i] != val(i, 1)){
+      spkt_throw_printf(sprockit::value_error,
+        "Rank %d: tag=%d got reduce[%d]=%d, gather[%d]=%d, expected %d, %d",
+        me, tag, i, reduce_buf[i], i, gather_buf[i], val(i, 0), val(i, 1));
+    }
+  }
+}
+
+void
+run_rank(int rank, int nproc)
+{
+  sprockit::sim_parameters params;
+  params["transport"] = "tcp";
+  params["tcp_rank"] = sprockit::printf("%d", rank);
+  params["tcp_nproc"] = sprockit::printf("%d", nproc);
+  params["tcp_hostfile"] = hostfile;
+  params["tcp_connect_timeout"] = "4s";
+  params["eager_cutoff"] = "0";
+  transport* t = transport_factory::get_param("transport", &params);
+  t->init();
+
+  //every message by rendezvous
+  t->set_put_protocol(false);
+  check_collectives(t, 0);
+  t->set_put_protocol(true);
+  check_collectives(t, 2);
+
+  //and eagerly
+  t->set_eager_cutoff(1 << 20);
+  check_collectives(t, 4);
+
+  t->finalize();
+}
+
+void
+test_tcp_ranks(UnitTest& unit)
+{
+  write_hostfile();
+  int num_failed = run_rank_procs(test_nproc, run_rank);
+  unlink(hostfile.c_str());
+  assertEqual(unit, "failed tcp ranks", num_failed, 0);
+}
+
+int main(int argc, char** argv)
+{
+  UnitTest unit;
+  try {
+    SPROCKIT_RUN_TEST_NO_ARGS(test_tcp_ranks, unit);
+  } catch (std::exception& e) {
+    std::cerr << "tcp test failed to initialize: "
+      << e.what() << std::endl;
+    return 1;
+  }
+
+  return unit.validate();
+}
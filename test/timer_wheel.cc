@@ -0,0 +1,179 @@
+#include <sprockit/test/test.h>
+#include <sprockit/errors.h>
+#include <sumi/timer_wheel.h>
+#include <vector>
+
+using sumi::timer_wheel;
+
+class test_entry :
+  public timer_wheel::entry
+{
+ public:
+  test_entry(int id = -1) : id(id) {}
+  int id;
+};
+
+static bool
+contains(const timer_wheel::entry_list& list, const test_entry* e)
+{
+  for (int i=0; i < int(list.size()); ++i){
+    if (list[i] == e) return true;
+  }
+  return false;
+}
+
+void
+test_expiry(UnitTest& unit)
+{
+  //64 slots per level, 2 levels: everything within 4096 ticks lives on the wheel
+  timer_wheel wheel(1.0, 2);
+  test_entry early, late;
+  wheel.schedule(&early, 10.5);
+  wheel.schedule(&late, 20.5);
+  assertEqual(unit, "scheduled size", wheel.size(), 2);
+
+  timer_wheel::entry_list expired;
+  wheel.advance(10.0, expired);
+  assertEqual(unit, "nothing due yet", int(expired.size()), 0);
+
+  wheel.advance(11.0, expired);
+  assertEqual(unit, "one due", int(expired.size()), 1);
+  assertTrue(unit, "earliest expires first", contains(expired, &early));
+  assertTrue(unit, "expired entry unscheduled", !early.scheduled());
+  assertEqual(unit, "size after expiry", wheel.size(), 1);
+
+  expired.clear();
+  wheel.advance(30.0, expired);
+  assertTrue(unit, "later entry expires", contains(expired, &late));
+  assertEqual(unit, "empty wheel", wheel.size(), 0);
+
+  //deadlines already in the past expire on the next advance
+  expired.clear();
+  wheel.schedule(&early, 5.0);
+  wheel.advance(30.0, expired);
+  assertTrue(unit, "past deadline expires", contains(expired, &early));
+}
+
+void
+test_wraparound(UnitTest& unit)
+{
+  timer_wheel wheel(1.0, 2);
+  test_entry low(0), cascaded(1), overflow(2);
+  timer_wheel::entry_list expired;
+  wheel.advance(60.0, expired);
+
+  //crosses the end of the lowest level
+  wheel.schedule(&low, 70.5);
+  //lands on the second level, cascades down
+  wheel.schedule(&cascaded, 700.5);
+  //past the whole wheel, revisited once per top level revolution
+  wheel.schedule(&overflow, 10000.5);
+  assertEqual(unit, "wraparound size", wheel.size(), 3);
+
+  wheel.advance(70.0, expired);
+  assertEqual(unit, "nothing due before wrap", int(expired.size()), 0);
+  wheel.advance(71.0, expired);
+  assertTrue(unit, "expires past lowest level wrap", contains(expired, &low));
+
+  expired.clear();
+  wheel.advance(700.0, expired);
+  assertEqual(unit, "cascaded entry not early", int(expired.size()), 0);
+  wheel.advance(701.0, expired);
+  assertTrue(unit, "cascaded entry expires", contains(expired, &cascaded));
+
+  expired.clear();
+  for (double t=1000.0; t < 10000.0; t += 500.0){
+    wheel.advance(t, expired);
+  }
+  assertEqual(unit, "overflow entry not early", int(expired.size()), 0);
+  assertEqual(unit, "overflow entry kept", wheel.size(), 1);
+  wheel.advance(10001.0, expired);
+  assertTrue(unit, "overflow entry expires", contains(expired, &overflow));
+
+  //jumping over the whole wheel at once
+  expired.clear();
+  wheel.schedule(&low, 10100.5);
+  wheel.schedule(&cascaded, 50000.5);
+  wheel.advance(40000.0, expired);
+  assertEqual(unit, "jump expires due entries", int(expired.size()), 1);
+  assertTrue(unit, "jump expires right entry", contains(expired, &low));
+  wheel.advance(50001.0, expired);
+  assertTrue(unit, "jump keeps later entry", contains(expired, &cascaded));
+  assertEqual(unit, "empty after jump", wheel.size(), 0);
+}
+
+void
+test_cancel_rearm(UnitTest& unit)
+{
+  timer_wheel wheel(1.0, 2);
+  test_entry a, b;
+  timer_wheel::entry_list expired;
+
+  wheel.schedule(&a, 10.5);
+  wheel.schedule(&b, 10.5);
+  wheel.cancel(&a);
+  assertTrue(unit, "canceled entry unscheduled", !a.scheduled());
+  assertEqual(unit, "size after cancel", wheel.size(), 1);
+  //canceling twice is harmless
+  wheel.cancel(&a);
+  assertEqual(unit, "size after double cancel", wheel.size(), 1);
+
+  wheel.advance(20.0, expired);
+  assertTrue(unit, "canceled entry never expires", !contains(expired, &a));
+  assertTrue(unit, "other entry expires", contains(expired, &b));
+
+  //re-arming a scheduled entry moves it rather than adding it twice
+  expired.clear();
+  wheel.schedule(&a, 30.5);
+  wheel.schedule(&a, 500.5);
+  assertEqual(unit, "re-armed once", wheel.size(), 1);
+  assertTrue(unit, "re-armed deadline", a.deadline() == 500.5);
+  wheel.advance(100.0, expired);
+  assertEqual(unit, "old deadline ignored", int(expired.size()), 0);
+
+  //pulled back in, e.g. a renewed ping
+  wheel.schedule(&a, 150.5);
+  wheel.advance(151.0, expired);
+  assertTrue(unit, "re-armed earlier expires", contains(expired, &a));
+
+  //re-armed after expiring
+  expired.clear();
+  wheel.schedule(&a, 200.5);
+  wheel.advance(201.0, expired);
+  assertTrue(unit, "re-armed after expiry", contains(expired, &a));
+
+  //parked entries stay off the wheel until collected or re-armed
+  expired.clear();
+  wheel.schedule(&a, 300.5);
+  wheel.park(&a);
+  assertEqual(unit, "parked not counted", wheel.size(), 0);
+  wheel.advance(400.0, expired);
+  assertEqual(unit, "parked never expires", int(expired.size()), 0);
+  wheel.collect_parked(expired);
+  assertTrue(unit, "parked collected", contains(expired, &a));
+  assertTrue(unit, "collected entry unscheduled", !a.scheduled());
+
+  wheel.schedule(&b, 450.5);
+  wheel.park(&b);
+  wheel.schedule(&b, 460.5);
+  assertEqual(unit, "re-armed parked entry", wheel.size(), 1);
+  expired.clear();
+  wheel.collect_parked(expired);
+  assertEqual(unit, "re-armed entry not parked", int(expired.size()), 0);
+}
+
+int main(int argc, char** argv)
+{
+  UnitTest unit;
+  try {
+    SPROCKIT_RUN_TEST_NO_ARGS(test_expiry, unit);
+    SPROCKIT_RUN_TEST_NO_ARGS(test_wraparound, unit);
+    SPROCKIT_RUN_TEST_NO_ARGS(test_cancel_rearm, unit);
+  } catch (std::exception& e) {
+    std::cerr << "Timer wheel test failed to initialize: "
+      << e.what() << std::endl;
+    return 1;
+  }
+
+  return unit.validate();
+}
@@ -0,0 +1,117 @@
+#include <sprockit/test/test.h>
+#include <sprockit/errors.h>
+#include <sumi/wire_header.h>
+#include <sumi/collective_message.h>
+#include <vector>
+#include <cstring>
+
+using namespace sumi;
+
+/**
+ * Fill every byte of the buffer struct, not just the pointer,
+ * so that transport-specific fields like memory handles are covered
+ */
+static public_buffer
+patterned_buffer(char pattern, void* ptr)
+{
+  public_buffer buf;
+  ::memset((void*) &buf, pattern, sizeof(public_buffer));
+  buf.ptr = ptr;
+  return buf;
+}
+
+static bool
+same_buffer(const public_buffer& a, const public_buffer& b)
+{
+  return ::memcmp(&a, &b, sizeof(public_buffer)) == 0;
+}
+
+static message::ptr
+round_trip(const message::ptr& msg, std::vector<char>& buf)
+{
+  buf.resize(wire_header::packed_size(msg));
+  size_t size = wire_header::pack(msg, &buf[0], buf.size());
+  return wire_header::unpack(&buf[0], size);
+}
+
+void
+test_rdma(UnitTest& unit)
+{
+  int local, remote;
+  rdma_message::ptr msg = new rdma_message(128);
+  msg->set_sender(3);
+  msg->set_recver(7);
+  msg->set_transaction_id(42);
+  msg->set_needs_send_ack(true);
+  msg->local_buffer() = patterned_buffer(0x5a, &local);
+  msg->remote_buffer() = patterned_buffer(0x3c, &remote);
+
+  std::vector<char> buf;
+  message::ptr out = round_trip(msg, buf);
+  assertEqual(unit, "rdma format", int(wire_header::peek(&buf[0])->format), int(wire_header::rdma));
+  assertTrue(unit, "rdma local buffer intact", same_buffer(out->local_buffer(), msg->local_buffer()));
+  assertTrue(unit, "rdma remote buffer intact", same_buffer(out->remote_buffer(), msg->remote_buffer()));
+  assertEqual(unit, "rdma sender", out->sender(), 3);
+  assertEqual(unit, "rdma recver", out->recver(), 7);
+  assertEqual(unit, "rdma transaction id", out->transaction_id(), 42);
+  assertEqual(unit, "rdma byte length", int(out->byte_length()), 128);
+  assertTrue(unit, "rdma send ack", out->needs_send_ack());
+  assertTrue(unit, "rdma no recv ack", !out->needs_recv_ack());
+}
+
+void
+test_collective_rdma(UnitTest& unit)
+{
+  int local, remote;
+  collective_rdma_message::ptr msg = new collective_rdma_message(
+    collective::allreduce, collective_work_message::get_data,
+    16, sizeof(double), 11, 2, 4, 5);
+  msg->set_byte_length(16*sizeof(double));
+  msg->local_buffer() = patterned_buffer(0x11, &local);
+  msg->remote_buffer() = patterned_buffer(0x77, &remote);
+
+  std::vector<char> buf;
+  collective_work_message::ptr out = ptr_safe_cast(collective_work_message, round_trip(msg, buf));
+  assertEqual(unit, "collective rdma format", int(wire_header::peek(&buf[0])->format),
+              int(wire_header::collective_rdma));
+  assertTrue(unit, "collective local buffer intact", same_buffer(out->local_buffer(), msg->local_buffer()));
+  assertTrue(unit, "collective remote buffer intact", same_buffer(out->remote_buffer(), msg->remote_buffer()));
+  assertEqual(unit, "collective tag", out->tag(), 11);
+  assertEqual(unit, "collective round", out->round(), 2);
+  assertEqual(unit, "collective nelems", out->nelems(), 16);
+  assertEqual(unit, "collective dense sender", out->dense_sender(), 4);
+  assertEqual(unit, "collective dense recver", out->dense_recver(), 5);
+}
+
+void
+test_collective_eager(UnitTest& unit)
+{
+  int payload[] = { 1, 2, 3, 4 };
+  collective_eager_message::ptr msg = new collective_eager_message(
+    collective::allgather, collective_work_message::eager_payload,
+    payload, 4, sizeof(int), 9, 1, 0, 1);
+  msg->set_byte_length(sizeof(payload));
+
+  std::vector<char> buf;
+  message::ptr out = round_trip(msg, buf);
+  int* recvd = (int*) out->eager_buffer();
+  assertTrue(unit, "eager payload copied", recvd && recvd != payload);
+  assertTrue(unit, "eager payload intact", recvd && ::memcmp(recvd, payload, sizeof(payload)) == 0);
+  delete[] (char*) recvd;
+}
+
+int main(int argc, char** argv)
+{
+  UnitTest unit;
+  try {
+    SPROCKIT_RUN_TEST_NO_ARGS(test_rdma, unit);
+    SPROCKIT_RUN_TEST_NO_ARGS(test_collective_rdma, unit);
+    SPROCKIT_RUN_TEST_NO_ARGS(test_collective_eager, unit);
+  } catch (std::exception& e) {
+    std::cerr << "Wire pack test failed to initialize: "
+      << e.what() << std::endl;
+    return 1;
+  }
+
+  return unit.validate();
+}
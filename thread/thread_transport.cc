@@ -0,0 +1,311 @@
+#include <thread/thread_transport.h>
+#include <sumi/wire_header.h>
+#include <sprockit/serializer.h>
+#include <sprockit/sim_parameters.h>
+#include <sprockit/keyword_registration.h>
+#include <sys/time.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define thread_debug_out(...) \
+  debug_printf(sprockit::dbg::thread_transport, "Rank %d: %s at t=%8.4e", rank(), sprockit::printf(__VA_ARGS__).c_str(), wall_time())
+
+DeclareDebugSlot(thread_transport);
+RegisterDebugSlot(thread_transport);
+
+RegisterKeywords(
+  "thread_nproc",
+  "thread_poll_timeout"
+);
+
+namespace sumi {
+
+SpktRegister("thread", transport, thread_transport,
+            "Create a SUMI transport in which ranks are threads of one process");
+
+/**
+ * Ranks find each other here. Reset once all ranks finalize,
+ * so a process can run several jobs back to back.
+ */
+struct thread_world
+{
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int nproc;
+  int num_attached;
+  int num_finalized;
+  int generation;
+  std::vector<thread_transport*> ranks;
+  std::vector<int> status;
+
+  thread_world() :
+    nproc(0),
+    num_attached(0),
+    num_finalized(0),
+    generation(0)
+  {
+    pthread_mutex_init(&lock, 0);
+    pthread_cond_init(&cond, 0);
+  }
+};
+
+static thread_world world;
+
+thread_transport::thread_transport() :
+  poll_timeout_(1e-3)
+{
+  pthread_mutex_init(&inbox_lock_, 0);
+  pthread_cond_init(&inbox_cond_, 0);
+}
+
+thread_transport::~thread_transport()
+{
+  std::list<std::vector<char>*>::iterator it, end = inbox_.end();
+  for (it=inbox_.begin(); it != end; ++it){
+    delete *it;
+  }
+  pthread_mutex_destroy(&inbox_lock_);
+  pthread_cond_destroy(&inbox_cond_);
+}
+
+void
+thread_transport::init_factory_params(sprockit::sim_parameters* params)
+{
+  active_msg_transport::init_factory_params(params);
+  const char* nproc_str = getenv("SUMI_THREAD_NPROC");
+  nproc_ = params->get_optional_int_param("thread_nproc", nproc_str ? atoi(nproc_str) : -1);
+  poll_timeout_ = params->get_optional_time_param("thread_poll_timeout", 1e-3);
+  if (nproc_ <= 0){
+    spkt_throw_printf(sprockit::value_error,
+      "thread_transport: invalid nproc %d - set thread_nproc or SUMI_THREAD_NPROC",
+      nproc_);
+  }
+}
+
+void
+thread_transport::init()
+{
+  pthread_mutex_lock(&world.lock);
+  if (world.num_attached == 0){
+    world.nproc = nproc_;
+    world.ranks.assign(nproc_, 0);
+    world.status.assign(nproc_, i_am_alive);
+  }
+  if (world.nproc != nproc_ || world.num_attached == world.nproc){
+    int world_nproc = world.nproc;
+    pthread_mutex_unlock(&world.lock);
+    spkt_throw_printf(sprockit::value_error,
+      "thread_transport: cannot join job of %d threads with nproc=%d",
+      world_nproc, nproc_);
+  }
+  rank_ = world.num_attached++;
+  world.ranks[rank_] = this;
+  pthread_cond_broadcast(&world.cond);
+  while (world.num_attached < world.nproc){
+    pthread_cond_wait(&world.cond, &world.lock);
+  }
+  pthread_mutex_unlock(&world.lock);
+
+  active_msg_transport::init();
+  thread_debug_out("joined job of %d threads", nproc_);
+}
+
+void
+thread_transport::finalize()
+{
+  transport::finalize();
+
+  //nobody may leave while a peer could still hand us a buffer
+  pthread_mutex_lock(&world.lock);
+  int gen = world.generation;
+  ++world.num_finalized;
+  if (world.num_finalized == world.nproc){
+    world.num_attached = 0;
+    world.num_finalized = 0;
+    ++world.generation;
+    pthread_cond_broadcast(&world.cond);
+  } else {
+    while (gen == world.generation){
+      pthread_cond_wait(&world.cond, &world.lock);
+    }
+  }
+  pthread_mutex_unlock(&world.lock);
+}
+
+void
+thread_transport::push(int dst, const message::ptr& msg)
+{
+  std::vector<char>* buf = new std::vector<char>(wire_header::packed_size(msg));
+  wire_header::pack(msg, &(*buf)[0], buf->size());
+
+  thread_debug_out("handing %s to %d", msg->to_string().c_str(), dst);
+
+  thread_transport* peer = world.ranks[dst];
+  pthread_mutex_lock(&peer->inbox_lock_);
+  peer->inbox_.push_back(buf);
+  pthread_cond_signal(&peer->inbox_cond_);
+  pthread_mutex_unlock(&peer->inbox_lock_);
+}
+
+int
+thread_transport::drain_inbox()
+{
+  std::list<std::vector<char>*> incoming;
+  pthread_mutex_lock(&inbox_lock_);
+  incoming.swap(inbox_);
+  pthread_mutex_unlock(&inbox_lock_);
+
+  int num_drained = incoming.size();
+  while (!incoming.empty()){
+    std::vector<char>* buf = incoming.front();
+    incoming.pop_front();
+    message::ptr msg = wire_header::unpack(&(*buf)[0], buf->size(), this);
+    delete buf;
+
+    thread_debug_out("received %s", msg->to_string().c_str());
+    CHECK_IF_I_AM_DEAD(continue);
+    handle(msg);
+  }
+  return num_drained;
+}
+
+void
+thread_transport::wait_on_inbox(double timeout)
+{
+  timeval now;
+  gettimeofday(&now, 0);
+  long nsec = (now.tv_usec + long(timeout * 1e6)) * 1000;
+  timespec stop;
+  stop.tv_sec = now.tv_sec + nsec / 1000000000;
+  stop.tv_nsec = nsec % 1000000000;
+
+  pthread_mutex_lock(&inbox_lock_);
+  if (inbox_.empty()){
+    pthread_cond_timedwait(&inbox_cond_, &inbox_lock_, &stop);
+  }
+  pthread_mutex_unlock(&inbox_lock_);
+}
+
+void
+thread_transport::block_inner_loop()
+{
+  int num_done = drain_inbox();
+
+  while (!ping_responses_.empty()){
+    message::ptr msg = ping_responses_.front();
+    ping_responses_.pop_front();
+    handle(msg);
+    ++num_done;
+  }
+
+  maybe_do_heartbeat();
+  renew_pings();
+
+  if (num_done == 0){
+    //sleep rather than spin - there may be far more ranks than cores
+    wait_on_inbox(poll_timeout_);
+  }
+}
+
+void
+thread_transport::do_smsg_send(int dst, const message::ptr &msg)
+{
+  CHECK_IF_I_AM_DEAD(return);
+  push(dst, msg);
+}
+
+void
+thread_transport::do_send_terminate(int dst)
+{
+  thread_debug_out("send terminate request to %d", dst);
+  message::ptr msg = new message;
+  msg->set_class_type(message::terminate);
+  push(dst, msg);
+}
+
+void
+thread_transport::do_send_ping_request(int dst)
+{
+  //liveness is shared directly, no round trip needed
+  bool alive = __atomic_load_n(&world.status[dst], __ATOMIC_ACQUIRE) == i_am_alive;
+
+  message::ptr ping_msg = new message;
+  ping_msg->set_sender(dst);
+  ping_msg->set_recver(rank_);
+  ping_msg->set_class_type(message::ping);
+  if (alive){
+    ping_msg->set_payload_type(message::rdma_get);
+  } else {
+    ping_msg->set_payload_type(message::rdma_get_nack);
+  }
+  ping_responses_.push_back(ping_msg);
+}
+
+void
+thread_transport::do_rdma_get(int src, const message::ptr &msg)
+{
+  CHECK_IF_I_AM_DEAD(return);
+  long bytes = msg->byte_length();
+  void* recver_buf = msg->local_buffer().ptr;
+  void* sender_buf = msg->remote_buffer().ptr;
+
+  thread_debug_out("rdma get %ld bytes from %d: %p -> %p",
+    bytes, src, sender_buf, recver_buf);
+  ::memcpy(recver_buf, sender_buf, bytes);
+
+  if (msg->needs_send_ack()){
+    //push packs the message immediately, so it can be reused below
+    msg->set_payload_type(message::rdma_get_ack);
+    push(src, msg);
+  }
+
+  if (msg->needs_recv_ack()){
+    msg->set_payload_type(message::rdma_get);
+    handle(msg);
+  }
+}
+
+void
+thread_transport::do_rdma_put(int dst, const message::ptr &msg)
+{
+  CHECK_IF_I_AM_DEAD(return);
+  long bytes = msg->byte_length();
+  void* sender_buf = msg->local_buffer().ptr;
+  void* recver_buf = msg->remote_buffer().ptr;
+
+  thread_debug_out("rdma put %ld bytes to %d: %p -> %p",
+    bytes, dst, sender_buf, recver_buf);
+  ::memcpy(recver_buf, sender_buf, bytes);
+
+  if (msg->needs_recv_ack()){
+    push(dst, msg);
+  }
+
+  if (msg->needs_send_ack()){
+    message::ptr ack = msg->clone_msg();
+    ack->set_payload_type(message::rdma_put_ack);
+    handle(ack);
+  }
+}
+
+void
+thread_transport::do_nvram_get(int src, const message::ptr &msg)
+{
+  spkt_throw(sprockit::unimplemented_error,
+    "thread_transport: cannot do nvram get");
+}
+
+void
+thread_transport::go_die()
+{
+  __atomic_store_n(&world.status[rank_], (int) i_am_dead, __ATOMIC_RELEASE);
+}
+
+void
+thread_transport::go_revive()
+{
+  __atomic_store_n(&world.status[rank_], (int) i_am_alive, __ATOMIC_RELEASE);
+}
+
+}
@@ -0,0 +1,82 @@
+#ifndef thread_thread_transport_h
+#define thread_thread_transport_h
+
+#include <sumi/active_msg_transport.h>
+#include <pthread.h>
+#include <vector>
+#include <list>
+
+namespace sumi {
+
+/**
+ * @class thread_transport
+ * Every rank is a thread in the same process. Each thread builds its own
+ * transport and ranks are handed out in the order transports are initialized.
+ * Since all ranks share an address space, RDMA is a plain memcpy.
+ */
+class thread_transport :
+  public active_msg_transport
+{
+ public:
+  thread_transport();
+
+  virtual ~thread_transport();
+
+  void init();
+
+  void finalize();
+
+  virtual void
+  init_factory_params(sprockit::sim_parameters* params);
+
+ protected:
+  void block_inner_loop();
+
+  void do_send_terminate(int dst);
+
+  void do_send_ping_request(int dst);
+
+  void do_smsg_send(int dst, const message::ptr &msg);
+
+  void do_rdma_get(int src, const message::ptr &msg);
+
+  void do_rdma_put(int dst, const message::ptr &msg);
+
+  void do_nvram_get(int src, const message::ptr &msg);
+
+  void go_die();
+
+  void go_revive();
+
+ private:
+  /**
+   * Pack the message and hand the buffer to the peer.
+   * Message objects themselves are never shared between rank threads
+   * since their reference counts are not thread-safe.
+   */
+  void
+  push(int dst, const message::ptr& msg);
+
+  int
+  drain_inbox();
+
+  void
+  wait_on_inbox(double timeout);
+
+ private:
+  pthread_mutex_t inbox_lock_;
+
+  pthread_cond_t inbox_cond_;
+
+  std::list<std::vector<char>*> inbox_;
+
+  /** Ping responses are delivered from the progress loop, not inside the ping */
+  std::list<message::ptr> ping_responses_;
+
+  double poll_timeout_;
+
+};
+
+}
+
+#endif